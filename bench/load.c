@@ -0,0 +1,442 @@
+// Closed-loop keep-alive load generator. Every thread drives its share of
+// the connections from one epoll loop, each connection keeping `pipeline`
+// requests in flight and sending the next one as soon as a response ends.
+//
+//   alpha_bench_load [-c connections] [-t threads] [-d seconds]
+//                    [-w warmup seconds] [-p pipeline] host port [path]
+//
+// Latency is measured from queueing a request to reading the last byte of
+// its response, so it includes the time spent waiting for a full socket and
+// behind the requests pipelined before it.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PIPELINE_MAX 256
+#define RESPONSE_BUFFER_LEN (256 * 1024)
+#define EVENTS_MAX 256
+
+// Latencies are kept in nanoseconds, in 32 linear sub-buckets per power of
+// two, so every recorded value is within 3% of the real one
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BUCKET_BITS) * LATENCY_SUB_BUCKETS)
+
+typedef unsigned long usize;
+
+typedef struct {
+  unsigned long long counts[LATENCY_BUCKETS];
+  unsigned long long total;
+  unsigned long long max;
+} Histogram;
+
+typedef struct {
+  int fd;
+  // Queueing time of every request in flight, oldest first
+  unsigned long long sent_at[PIPELINE_MAX];
+  usize sent_head;
+  usize in_flight;
+  // Requests waiting for the socket to take them, `out_offset` bytes of the
+  // first having been sent already
+  usize out_requests;
+  usize out_offset;
+  char *in;
+  usize in_len;
+  // Set once a response announced it's the connection's last
+  int closing;
+} LoadConnection;
+
+typedef struct {
+  pthread_t thread;
+  int epoll_fd;
+  LoadConnection *conns;
+  usize conns_count;
+  Histogram latency;
+  unsigned long long requests;
+  unsigned long long errors;
+  unsigned long long reconnects;
+  unsigned long long bytes;
+} LoadThread;
+
+// Shared by all threads and read-only once they started
+static struct sockaddr_in target;
+static char *request;
+static usize request_len;
+static usize pipeline = 1;
+static unsigned long long measure_from;
+static unsigned long long measure_until;
+
+// Helpers
+unsigned long long now_ns(void);
+usize latency_bucket(unsigned long long ns);
+unsigned long long latency_bucket_max(usize bucket);
+unsigned long long histogram_quantile(const Histogram *histogram,
+                                      double quantile);
+int load_connect(LoadThread *thread, LoadConnection *conn);
+void load_reconnect(LoadThread *thread, LoadConnection *conn);
+void load_queue(LoadConnection *conn, usize count);
+int load_send(LoadConnection *conn);
+int load_receive(LoadThread *thread, LoadConnection *conn);
+long response_length(const char *data, usize len, int *status, int *close);
+void *load_thread(void *arg);
+
+unsigned long long now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+usize latency_bucket(unsigned long long ns) {
+  if (ns < LATENCY_SUB_BUCKETS) {
+    return ns;
+  }
+  usize msb = 63 - __builtin_clzll(ns);
+  return (msb - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS +
+         ((ns >> (msb - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+unsigned long long latency_bucket_max(usize bucket) {
+  if (bucket < LATENCY_SUB_BUCKETS) {
+    return bucket;
+  }
+  usize shift = bucket / LATENCY_SUB_BUCKETS - 1;
+  unsigned long long sub = bucket % LATENCY_SUB_BUCKETS;
+  return ((LATENCY_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+unsigned long long histogram_quantile(const Histogram *histogram,
+                                      double quantile) {
+  unsigned long long rank = quantile * histogram->total;
+  unsigned long long seen = 0;
+  for (usize i = 0; i < LATENCY_BUCKETS; ++i) {
+    seen += histogram->counts[i];
+    if (seen > rank) {
+      unsigned long long max = latency_bucket_max(i);
+      return max < histogram->max ? max : histogram->max;
+    }
+  }
+  return histogram->max;
+}
+
+int load_connect(LoadThread *thread, LoadConnection *conn) {
+  conn->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (conn->fd == -1) {
+    return -1;
+  }
+  setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &(int){1}, sizeof(int));
+  if (connect(conn->fd, (struct sockaddr *)&target, sizeof(target)) == -1 &&
+      errno != EINPROGRESS) {
+    close(conn->fd);
+    return -1;
+  }
+  conn->sent_head = 0;
+  conn->in_flight = 0;
+  conn->out_offset = 0;
+  conn->in_len = 0;
+  conn->closing = 0;
+  conn->out_requests = 0;
+  load_queue(conn, pipeline);
+  struct epoll_event event = {.events = EPOLLIN | EPOLLOUT | EPOLLET,
+                              .data.ptr = conn};
+  return epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, conn->fd, &event);
+}
+
+// Requests still in flight when a connection drops are counted as errors,
+// unless the server announced it was closing
+void load_reconnect(LoadThread *thread, LoadConnection *conn) {
+  if (!conn->closing && now_ns() < measure_until) {
+    thread->errors += conn->in_flight;
+  }
+  close(conn->fd);
+  thread->reconnects++;
+  if (load_connect(thread, conn) == -1) {
+    fprintf(stderr, "Couldn't reconnect: %s\n", strerror(errno));
+    exit(1);
+  }
+}
+
+void load_queue(LoadConnection *conn, usize count) {
+  unsigned long long now = now_ns();
+  for (usize i = 0; i < count; ++i) {
+    conn->sent_at[(conn->sent_head + conn->in_flight) % PIPELINE_MAX] = now;
+    conn->in_flight++;
+    conn->out_requests++;
+  }
+}
+
+// Hands the socket as many queued requests as it takes
+int load_send(LoadConnection *conn) {
+  while (conn->out_requests) {
+    char batch[16 * 1024];
+    usize len = 0;
+    for (usize i = 0;
+         i < conn->out_requests && len + request_len <= sizeof(batch); ++i) {
+      memcpy(batch + len, request, request_len);
+      len += request_len;
+    }
+    ssize_t sent = send(conn->fd, batch + conn->out_offset,
+                        len - conn->out_offset, MSG_NOSIGNAL);
+    if (sent == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    conn->out_offset += sent;
+    while (conn->out_offset >= request_len && conn->out_requests) {
+      conn->out_offset -= request_len;
+      conn->out_requests--;
+    }
+  }
+  return 0;
+}
+
+// Length of the response at `data`, 0 if its head hasn't fully arrived yet
+// or -1 if it can't be framed. Only Content-Length framing is understood.
+long response_length(const char *data, usize len, int *status, int *close) {
+  const char *end = memmem(data, len, "\r\n\r\n", 4);
+  if (!end) {
+    return len > 64 * 1024 ? -1 : 0;
+  }
+  if (len < 12 || memcmp(data, "HTTP/1.", 7) != 0) {
+    return -1;
+  }
+  *status = atoi(data + 9);
+  *close = 0;
+  long body = -1;
+  const char *line = memchr(data, '\n', end - data);
+  while (line && ++line < end) {
+    if (strncasecmp(line, "Content-Length:", 15) == 0) {
+      body = atol(line + 15);
+    } else if (strncasecmp(line, "Connection:", 11) == 0) {
+      const char *value = line + 11;
+      while (*value == ' ') {
+        value++;
+      }
+      *close = strncasecmp(value, "close", 5) == 0;
+    }
+    line = memchr(line, '\n', end + 2 - line);
+  }
+  if (body < 0) {
+    return -1;
+  }
+  return end + 4 - data + body;
+}
+
+// Reads whatever arrived, retires every complete response and queues a new
+// request for each of them
+int load_receive(LoadThread *thread, LoadConnection *conn) {
+  while (1) {
+    ssize_t read_len = recv(conn->fd, conn->in + conn->in_len,
+                            RESPONSE_BUFFER_LEN - conn->in_len, 0);
+    if (read_len == 0) {
+      return -1;
+    }
+    if (read_len == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    conn->in_len += read_len;
+
+    unsigned long long now = now_ns();
+    usize offset = 0;
+    while (1) {
+      int status = 0;
+      int close = 0;
+      long len = response_length(conn->in + offset, conn->in_len - offset,
+                                 &status, &close);
+      if (len == -1 || len > RESPONSE_BUFFER_LEN) {
+        return -1;
+      }
+      if (len == 0 || offset + len > conn->in_len) {
+        break;
+      }
+      // More responses than requests
+      if (!conn->in_flight) {
+        return -1;
+      }
+      offset += len;
+      unsigned long long sent_at = conn->sent_at[conn->sent_head];
+      conn->sent_head = (conn->sent_head + 1) % PIPELINE_MAX;
+      conn->in_flight--;
+      if (sent_at >= measure_from && now < measure_until) {
+        unsigned long long latency = now - sent_at;
+        thread->latency.counts[latency_bucket(latency)]++;
+        thread->latency.total++;
+        if (latency > thread->latency.max) {
+          thread->latency.max = latency;
+        }
+        thread->requests++;
+        thread->bytes += len;
+        if (status < 200 || status >= 400) {
+          thread->errors++;
+        }
+      }
+      if (close) {
+        conn->closing = 1;
+      }
+      if (!conn->closing) {
+        load_queue(conn, 1);
+      }
+    }
+    memmove(conn->in, conn->in + offset, conn->in_len - offset);
+    conn->in_len -= offset;
+    if (conn->closing && !conn->in_flight) {
+      return -1;
+    }
+  }
+}
+
+void *load_thread(void *arg) {
+  LoadThread *thread = arg;
+  struct epoll_event events[EVENTS_MAX];
+  while (now_ns() < measure_until) {
+    int ready = epoll_wait(thread->epoll_fd, events, EVENTS_MAX, 100);
+    for (int i = 0; i < ready; ++i) {
+      LoadConnection *conn = events[i].data.ptr;
+      if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) &&
+          load_receive(thread, conn) == -1) {
+        load_reconnect(thread, conn);
+        continue;
+      }
+      if (load_send(conn) == -1) {
+        load_reconnect(thread, conn);
+      }
+    }
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  usize conns_count = 64;
+  usize threads_count = 4;
+  double duration = 10;
+  double warmup = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "c:t:d:w:p:")) != -1) {
+    switch (opt) {
+    case 'c':
+      conns_count = strtoul(optarg, NULL, 10);
+      break;
+    case 't':
+      threads_count = strtoul(optarg, NULL, 10);
+      break;
+    case 'd':
+      duration = atof(optarg);
+      break;
+    case 'w':
+      warmup = atof(optarg);
+      break;
+    case 'p':
+      pipeline = strtoul(optarg, NULL, 10);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (argc - optind < 2 || !conns_count || !threads_count || !pipeline ||
+      pipeline > PIPELINE_MAX || duration <= 0) {
+    goto usage;
+  }
+  if (threads_count > conns_count) {
+    threads_count = conns_count;
+  }
+  const char *host = argv[optind];
+  const char *path = argc - optind > 2 ? argv[optind + 2] : "/";
+  target.sin_family = AF_INET;
+  target.sin_port = htons(atoi(argv[optind + 1]));
+  if (inet_pton(AF_INET, host, &target.sin_addr) != 1) {
+    fprintf(stderr, "Invalid IPv4 address %s\n", host);
+    return 1;
+  }
+  request_len = asprintf(&request,
+                         "GET %s HTTP/1.1\r\n"
+                         "Host: %s:%s\r\n"
+                         "User-Agent: alpha-bench\r\n"
+                         "Accept: */*\r\n"
+                         "\r\n",
+                         path, host, argv[optind + 1]);
+
+  LoadThread *threads = calloc(threads_count, sizeof(LoadThread));
+  LoadConnection *conns = calloc(conns_count, sizeof(LoadConnection));
+  if (!threads || !conns) {
+    fprintf(stderr, "Couldn't allocate connections\n");
+    return 1;
+  }
+  unsigned long long started = now_ns();
+  measure_from = started + warmup * 1e9;
+  measure_until = measure_from + duration * 1e9;
+  for (usize i = 0; i < threads_count; ++i) {
+    LoadThread *thread = &threads[i];
+    thread->conns = conns + conns_count * i / threads_count;
+    thread->conns_count =
+        conns_count * (i + 1) / threads_count - conns_count * i / threads_count;
+    thread->epoll_fd = epoll_create1(0);
+    for (usize j = 0; j < thread->conns_count; ++j) {
+      LoadConnection *conn = &thread->conns[j];
+      conn->in = malloc(RESPONSE_BUFFER_LEN);
+      if (!conn->in || load_connect(thread, conn) == -1) {
+        fprintf(stderr, "Couldn't connect: %s\n", strerror(errno));
+        return 1;
+      }
+    }
+  }
+  for (usize i = 0; i < threads_count; ++i) {
+    pthread_create(&threads[i].thread, NULL, load_thread, &threads[i]);
+  }
+
+  Histogram *latency = calloc(1, sizeof(Histogram));
+  unsigned long long requests = 0;
+  unsigned long long errors = 0;
+  unsigned long long reconnects = 0;
+  unsigned long long bytes = 0;
+  for (usize i = 0; i < threads_count; ++i) {
+    LoadThread *thread = &threads[i];
+    pthread_join(thread->thread, NULL);
+    for (usize j = 0; j < LATENCY_BUCKETS; ++j) {
+      latency->counts[j] += thread->latency.counts[j];
+    }
+    latency->total += thread->latency.total;
+    if (thread->latency.max > latency->max) {
+      latency->max = thread->latency.max;
+    }
+    requests += thread->requests;
+    errors += thread->errors;
+    reconnects += thread->reconnects;
+    bytes += thread->bytes;
+  }
+
+  printf("%s:%s%s, %lu threads, %lu connections, pipeline %lu, %.1fs\n", host,
+         argv[optind + 1], path, threads_count, conns_count, pipeline,
+         duration);
+  printf("  requests   %llu (%.0f/s), %.2f MB/s\n", requests,
+         requests / duration, bytes / duration / (1024 * 1024));
+  printf("  errors     %llu, reconnects %llu\n", errors, reconnects);
+  printf("  latency    p50 %.1fus  p90 %.1fus  p99 %.1fus  p999 %.1fus  "
+         "max %.1fus\n",
+         histogram_quantile(latency, 0.5) / 1e3,
+         histogram_quantile(latency, 0.9) / 1e3,
+         histogram_quantile(latency, 0.99) / 1e3,
+         histogram_quantile(latency, 0.999) / 1e3, latency->max / 1e3);
+  return errors ? 2 : 0;
+
+usage:
+  fprintf(stderr,
+          "usage: %s [-c connections] [-t threads] [-d seconds] "
+          "[-w warmup seconds] [-p pipeline] host port [path]\n",
+          argv[0]);
+  return 1;
+}
@@ -0,0 +1,266 @@
+// Micro-benchmarks of the per-request hot paths, each run single-threaded
+// for long enough to give a stable time per operation.
+//
+//   alpha_bench_micro [filter]
+//
+// Only benchmarks whose name contains `filter` are run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../exteral/jack/include/jack.h"
+
+#include "../include/alpha/arena.h"
+#include "../include/alpha/buffer.h"
+#include "../include/alpha/http.h"
+#include "../include/alpha/json.h"
+#include "../include/alpha/parser.h"
+#include "../include/alpha/router.h"
+
+// Runs are doubled until one takes at least this long
+#define BENCH_MIN_NS 200000000ULL
+
+typedef struct {
+  const char *name;
+  // Bytes processed per operation, 0 when a throughput makes no sense
+  usize bytes;
+  void (*setup)(void);
+  void (*run)(usize iterations);
+} Benchmark;
+
+// Results are folded into this so the compiler can't drop the work
+static volatile usize bench_sink;
+
+static const char SMALL_REQUEST[] = "GET / HTTP/1.1\r\n"
+                                    "Host: localhost\r\n"
+                                    "\r\n";
+
+static const char BROWSER_REQUEST[] =
+    "GET /api/v1/users/42/posts?page=2&sort=desc HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+    "(KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+    "image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9,pt;q=0.8\r\n"
+    "Cookie: session=4f1c2a9e8b7d6c5e4f3a2b1c; theme=dark; lang=en\r\n"
+    "Referer: https://www.example.com/users/42\r\n"
+    "If-None-Match: \"5e1a-18f3a2b1c00\"\r\n"
+    "X-Requested-With: XMLHttpRequest\r\n"
+    "\r\n";
+
+static const char JSON_DOCUMENT[] =
+    "{\"id\": 1042, \"name\": \"Ada Lovelace\", \"email\": "
+    "\"ada@example.com\", \"active\": true, \"manager\": null, "
+    "\"bio\": \"Wrote the first program for the engine\", "
+    "\"tags\": [\"admin\", \"math\", \"engines\", \"poetry\"], "
+    "\"scores\": [98, 87, 100, 76, 91, 88], "
+    "\"address\": {\"street\": \"12 St James's Square\", \"city\": "
+    "\"London\", \"zip\": \"SW1Y 4JH\"}, "
+    "\"posts\": [{\"id\": 1, \"title\": \"Notes\", \"likes\": 1843}, "
+    "{\"id\": 2, \"title\": \"Sketch of the Analytical Engine\", "
+    "\"likes\": 977}]}";
+
+static Router router;
+static Json json_object;
+static Buffer out;
+static Arena arena;
+
+unsigned long long bench_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void parse(const char *request, usize len, usize iterations) {
+  HttpParser parser;
+  for (usize i = 0; i < iterations; ++i) {
+    http_parser_reset(&parser);
+    bench_sink += http_parser_execute(&parser, request, len);
+    bench_sink += parser.headers.count;
+  }
+}
+
+void bench_parse_small(usize iterations) {
+  parse(SMALL_REQUEST, sizeof(SMALL_REQUEST) - 1, iterations);
+}
+
+void bench_parse_browser(usize iterations) {
+  parse(BROWSER_REQUEST, sizeof(BROWSER_REQUEST) - 1, iterations);
+}
+
+// Same request handed over one read at a time, as a slow client would
+void bench_parse_split(usize iterations) {
+  usize len = sizeof(BROWSER_REQUEST) - 1;
+  HttpParser parser;
+  for (usize i = 0; i < iterations; ++i) {
+    http_parser_reset(&parser);
+    for (usize read = 64; read < len; read += 64) {
+      bench_sink += http_parser_execute(&parser, BROWSER_REQUEST, read);
+    }
+    bench_sink += http_parser_execute(&parser, BROWSER_REQUEST, len);
+  }
+}
+
+Response bench_handler(Request req) {
+  (void)req;
+  return (Response){0};
+}
+
+// A REST-ish API of 64 routes, a mix of static and parameterised ones
+void setup_router(void) {
+  if (router._routesCount) {
+    return;
+  }
+  static const char *resources[] = {"users",    "posts",  "comments",
+                                    "albums",   "photos", "todos",
+                                    "products", "orders"};
+  static char paths[64][64];
+  usize count = 0;
+  for (usize i = 0; i < sizeof(resources) / sizeof(*resources); ++i) {
+    const char *r = resources[i];
+    const char *formats[] = {"/api/v1/%s",          "/api/v1/%s/:id",
+                             "/api/v1/%s/:id/edit", "/api/v1/%s/search",
+                             "/api/v2/%s",          "/api/v2/%s/:id",
+                             "/api/v2/%s/:id/%s",   "/%s/*rest"};
+    for (usize j = 0; j < sizeof(formats) / sizeof(*formats); ++j) {
+      snprintf(paths[count], sizeof(paths[count]), formats[j], r, r);
+      router_add(&router, GET, paths[count], bench_handler, NULL);
+      count++;
+    }
+  }
+}
+
+void route(char *path, usize iterations) {
+  RouteParams params;
+  for (usize i = 0; i < iterations; ++i) {
+    bench_sink += (usize)match_route(&router, path, GET, &params);
+  }
+}
+
+void bench_route_static(usize iterations) {
+  route("/api/v1/products/search", iterations);
+}
+
+void bench_route_params(usize iterations) {
+  route("/api/v2/orders/12345/orders", iterations);
+}
+
+void bench_route_wildcard(usize iterations) {
+  route("/photos/2024/summer/beach.jpg", iterations);
+}
+
+void bench_route_miss(usize iterations) {
+  route("/api/v3/users", iterations);
+}
+
+void bench_head(usize iterations) {
+  for (usize i = 0; i < iterations; ++i) {
+    out.len = 0;
+    http_write_head(&out, OK, "text/html; charset=utf-8", 1024 + (i & 1023),
+                    "", "");
+    bench_sink += out.len;
+  }
+}
+
+void bench_head_extra(usize iterations) {
+  for (usize i = 0; i < iterations; ++i) {
+    out.len = 0;
+    http_write_head(&out, NOT_FOUND, "application/json", i & 1023,
+                    "Cache-Control: no-store\r\nVary: Accept-Encoding\r\n",
+                    "Connection: keep-alive\r\n");
+    bench_sink += out.len;
+  }
+}
+
+void setup_json(void) {
+  if (json_object.entries) {
+    return;
+  }
+  char *source = strdup(JSON_DOCUMENT);
+  json_object = Json_Parse(source);
+  free(source);
+}
+
+void bench_json_write(usize iterations) {
+  for (usize i = 0; i < iterations; ++i) {
+    out.len = 0;
+    json_write(&out, &json_object);
+    bench_sink += out.len;
+  }
+}
+
+// The serializer responses used before json_write, kept as a baseline
+void bench_json_stringfy(usize iterations) {
+  for (usize i = 0; i < iterations; ++i) {
+    char *str = Json_Stringfy(json_object, 0);
+    bench_sink += (usize)str[0];
+    free(str);
+  }
+}
+
+void bench_json_parse(usize iterations) {
+  JsonError error;
+  for (usize i = 0; i < iterations; ++i) {
+    arena_reset(&arena);
+    const JsonNode *node = json_parse(&arena, JSON_DOCUMENT,
+                                      sizeof(JSON_DOCUMENT) - 1, &error);
+    bench_sink += node ? node->count : 0;
+  }
+}
+
+static const Benchmark BENCHMARKS[] = {
+    {"parse/small", sizeof(SMALL_REQUEST) - 1, NULL, bench_parse_small},
+    {"parse/browser", sizeof(BROWSER_REQUEST) - 1, NULL, bench_parse_browser},
+    {"parse/split", sizeof(BROWSER_REQUEST) - 1, NULL, bench_parse_split},
+    {"route/static", 0, setup_router, bench_route_static},
+    {"route/params", 0, setup_router, bench_route_params},
+    {"route/wildcard", 0, setup_router, bench_route_wildcard},
+    {"route/miss", 0, setup_router, bench_route_miss},
+    {"head/plain", 0, NULL, bench_head},
+    {"head/extra", 0, NULL, bench_head_extra},
+    {"json/write", 0, setup_json, bench_json_write},
+    {"json/stringfy", 0, setup_json, bench_json_stringfy},
+    {"json/parse", sizeof(JSON_DOCUMENT) - 1, NULL, bench_json_parse},
+};
+
+int main(int argc, char **argv) {
+  const char *filter = argc > 1 ? argv[1] : "";
+  printf("%-16s %12s %14s %10s\n", "benchmark", "ns/op", "ops/s", "MB/s");
+  for (usize i = 0; i < sizeof(BENCHMARKS) / sizeof(*BENCHMARKS); ++i) {
+    const Benchmark *bench = &BENCHMARKS[i];
+    if (!strstr(bench->name, filter)) {
+      continue;
+    }
+    if (bench->setup) {
+      bench->setup();
+    }
+    // Warms caches and branch predictors before anything is timed
+    bench->run(1000);
+    usize iterations = 1000;
+    unsigned long long elapsed;
+    while (1) {
+      unsigned long long started = bench_now_ns();
+      bench->run(iterations);
+      elapsed = bench_now_ns() - started;
+      if (elapsed >= BENCH_MIN_NS) {
+        break;
+      }
+      iterations *= 2;
+    }
+    double ns = (double)elapsed / iterations;
+    printf("%-16s %12.1f %14.0f", bench->name, ns, 1e9 / ns);
+    if (bench->bytes) {
+      printf(" %10.1f", bench->bytes * 1e3 / ns);
+    }
+    printf("\n");
+  }
+  buffer_free(&out);
+  arena_free(&arena);
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Reference server the load generator is pointed at. Keep-alive connections
+// are never closed by the server and nothing is logged, so runs measure
+// request handling rather than reconnects or stdout.
+//
+//   alpha_bench_server [threads|epoll|sharded|uring] [port] [loops or workers]
+//
+// Routes:
+//   GET /             small HTML page
+//   GET /json         JSON object serialized on every request
+//   GET /users/:id    HTML page built in the request arena
+//   GET /metrics      Prometheus metrics of the run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../exteral/jack/include/jack.h"
+
+#include "../include/alpha.h"
+
+static Json user;
+
+Response home(Request req) {
+  (void)req;
+  return (Response){.type = RESPONSE_HTML,
+                    .statusCode = OK,
+                    .payload.html = {.title = "Alpha",
+                                     .body = "<h1>Hello, World!</h1>"}};
+}
+
+Response json(Request req) {
+  (void)req;
+  return (Response){
+      .type = RESPONSE_JSON, .statusCode = OK, .payload.jsonObject = &user};
+}
+
+Response user_page(Request req) {
+  Slice id = Request_GetParam(&req, "id");
+  char *body = Request_Sprintf(&req, "<h1>User %.*s</h1>", (int)id.len,
+                               id.ptr);
+  return (Response){.type = RESPONSE_HTML,
+                    .statusCode = OK,
+                    .payload.html = {.title = "User", .body = body}};
+}
+
+int main(int argc, char **argv) {
+  AlphaConfig config = Alpha_DefaultConfig();
+  const char *mode = argc > 1 ? argv[1] : "epoll";
+  if (strcmp(mode, "threads") == 0) {
+    config.mode = ALPHA_RUN_THREADS;
+  } else if (strcmp(mode, "epoll") == 0) {
+    config.mode = ALPHA_RUN_EPOLL;
+  } else if (strcmp(mode, "sharded") == 0) {
+    config.mode = ALPHA_RUN_SHARDED;
+  } else if (strcmp(mode, "uring") == 0) {
+    config.mode = ALPHA_RUN_URING;
+  } else {
+    fprintf(stderr,
+            "usage: %s [threads|epoll|sharded|uring] [port] [threads]\n",
+            argv[0]);
+    return 1;
+  }
+  usize port = argc > 2 ? strtoul(argv[2], NULL, 10) : 8080;
+  if (argc > 3) {
+    config.threads = strtoul(argv[3], NULL, 10);
+    config.workers = config.threads;
+  }
+  config.max_requests_per_connection = 0;
+  config.access_log = ACCESS_LOG_OFF;
+  config.metrics_path = "/metrics";
+
+  char source[] = "{\"id\": 1042, \"name\": \"Ada Lovelace\", \"email\": "
+                  "\"ada@example.com\", \"active\": true, \"tags\": "
+                  "[\"admin\", \"math\"], \"scores\": [98, 87, 100]}";
+  user = Json_Parse(source);
+
+  AlphaApp app = Alpha_NewWithConfig("127.0.0.1", port, config);
+  if (app._fileDescriptor == -1) {
+    return 1;
+  }
+  Alpha_Get(&app, "/", home);
+  Alpha_Get(&app, "/json", json);
+  Alpha_Get(&app, "/users/:id", user_page);
+  printf("Listening on 127.0.0.1:%lu (%s)\n", port, mode);
+  fflush(stdout);
+  Alpha_Run(&app);
+  return 0;
+}
@@ -30,22 +30,28 @@ void Log(FILE *file, LogLevel level, char *message, ...);
 #include <stdlib.h>
 #include <time.h>
 
-char *datetime_str() {
+/// Formats the current local time into `time_str`, which must hold 20 bytes
+void datetime_str(char *time_str) {
   time_t current_time;
   time(&current_time);
-  struct tm *local_time = localtime(&current_time);
-  char *time_str = (char *)malloc(sizeof(char) * 20);
-  strftime(time_str, 19, "%Y-%m-%d %H:%M:%S", local_time);
-  return time_str;
+  struct tm local_time;
+  localtime_r(&current_time, &local_time);
+  strftime(time_str, 20, "%Y-%m-%d %H:%M:%S", &local_time);
 }
 
 void Log(FILE *file, LogLevel level, char *message, ...) {
-  fprintf(file, "[%s] %s ", datetime_str(), LogLevel(level));
+  char time_str[20];
+  datetime_str(time_str);
+  // The whole line is written under the stream's lock so lines logged from
+  // different threads don't interleave
+  flockfile(file);
+  fprintf(file, "[%s] %s ", time_str, LogLevel(level));
   va_list args;
   va_start(args, message);
   vfprintf(file, message, args);
   va_end(args);
   fprintf(file, "\n");
+  funlockfile(file);
 }
 #endif // LOG4C_IMPLEMENTATION
 
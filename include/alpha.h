@@ -1,23 +1,127 @@
 #ifndef ALPHA
 #define ALPHA
 
+#include "alpha/access_log.h"
+#include "alpha/admission.h"
 #include "alpha/common.h"
+#include "alpha/compress_cache.h"
+#include "alpha/metrics.h"
 #include "alpha/router.h"
+#include "alpha/static_cache.h"
 
 #define BACK_LOG 5120
 #if !defined(STATIC_FOLDER_PATH)
 #define STATIC_FOLDER_PATH "static/"
 #endif
 
+typedef enum {
+  // Pre-started pool of blocking workers fed by the accepting thread
+  ALPHA_RUN_THREADS = 1,
+  // Non-blocking sockets multiplexed by edge-triggered epoll loops
+  ALPHA_RUN_EPOLL = 2,
+  // One SO_REUSEPORT listening socket and epoll loop per CPU, each pinned
+  ALPHA_RUN_SHARDED = 3,
+  // Sharded like ALPHA_RUN_SHARDED, with io_uring doing the I/O. Falls back
+  // to ALPHA_RUN_SHARDED on kernels without the support it needs.
+  ALPHA_RUN_URING = 4,
+} AlphaRunMode;
+
+typedef struct {
+  AlphaRunMode mode;
+  // Event loops (or shards) for the epoll and io_uring modes, 0 means one
+  // per online CPU
+  usize threads;
+  // Workers for ALPHA_RUN_THREADS, 0 means WORKER_POOL_WORKERS_PER_CPU per CPU
+  usize workers;
+  // Accepted clients waiting for a worker, rounded up to a power of two
+  usize queue_capacity;
+  // Requests served on one keep-alive connection before closing it, 0 means
+  // no limit
+  usize max_requests_per_connection;
+  // Memory for file responses kept in RAM with their headers, 0 disables
+  // the cache
+  usize static_cache_bytes;
+  // Larger files are always streamed with sendfile(2)
+  usize static_cache_max_file;
+  // Memory for gzipped HTML and JSON responses, each distinct body being
+  // compressed once. 0 disables compressing them, as does building without
+  // zlib.
+  usize compress_cache_bytes;
+  // Smaller bodies aren't worth compressing
+  usize compress_min_bytes;
+  // Largest request body buffered for a handler, streamed routes aren't
+  // limited
+  usize max_body_bytes;
+  // Requests written to stdout by a background thread
+  AccessLogLevel access_log;
+  // Log one in this many successful requests, errors are always logged
+  usize access_log_sample;
+  // Records each serving thread can have waiting for the writer before
+  // further ones are dropped. Every thread that logs allocates its ring of
+  // 128-byte records, kept until exit: 0 picks 256 (32 KiB) per worker in
+  // ALPHA_RUN_THREADS and 4096 (512 KiB) per event loop otherwise.
+  usize access_log_ring;
+  // Path answering GET requests with per-route counters and latency
+  // histograms in Prometheus text format, NULL disables metrics altogether
+  char *metrics_path;
+  // Pending connections the kernel queues before refusing them
+  usize backlog;
+  // Connections open (or waiting for a worker) at once, 0 means no limit.
+  // Clients beyond it are turned away as soon as they're accepted.
+  usize max_connections;
+  // Requests being read or handled at once, 0 means no limit
+  usize max_in_flight;
+  // Requests that waited longer than this for a worker, or behind other
+  // requests on their connection, are turned away unhandled. The wait
+  // starts once a request was sent, not at accept. 0 disables it.
+  usize queue_timeout_ms;
+  // How clients beyond the limits are turned away
+  AdmissionAction overload;
+  // Seconds announced in the 503's Retry-After
+  usize retry_after;
+  // Connections are closed once a request head took longer than this to
+  // arrive, or once the body, the client reading the response or the next
+  // keep-alive request stalled for longer. 0 disables the timeout.
+  usize header_timeout_ms;
+  usize body_timeout_ms;
+  usize write_timeout_ms;
+  usize idle_timeout_ms;
+  // Idle timeout between keep-alive requests in ALPHA_RUN_THREADS, where an
+  // idle connection holds a whole worker. Kept short so idle keep-alive
+  // clients can't starve new ones waiting in the queue, at the price of
+  // clients reconnecting more often after a pause. 0 disables the timeout.
+  usize worker_idle_timeout_ms;
+} AlphaConfig;
+
 typedef struct {
   int _fileDescriptor;
+  char *_host;
   usize _port;
   usize _backLog;
+  AlphaConfig _config;
   Router _router;
+  StaticCache *_staticCache;
+  CompressCache *_compressCache;
+  AccessLog *_accessLog;
+  Metrics *_metrics;
+  // NULL when no limit is set
+  Admission *_admission;
 } AlphaApp;
 
+AlphaConfig Alpha_DefaultConfig();
 AlphaApp Alpha_New(char *host, unsigned long port);
-void Alpha_Get(AlphaApp *app, char *path, AlphaRouteHandler handler);
+AlphaApp Alpha_NewWithConfig(char *host, unsigned long port,
+                             AlphaConfig config);
+// Returns -1 if the route is invalid or already registered
+int Alpha_Get(AlphaApp *app, char *path, AlphaRouteHandler handler);
+int Alpha_Post(AlphaApp *app, char *path, AlphaRouteHandler handler);
+int Alpha_Put(AlphaApp *app, char *path, AlphaRouteHandler handler);
+int Alpha_Delete(AlphaApp *app, char *path, AlphaRouteHandler handler);
+int Alpha_Patch(AlphaApp *app, char *path, AlphaRouteHandler handler);
+// Registers a route whose body is handed to `on_body` piece by piece instead
+// of being held in memory, `handler` answering once it has all been read
+int Alpha_Stream(AlphaApp *app, HttpMethod method, char *path,
+                 AlphaBodyHandler on_body, AlphaRouteHandler handler);
 void Alpha_Run(AlphaApp *app);
 
 #endif
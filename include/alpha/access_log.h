@@ -0,0 +1,67 @@
+#ifndef ALPHA_ACCESS_LOG
+#define ALPHA_ACCESS_LOG
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "http.h"
+
+#define ACCESS_LOG_PATH_MAX 104
+
+typedef enum {
+  // Every request, thinned out by `access_log_sample`
+  ACCESS_LOG_ALL = 1,
+  // Only 4xx and 5xx responses, never sampled
+  ACCESS_LOG_ERRORS = 2,
+  ACCESS_LOG_OFF = 3,
+} AccessLogLevel;
+
+// What a serving thread hands the writer: fixed size, so pushing one is a
+// copy into the ring and nothing is formatted on the hot path. Paths longer
+// than the record are cut.
+typedef struct {
+  time_t time;
+  uint32_t duration_us;
+  uint16_t status;
+  uint8_t method_len;
+  // Length of the whole path, up to 255
+  uint8_t path_len;
+  char method[8];
+  char path[ACCESS_LOG_PATH_MAX];
+} AccessRecord;
+
+// Single-producer/single-consumer ring owned by one serving thread and
+// drained by the writer
+typedef struct AccessLogRing {
+  struct AccessLogRing *next;
+  AccessRecord *records;
+  usize mask;
+  // Producer-side count of requests seen, for sampling
+  usize seen;
+  _Alignas(64) atomic_size_t head;
+  _Alignas(64) atomic_size_t tail;
+  atomic_size_t dropped;
+} AccessLogRing;
+
+typedef struct {
+  AccessLogLevel level;
+  usize sample;
+  usize ring_capacity;
+  FILE *file;
+  // Rings are only ever added, the writer walks the list without a lock
+  _Atomic(AccessLogRing *) rings;
+  pthread_mutex_t rings_lock;
+  // Records lost to full rings, over the whole run
+  atomic_size_t dropped;
+} AccessLog;
+
+AccessLog *access_log_new(AccessLogLevel level, usize sample,
+                          usize ring_capacity, FILE *file);
+void access_log_record(AccessLog *log, Slice method, const char *path,
+                       StatusCode status, const struct timespec *started);
+usize access_log_dropped(AccessLog *log);
+
+#endif
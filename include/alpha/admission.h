@@ -0,0 +1,44 @@
+#ifndef ALPHA_ADMISSION
+#define ALPHA_ADMISSION
+
+#include <stdatomic.h>
+#include <time.h>
+
+#include "buffer.h"
+
+typedef enum {
+  // Answer with a prebuilt 503 carrying Retry-After, then close
+  ADMISSION_REJECT = 1,
+  // Close without answering
+  ADMISSION_CLOSE = 2,
+} AdmissionAction;
+
+// Limits shared by every serving thread. Each counter sits on a cache line of
+// its own since they're bumped on every connection and request.
+typedef struct {
+  usize max_connections;
+  usize max_in_flight;
+  // Nanoseconds, 0 never sheds queued requests
+  unsigned long long queue_timeout;
+  // Whole reply sent to turned away clients, empty for ADMISSION_CLOSE
+  Buffer reply;
+  _Alignas(64) atomic_size_t connections;
+  _Alignas(64) atomic_size_t in_flight;
+  _Alignas(64) atomic_size_t rejected;
+} Admission;
+
+Admission *admission_new(usize max_connections, usize max_in_flight,
+                         usize queue_timeout_ms, AdmissionAction action,
+                         usize retry_after);
+int admission_connection_acquire(Admission *admission);
+void admission_connection_release(Admission *admission);
+int admission_request_acquire(Admission *admission);
+void admission_request_release(Admission *admission);
+int admission_expired(Admission *admission, const struct timespec *since,
+                      const struct timespec *now);
+const Buffer *admission_turn_away(Admission *admission);
+void admission_refuse(Admission *admission, Buffer *out);
+void admission_reject(Admission *admission, int fd);
+usize admission_rejected(Admission *admission);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef ALPHA_ARENA
+#define ALPHA_ARENA
+
+#include "common.h"
+
+typedef struct ArenaChunk {
+  struct ArenaChunk *next;
+  usize cap;
+  usize used;
+  _Alignas(16) char data[];
+} ArenaChunk;
+
+// Bump allocator: allocations are never freed one by one, the whole arena
+// is reset at once. The newest chunk is the largest and is kept across
+// resets, so a connection settles on a single chunk that fits its requests.
+typedef struct {
+  ArenaChunk *head;
+} Arena;
+
+void *arena_alloc(Arena *arena, usize size);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef ALPHA_BODY
+#define ALPHA_BODY
+
+#include "common.h"
+
+typedef enum {
+  CHUNK_SIZE = 1,
+  CHUNK_EXTENSION = 2,
+  CHUNK_SIZE_LF = 3,
+  CHUNK_DATA = 4,
+  CHUNK_DATA_END = 5,
+  CHUNK_DATA_LF = 6,
+  CHUNK_TRAILER = 7,
+  CHUNK_TRAILER_LINE = 8,
+  CHUNK_TRAILER_LF = 9,
+  CHUNK_DONE = 10,
+} ChunkState;
+
+typedef enum {
+  BODY_INCOMPLETE = 0,
+  BODY_DONE = 1,
+  BODY_ERROR = 2,
+} BodyResult;
+
+// Frames a request body, by Content-Length or decoding
+// `Transfer-Encoding: chunked` in place. Offsets are relative to the start of
+// the body, so the buffer holding it may move between calls.
+typedef struct {
+  int chunked;
+  // Content-Length bytes not consumed yet
+  usize remaining;
+  ChunkState state;
+  usize chunk_left;
+  usize line_len;
+  // Raw bytes processed, and decoded bytes stored contiguously in front of
+  // them
+  usize consumed;
+  usize decoded;
+  // Decoded bytes over the whole body, including discarded ones
+  usize total;
+} BodyReader;
+
+void body_reader_init(BodyReader *reader, int chunked, usize length);
+BodyResult body_reader_execute(BodyReader *reader, char *data, usize len);
+// Forgets the decoded bytes once the caller dropped the first `consumed`
+// bytes of the body
+void body_reader_discard(BodyReader *reader);
+// Forgets the chunk framing once the caller dropped the bytes between
+// `decoded` and `consumed`
+void body_reader_compact(BodyReader *reader);
+int body_parse_length(Slice value, usize *length);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef ALPHA_BUFFER
+#define ALPHA_BUFFER
+
+#include <stdarg.h>
+
+#include "common.h"
+
+typedef struct {
+  char *data;
+  usize len;
+  usize cap;
+} Buffer;
+
+int buffer_reserve(Buffer *buf, usize extra);
+int buffer_append(Buffer *buf, const void *data, usize len);
+int buffer_appendf(Buffer *buf, const char *fmt, ...);
+int buffer_vappendf(Buffer *buf, const char *fmt, va_list args);
+int buffer_append_usize(Buffer *buf, usize value);
+void buffer_consume(Buffer *buf, usize len);
+void buffer_free(Buffer *buf);
+
+#endif
@@ -1,7 +1,34 @@
 #ifndef ALPHA_COMMON
 #define ALPHA_COMMON
 
-#define ROUTER_INIT_CAP 512
+#define REQUEST_HEAD_MAX 8192
+#define REQUEST_BODY_MAX (1024 * 1024)
+#define MAX_REQUESTS_PER_CONNECTION 1000
+#define STATIC_CACHE_DEFAULT_BYTES (32 * 1024 * 1024)
+#define STATIC_CACHE_DEFAULT_MAX_FILE (1024 * 1024)
+#define COMPRESS_DEFAULT_MIN_BYTES 1024
+#define WORKER_POOL_WORKERS_PER_CPU 16
+#define WORKER_POOL_DEFAULT_QUEUE_CAP 1024
+#define REQUEST_HEADERS_MAX 64
+#define ROUTE_PARAMS_MAX 16
+#define JSON_DEPTH_MAX 128
+#define ARENA_CHUNK_MIN 4096
+#define ARENA_RETAIN_MAX (256 * 1024)
+#define STREAM_BUFFER_MAX (64 * 1024)
+#define ACCESS_LOG_RING_DEFAULT 4096
+#define ACCESS_LOG_RING_WORKER_DEFAULT 256
+#define ADMISSION_RETRY_AFTER_DEFAULT 1
+#define HEADER_TIMEOUT_DEFAULT_MS (10 * 1000)
+#define BODY_TIMEOUT_DEFAULT_MS (30 * 1000)
+#define IDLE_TIMEOUT_DEFAULT_MS (60 * 1000)
+#define WORKER_IDLE_TIMEOUT_DEFAULT_MS (2 * 1000)
+#define WRITE_TIMEOUT_DEFAULT_MS (30 * 1000)
 typedef unsigned long usize;
 
+// Non-owning view into a buffer, not NUL terminated
+typedef struct {
+  const char *ptr;
+  usize len;
+} Slice;
+
 #endif
@@ -0,0 +1,39 @@
+#ifndef ALPHA_COMPRESS_CACHE
+#define ALPHA_COMPRESS_CACHE
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "common.h"
+
+#define COMPRESS_CACHE_SLOTS 1024
+#define COMPRESS_CACHE_LOCKS 64
+
+// The gzip encoding of a dynamic response body, found again by the body's
+// content. `data` is NULL when the body didn't shrink and goes out as is.
+typedef struct CompressedEntry {
+  usize hash;
+  // One reference for the cache plus one per response still being sent
+  atomic_uint refs;
+  usize bytes;
+  char *plain;
+  usize plain_len;
+  char *data;
+  usize len;
+} CompressedEntry;
+
+// Direct-mapped: a body evicts whatever other body its hash lands on
+typedef struct {
+  usize budget;
+  usize min_len;
+  atomic_ulong bytes;
+  pthread_mutex_t locks[COMPRESS_CACHE_LOCKS];
+  CompressedEntry *slots[COMPRESS_CACHE_SLOTS];
+} CompressCache;
+
+CompressCache *compress_cache_new(usize budget, usize min_len);
+CompressedEntry *compress_cache_get(CompressCache *cache, const char *body,
+                                    usize len);
+void compress_cache_release(void *entry);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef ALPHA_CONDITIONAL
+#define ALPHA_CONDITIONAL
+
+#include <sys/stat.h>
+#include <time.h>
+
+#include "headers.h"
+
+#define ETAG_MAX 64
+#define HTTP_DATE_MAX 32
+// Room for the validator lines plus the encoding headers that follow them
+#define VALIDATOR_HEADERS_MAX (ETAG_MAX + HTTP_DATE_MAX + 128)
+
+// What a client can revalidate a file response with
+typedef struct {
+  // Quoted strong ETag built from the inode, size and mtime
+  char etag[ETAG_MAX];
+  char last_modified[HTTP_DATE_MAX];
+  time_t mtime;
+} FileValidators;
+
+void file_validators(const struct stat *file_stat, FileValidators *out);
+int is_not_modified(const HttpHeaders *headers,
+                    const FileValidators *validators);
+int if_range_matches(const HttpHeaders *headers,
+                     const FileValidators *validators);
+
+#endif
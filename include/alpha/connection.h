@@ -0,0 +1,133 @@
+#ifndef ALPHA_CONNECTION
+#define ALPHA_CONNECTION
+
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "body.h"
+#include "buffer.h"
+#include "parser.h"
+#include "request_dto.h"
+#include "timer_wheel.h"
+
+typedef enum {
+  // All pending output went out, only returned by connection_flush
+  CONNECTION_DONE = 0,
+  CONNECTION_WANT_READ = 1,
+  CONNECTION_WANT_WRITE = 2,
+  CONNECTION_CLOSE = 3,
+} ConnectionStatus;
+
+// What the connection waits for, each with its own timeout
+typedef enum {
+  CONNECTION_IDLE = 1,
+  CONNECTION_READING_HEAD = 2,
+  CONNECTION_READING_BODY = 3,
+  CONNECTION_WRITING = 4,
+} ConnectionPhase;
+
+// Pieces of output sent with one sendmsg(2)
+#define OUTPUT_IOV_MAX 64
+
+typedef enum {
+  OUTPUT_FILE = 1,
+  OUTPUT_MEMORY = 2,
+} OutputKind;
+
+// Body bytes that don't live in `out`: a file sent straight from the page
+// cache, or memory owned by someone else. Each goes out once `out` has been
+// flushed up to `at`, so they interleave correctly with pipelined responses.
+typedef struct {
+  OutputKind kind;
+  usize at;
+  usize remaining;
+  int fd;
+  off_t offset;
+  const char *data;
+  void (*release)(void *arg);
+  void *release_arg;
+} OutputSegment;
+
+typedef struct Connection {
+  Client client;
+  AlphaApp *app;
+  Buffer in;
+  // Start of the next unhandled request in `in`
+  usize in_offset;
+  HttpParser parser;
+  // Set once the head of the current request was handled and its body is
+  // being read
+  int reading_body;
+  BodyReader body;
+  // Request.context, kept between the body callbacks and the handler
+  void *context;
+  // Route of the current request, matched once its head is complete. The
+  // captured params point into `in` at `route_path`, and move along with it.
+  int routed;
+  const Route *route;
+  HttpMethod method;
+  RouteParams params;
+  const char *route_path;
+  // Handlers' request-scoped memory, reset after each request
+  Arena arena;
+  Buffer out;
+  usize out_sent;
+  // Response bodies rendered before it is known how they go out
+  Buffer scratch;
+  OutputSegment *segments;
+  usize segments_head;
+  usize segments_count;
+  usize segments_capacity;
+  // Lazily created pipe for splice(2) when sendfile(2) can't be used, and
+  // how many bytes sit in it waiting for the socket
+  int pipe_fds[2];
+  usize pipe_len;
+  int blocking;
+  // Whether the response being built leaves the connection open
+  int keep_alive;
+  // HTTP/1.0 peers need keep-alive spelled out in the response
+  int http10;
+  usize requests_count;
+  // When the head of the current request was complete, for the access log
+  struct timespec request_started;
+  // When input last arrived, so no later than the current request's head was
+  // complete. Only kept when admission limits are set.
+  struct timespec received;
+  // Whether the current request counts against the in-flight limit
+  int admitted;
+  int close_after_write;
+  // Response still being produced, later requests wait behind it
+  StreamPayload stream;
+  // HTTP/1.0 peers get the raw body, ended by closing the connection
+  int stream_chunked;
+  ConnectionPhase phase;
+  // Clock (timer_clock_ms) time the connection is closed at unless it made
+  // progress by then, 0 for never. Read by the reaper of blocking workers.
+  atomic_ullong deadline;
+  // Entry in the event loop's timer wheel
+  Timer timer;
+} Connection;
+
+void connection_init(Connection *conn, AlphaApp *app, Client client,
+                     int blocking);
+ConnectionStatus connection_serve(Connection *conn);
+ConnectionStatus connection_flush(Connection *conn);
+int connection_has_output(Connection *conn);
+usize connection_gather_output(Connection *conn, struct iovec *iov,
+                               int *more);
+void connection_advance_output(Connection *conn, usize sent);
+void connection_reset_output(Connection *conn);
+int connection_receive(Connection *conn, const char *data, usize len);
+int connection_queue_file(Connection *conn, int fd, off_t offset, usize len);
+int connection_queue_memory(Connection *conn, const char *data, usize len,
+                            void (*release)(void *), void *release_arg);
+const char *connection_header(Connection *conn);
+void connection_arm(Connection *conn, unsigned long long now_ms);
+void connection_schedule(Connection *conn, TimerWheel *timers,
+                         unsigned long long now_ms);
+void connection_reuse(Connection *conn, Client client);
+void connection_close(Connection *conn);
+void connection_free(Connection *conn);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef ALPHA_ENCODING
+#define ALPHA_ENCODING
+
+#include "common.h"
+
+// Content codings a response can be sent in, usable as a mask
+typedef enum ContentEncoding {
+  ENCODING_GZIP = 1,
+  ENCODING_BR = 2,
+} ContentEncoding;
+
+#define VARY_ACCEPT_ENCODING "Vary: Accept-Encoding\r\n"
+
+unsigned accepted_encodings(Slice accept_encoding);
+int is_compressible(const char *content_type);
+unsigned precompressed_siblings(const char *path);
+const char *encoding_suffix(ContentEncoding encoding);
+const char *encoding_headers(unsigned encoding, const char *content_type);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef ALPHA_EVENT_LOOP
+#define ALPHA_EVENT_LOOP
+
+#include "../alpha.h"
+#include "timer_wheel.h"
+
+typedef struct {
+  AlphaApp *app;
+  int epoll_fd;
+  int listen_fd;
+  // Deadlines of the loop's connections
+  TimerWheel timers;
+} EventLoop;
+
+int event_loop_init(EventLoop *loop, AlphaApp *app, int listen_fd);
+void *EventLoopHandler(void *arg);
+
+#endif
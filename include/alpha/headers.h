@@ -0,0 +1,56 @@
+#ifndef ALPHA_HEADERS
+#define ALPHA_HEADERS
+
+#include "common.h"
+
+// Headers the parser recognises while parsing, so lookups for them are a
+// single array access instead of a case-insensitive scan
+typedef enum {
+  HEADER_UNKNOWN = 0,
+  HEADER_ACCEPT,
+  HEADER_ACCEPT_ENCODING,
+  HEADER_ACCEPT_LANGUAGE,
+  HEADER_AUTHORIZATION,
+  HEADER_CACHE_CONTROL,
+  HEADER_CONNECTION,
+  HEADER_CONTENT_LENGTH,
+  HEADER_CONTENT_TYPE,
+  HEADER_COOKIE,
+  HEADER_EXPECT,
+  HEADER_HOST,
+  HEADER_IF_MATCH,
+  HEADER_IF_MODIFIED_SINCE,
+  HEADER_IF_NONE_MATCH,
+  HEADER_IF_RANGE,
+  HEADER_IF_UNMODIFIED_SINCE,
+  HEADER_ORIGIN,
+  HEADER_RANGE,
+  HEADER_REFERER,
+  HEADER_TRANSFER_ENCODING,
+  HEADER_UPGRADE,
+  HEADER_USER_AGENT,
+  HEADER_X_FORWARDED_FOR,
+  HEADERS_KNOWN_COUNT,
+} HeaderId;
+
+typedef struct {
+  Slice name;
+  Slice value;
+  HeaderId id;
+} HttpHeader;
+
+typedef struct {
+  HttpHeader entries[REQUEST_HEADERS_MAX];
+  usize count;
+  // 1-based index into `entries` of the first header with each known id
+  unsigned char first[HEADERS_KNOWN_COUNT];
+} HttpHeaders;
+
+HeaderId header_id(Slice name);
+void headers_reset(HttpHeaders *headers);
+int headers_add(HttpHeaders *headers, Slice name, Slice value);
+const HttpHeader *headers_find(const HttpHeaders *headers, HeaderId id);
+const HttpHeader *headers_find_name(const HttpHeaders *headers,
+                                    const char *name);
+
+#endif
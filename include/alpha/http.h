@@ -1,12 +1,62 @@
 #ifndef ALPHA_HTTP
 #define ALPHA_HTTP
 
-typedef enum { GET = 1, POST = 2 } HttpMethod;
+#include "buffer.h"
+
+typedef enum {
+  GET = 1,
+  POST = 2,
+  PUT = 3,
+  DELETE = 4,
+  PATCH = 5,
+} HttpMethod;
+#define HTTP_METHODS_COUNT 5
 
 typedef enum {
   OK = 200,
+  CREATED = 201,
+  ACCEPTED = 202,
+  NO_CONTENT = 204,
+  PARTIAL_CONTENT = 206,
+  MOVED_PERMANENTLY = 301,
+  FOUND = 302,
+  SEE_OTHER = 303,
+  NOT_MODIFIED = 304,
+  TEMPORARY_REDIRECT = 307,
+  PERMANENT_REDIRECT = 308,
+  BAD_REQUEST = 400,
+  UNAUTHORIZED = 401,
+  FORBIDDEN = 403,
   NOT_FOUND = 404,
+  METHOD_NOT_ALLOWED = 405,
+  REQUEST_TIMEOUT = 408,
+  CONFLICT = 409,
+  GONE = 410,
+  LENGTH_REQUIRED = 411,
+  PRECONDITION_FAILED = 412,
+  PAYLOAD_TOO_LARGE = 413,
+  URI_TOO_LONG = 414,
+  UNSUPPORTED_MEDIA_TYPE = 415,
+  RANGE_NOT_SATISFIABLE = 416,
+  EXPECTATION_FAILED = 417,
+  UNPROCESSABLE_CONTENT = 422,
+  TOO_MANY_REQUESTS = 429,
+  HEADER_FIELDS_TOO_LARGE = 431,
   INTERNAL_ERROR = 500,
+  NOT_IMPLEMENTED = 501,
+  BAD_GATEWAY = 502,
+  SERVICE_UNAVAILABLE = 503,
+  GATEWAY_TIMEOUT = 504,
+  HTTP_VERSION_NOT_SUPPORTED = 505,
 } StatusCode;
 
+// Codes below this have their status line prebuilt
+#define HTTP_STATUS_MAX 600
+
+Slice http_status_line(StatusCode status);
+int http_write_status_line(Buffer *out, StatusCode status);
+int http_write_head(Buffer *out, StatusCode status, const char *content_type,
+                    usize content_length, const char *extra_headers,
+                    const char *connection);
+
 #endif
@@ -0,0 +1,61 @@
+#ifndef ALPHA_JSON
+#define ALPHA_JSON
+
+#include "arena.h"
+#include "buffer.h"
+
+struct Json;
+struct JsonValue;
+
+typedef enum {
+  JSON_NODE_NULL = 1,
+  JSON_NODE_FALSE,
+  JSON_NODE_TRUE,
+  JSON_NODE_NUMBER,
+  JSON_NODE_STRING,
+  JSON_NODE_ARRAY,
+  JSON_NODE_OBJECT,
+} JsonNodeType;
+
+struct JsonMember;
+
+// Parsed JSON value. Only the fields of its type are set.
+typedef struct JsonNode {
+  JsonNodeType type;
+  // Numbers: `integer` is exact when `is_integer` is set, `number` always
+  // holds the value
+  int is_integer;
+  long long integer;
+  double number;
+  // Strings, decoded and not NUL-terminated
+  Slice string;
+  // Arrays and objects
+  usize count;
+  struct JsonNode *items;
+  struct JsonMember *members;
+} JsonNode;
+
+typedef struct JsonMember {
+  Slice key;
+  JsonNode value;
+} JsonMember;
+
+typedef struct {
+  const char *message;
+  // Byte offset in the input the error was found at
+  usize offset;
+} JsonError;
+
+int json_write(Buffer *out, const struct Json *object);
+int json_write_value(Buffer *out, const struct JsonValue *value);
+int json_write_string(Buffer *out, const char *str, usize len);
+const char *json_find_escape(const char *ptr, const char *end);
+
+// Nodes go in `arena`. The index of tokens the parser works from is only
+// held on the heap while parsing, at most 4 bytes per input byte.
+const JsonNode *json_parse(Arena *arena, const char *data, usize len,
+                           JsonError *error);
+// Value of `key` in an object, NULL if absent or `object` isn't one
+const JsonNode *JsonNode_Get(const JsonNode *object, const char *key);
+
+#endif
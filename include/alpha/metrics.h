@@ -0,0 +1,50 @@
+#ifndef ALPHA_METRICS
+#define ALPHA_METRICS
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "buffer.h"
+#include "http.h"
+#include "router.h"
+
+// Latencies are kept in microseconds, in 8 linear sub-buckets per power of
+// two (HDR histogram style, within 12.5% of the real value) up to 2^28us
+#define METRICS_SUB_BUCKET_BITS 3
+#define METRICS_BUCKETS 208
+#define METRICS_STATUS_CLASSES 5
+
+// Counters of one route as seen by one thread. Only that thread writes them,
+// so they are bumped with plain loads and stores; they're atomic so that
+// readers aggregating them see whole values.
+typedef struct {
+  atomic_ulong requests[METRICS_STATUS_CLASSES];
+  atomic_ulong bytes_in;
+  atomic_ulong bytes_out;
+  atomic_ulong duration_us;
+  atomic_ulong buckets[METRICS_BUCKETS];
+} RouteMetrics;
+
+// One per serving thread, allocated on a cache line of its own so threads
+// never share one. Slot 0 counts requests no route matched.
+typedef struct MetricsShard {
+  _Alignas(64) struct MetricsShard *next;
+  usize routes_count;
+  RouteMetrics routes[];
+} MetricsShard;
+
+typedef struct {
+  // Shards are only ever added, readers walk the list without a lock
+  _Atomic(MetricsShard *) shards;
+  pthread_mutex_t shards_lock;
+} Metrics;
+
+Metrics *metrics_new(void);
+void metrics_record(Metrics *metrics, const Router *router, const Route *route,
+                    StatusCode status, usize bytes_in, usize bytes_out,
+                    const struct timespec *started);
+// Appends every shard's counters, summed, in Prometheus text format
+int metrics_write(Metrics *metrics, const Router *router, Buffer *out);
+
+#endif
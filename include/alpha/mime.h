@@ -0,0 +1,8 @@
+#ifndef ALPHA_MIME
+#define ALPHA_MIME
+
+#define MIME_DEFAULT "application/octet-stream"
+
+const char *mime_type(const char *path);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef ALPHA_PARSER
+#define ALPHA_PARSER
+
+#include "common.h"
+#include "headers.h"
+
+typedef enum {
+  PARSER_REQUEST_LINE = 1,
+  PARSER_HEADERS = 2,
+  PARSER_DONE = 3,
+} ParserState;
+
+typedef enum {
+  PARSE_INCOMPLETE = 0,
+  PARSE_DONE = 1,
+  PARSE_ERROR = 2,
+  PARSE_TOO_LARGE = 3,
+} ParseResult;
+
+// Incremental HTTP/1.x request head parser. Every field is a slice into the
+// caller's receive buffer; nothing is copied or allocated.
+typedef struct {
+  ParserState state;
+  // Buffer address seen by the last call, used to rebase the slices when the
+  // buffer was grown or compacted in between
+  const char *base;
+  // End of the last complete line, relative to the start of the request
+  usize offset;
+  // How far the current, unfinished line has already been scanned
+  usize scanned;
+  Slice method;
+  Slice path;
+  int minor_version;
+  HttpHeaders headers;
+} HttpParser;
+
+void http_parser_reset(HttpParser *parser);
+ParseResult http_parser_execute(HttpParser *parser, const char *data,
+                                usize len);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef ALPHA_RANGE
+#define ALPHA_RANGE
+
+#include "common.h"
+
+// More ranges than this in one request are ignored rather than served
+#define RANGES_MAX 16
+
+typedef struct {
+  usize start;
+  usize len;
+} ByteRange;
+
+typedef struct {
+  ByteRange entries[RANGES_MAX];
+  usize count;
+} ByteRanges;
+
+typedef enum {
+  // No usable Range header, the whole file is sent
+  RANGE_IGNORED = 1,
+  RANGE_SATISFIABLE = 2,
+  RANGE_UNSATISFIABLE = 3,
+} RangeResult;
+
+RangeResult parse_ranges(Slice range, usize size, ByteRanges *ranges);
+
+#endif
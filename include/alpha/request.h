@@ -1,13 +1,62 @@
 #ifndef ALPHA_REQUEST
 #define ALPHA_REQUEST
 
+#include "arena.h"
+#include "headers.h"
 #include "http.h"
+#include "json.h"
+#include "response.h"
+
+struct Connection;
+
+// Value captured by a `:name` or `*name` route segment
+typedef struct {
+  Slice name;
+  Slice value;
+} RouteParam;
+
+typedef struct {
+  RouteParam entries[ROUTE_PARAMS_MAX];
+  usize count;
+} RouteParams;
 
 typedef struct {
   const char *path;
   HttpMethod method;
+  // Point into the connection's receive buffer, only valid while the
+  // handler runs
+  const HttpHeaders *headers;
+  const RouteParams *params;
+  // Whole body with any chunked framing removed, not NUL-terminated. Empty
+  // for streamed routes.
+  Slice body;
+  // Scratch memory released once the response has been queued
+  Arena *arena;
+  // Free for a streamed route's callbacks, handed on to its handler
+  void *context;
+  // config.max_body_bytes, bounds what Request_Json indexes
+  usize _max_body_bytes;
 } Request;
 
-void *RequestHandler(void *arg);
+// Value of a well-known header, or an empty slice with a NULL ptr if absent
+Slice Request_Header(const Request *req, HeaderId id);
+// Case-insensitive lookup by name, falling back to a scan for unknown ones
+Slice Request_GetHeader(const Request *req, const char *name);
+usize Request_HeadersCount(const Request *req);
+HttpHeader Request_HeaderAt(const Request *req, usize index);
+// Value captured for a route parameter, an unnamed wildcard is named "*"
+Slice Request_GetParam(const Request *req, const char *name);
+// Memory that lives until the response has been queued (the queued response
+// doesn't borrow it) with no free needed. NULL if out of memory.
+void *Request_Alloc(const Request *req, usize size);
+char *Request_Sprintf(const Request *req, const char *fmt, ...);
+// Parses the body as JSON into request-scoped memory. NULL and `error` set
+// if it isn't valid JSON.
+const JsonNode *Request_Json(const Request *req, JsonError *error);
+// 400 response describing `error`
+Response Request_JsonErrorResponse(const Request *req,
+                                   const JsonError *error);
+
+int handle_request(struct Connection *conn);
 
 #endif
@@ -1,18 +1,17 @@
 #ifndef REQUEST_DTO
 #define REQUEST_DTO
 
-#include <linux/in.h>
+#include <netinet/in.h>
+#include <time.h>
 
 #include "../alpha.h"
 
 typedef struct {
   int file_descriptor;
   struct sockaddr_in address;
+  // When the client was accepted, only set when admission limits are
+  // configured, for queue-timeout shedding
+  struct timespec accepted;
 } Client;
 
-typedef struct {
-  Client client;
-  AlphaApp *app;
-} RequestDTO;
-
 #endif
@@ -8,6 +8,10 @@ typedef enum ResponseType {
   RESPONSE_JSON = 2,
   RESPONSE_JSON_FILE = 3,
   RESPONSE_HTML_FILE = 4,
+  // File whose content type is inferred from its extension
+  RESPONSE_FILE = 5,
+  // Body produced piece by piece while it is being sent
+  RESPONSE_STREAM = 6,
 } ResponseType;
 
 typedef struct {
@@ -15,10 +19,28 @@ typedef struct {
   char *body;
 } HtmlPayload;
 
+typedef struct ResponseWriter ResponseWriter;
+
+// Called each time the client has taken most of what was written so far.
+// Writes the next piece and returns 1 if more follow, 0 once the body is
+// complete, or -1 to abort, which closes the connection mid-response. A call
+// returning 1 must write at least one byte, or the stream is aborted.
+typedef int (*AlphaStreamProducer)(ResponseWriter *writer, void *state);
+
+typedef struct {
+  char *contentType;
+  AlphaStreamProducer producer;
+  void *state;
+  // Called with `state` once the stream ended or its connection closed, may
+  // be NULL. Request-scoped memory also lasts until then.
+  void (*release)(void *state);
+} StreamPayload;
+
 typedef union ResponsePayload {
   HtmlPayload html;
   char *filePath;
   struct Json *jsonObject;
+  StreamPayload stream;
 } ResponsePayload;
 
 typedef struct Response {
@@ -27,12 +49,20 @@ typedef struct Response {
   ResponsePayload payload;
 } Response;
 
-void response_handler(int *client_fd, Response res);
-void handle_response_with_html(int *client_fd, Response res);
-void handle_response_with_json(int *client_fd, Response res);
-void handle_response_with_html_file(int *client_fd, Response res);
-void handle_response_with_json_file(int *client_fd, Response res);
-void send_string_response(int *client_fd, StatusCode Status, char *title,
-                          char *body);
+struct Connection;
+
+void response_handler(struct Connection *conn, Response res);
+void handle_response_with_html(struct Connection *conn, Response res);
+void handle_response_with_json(struct Connection *conn, Response res);
+void handle_response_with_html_file(struct Connection *conn, Response res);
+void handle_response_with_json_file(struct Connection *conn, Response res);
+void handle_response_with_file(struct Connection *conn, Response res);
+void handle_response_with_stream(struct Connection *conn, Response res);
+void response_stream_produce(struct Connection *conn);
+void response_stream_release(struct Connection *conn);
+int ResponseWriter_Write(ResponseWriter *writer, const void *data, usize len);
+int ResponseWriter_Printf(ResponseWriter *writer, const char *fmt, ...);
+void send_string_response(struct Connection *conn, StatusCode Status,
+                          char *title, char *body);
 
 #endif
@@ -6,17 +6,51 @@
 #include "response.h"
 
 typedef Response (*AlphaRouteHandler)(Request);
+// Gets each piece of a streamed body as it arrives, the route's handler
+// running once the body ended. Returning -1 rejects the request with a 400.
+typedef int (*AlphaBodyHandler)(Request *req, Slice chunk);
 
 typedef struct {
   char *_path;
   HttpMethod _method;
   AlphaRouteHandler _handler;
+  // Set for routes whose bodies are streamed instead of buffered
+  AlphaBodyHandler _onBody;
+  // Position in `_routes`, starting at 1
+  usize _id;
 } Route;
 
+// Node of a compressed prefix tree. Each edge is labelled with the longest
+// prefix its subtree shares, so a lookup touches each path byte once.
+// `:name` and `*name` segments hang off their parent as dedicated children
+// that are tried only when no static edge matches.
+typedef struct RouteNode {
+  char *_prefix;
+  usize _prefixLen;
+  // First byte of every child's prefix, in the same order as `_children`
+  char *_indices;
+  struct RouteNode **_children;
+  usize _childrenCount;
+  usize _childrenCapacity;
+  struct RouteNode *_paramChild;
+  struct RouteNode *_wildcardChild;
+  // What the segment is captured as, for param and wildcard nodes only
+  char *_paramName;
+  int _hasRoute;
+  Route _route;
+} RouteNode;
+
 typedef struct {
-  usize _capacity;
   usize _routesCount;
-  Route _routes[ROUTER_INIT_CAP];
+  RouteNode *_roots[HTTP_METHODS_COUNT];
+  // Every route in registration order. Nodes move their route around when
+  // they split, so this is the stable copy.
+  Route *_routes;
 } Router;
 
+int router_add(Router *router, HttpMethod method, char *path,
+               AlphaRouteHandler handler, AlphaBodyHandler on_body);
+Route *match_route(Router *router, char *path, HttpMethod method,
+                   RouteParams *params);
+
 #endif
@@ -0,0 +1,71 @@
+#ifndef ALPHA_STATIC_CACHE
+#define ALPHA_STATIC_CACHE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "conditional.h"
+#include "http.h"
+
+#define STATIC_CACHE_SHARDS 16
+#define STATIC_CACHE_BUCKETS 256
+
+// A cached file response: the serialized status line and headers (without
+// the Connection header and the blank line, which vary per request) followed
+// by the file bytes, all in a single allocation. Precompressed siblings of a
+// file are entries of their own with `encoding` set.
+typedef struct CacheEntry {
+  struct CacheEntry *next;
+  struct CacheEntry *clock_prev;
+  struct CacheEntry *clock_next;
+  usize hash;
+  const char *content_type;
+  StatusCode status;
+  // ContentEncoding of the body, 0 for the file as is
+  unsigned encoding;
+  // Precompressed siblings found next to an identity entry, refreshed along
+  // with the file itself
+  atomic_uint siblings;
+  // One reference for the shard plus one per response still being sent
+  atomic_uint refs;
+  // Set on every hit, cleared as the CLOCK hand passes
+  atomic_int referenced;
+  // Second the file was last stat()ed to check it didn't change
+  atomic_long checked_at;
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+  FileValidators validators;
+  usize bytes;
+  char *path;
+  char *header;
+  usize header_len;
+  char *body;
+  usize body_len;
+} CacheEntry;
+
+typedef struct {
+  _Alignas(64) pthread_rwlock_t lock;
+  CacheEntry *buckets[STATIC_CACHE_BUCKETS];
+  CacheEntry *hand;
+  usize bytes;
+} CacheShard;
+
+typedef struct {
+  usize shard_budget;
+  usize max_file;
+  CacheShard shards[STATIC_CACHE_SHARDS];
+} StaticCache;
+
+StaticCache *static_cache_new(usize budget, usize max_file);
+CacheEntry *static_cache_get(StaticCache *cache, const char *path,
+                             const char *content_type, unsigned encoding,
+                             StatusCode status, int *fd,
+                             struct stat *file_stat);
+void static_cache_retain(CacheEntry *entry);
+void static_cache_release(void *entry);
+
+#endif
@@ -1,22 +1,50 @@
 #ifndef ALPHA_HTTP_TEMPLATES
 #define ALPHA_HTTP_TEMPLATES
 
-#define HTTP_HEADER_TEMPLATE                                                   \
-  "HTTP/1.1 %d\r\n"                                                            \
+// Headers every file response carries, passed to http_write_head() as extra
+// headers
+#define VALIDATOR_HEADERS_TEMPLATE                                             \
+  "Accept-Ranges: bytes\r\n"                                                   \
+  "ETag: %s\r\n"                                                               \
+  "Last-Modified: %s\r\n"                                                      \
+  "%s"
+
+// The two below follow a status line from http_write_status_line()
+#define NOT_MODIFIED_TEMPLATE                                                  \
+  "ETag: %s\r\n"                                                               \
+  "Last-Modified: %s\r\n"                                                      \
+  "%s"                                                                         \
+  "%s"                                                                         \
+  "\r\n"
+
+#define RANGE_NOT_SATISFIABLE_TEMPLATE                                         \
+  "Content-Range: bytes */%lu\r\n"                                             \
+  "Content-Length: 0\r\n"                                                      \
+  "%s"                                                                         \
+  "\r\n"
+
+// Opens each part of a multipart/byteranges body
+#define BYTERANGES_PART_TEMPLATE                                               \
+  "\r\n--%s\r\n"                                                               \
   "Content-Type: %s\r\n"                                                       \
-  "Content-Length: %lu\r\n"                                                    \
+  "Content-Range: bytes %lu-%lu/%lu\r\n"                                       \
   "\r\n"
 
-#define HTML_TEMPLATE                                                          \
+// An HTML page is HEAD, the title, MID, the body and TAIL
+#define HTML_TEMPLATE_HEAD                                                     \
   "<!Doctype html5>"                                                           \
   "<html>"                                                                     \
   "<head>"                                                                     \
-  "<title>%s</title>"                                                          \
+  "<title>"
+
+#define HTML_TEMPLATE_MID                                                      \
+  "</title>"                                                                   \
   "<meta name=\"viewport\" "                                                   \
   "content=\"width=device-width, initial-scale=1\"/>"                          \
   "</head>"                                                                    \
-  "<body>"                                                                     \
-  "%s"                                                                         \
+  "<body>"
+
+#define HTML_TEMPLATE_TAIL                                                     \
   "</body>"                                                                    \
   "</html>"
 
@@ -0,0 +1,45 @@
+#ifndef ALPHA_TIMER_WHEEL
+#define ALPHA_TIMER_WHEEL
+
+#include "common.h"
+
+// Deadlines are rounded up to this, so a timer fires at most one tick late
+#define TIMER_WHEEL_TICK_MS 100
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+// Level n holds timers due within 64^(n + 1) ticks, so four levels reach
+// about 19 days out
+#define TIMER_WHEEL_LEVELS 4
+
+// Embedded in whatever it times. Linked into a circular slot list, or not
+// linked at all when `next` is NULL.
+typedef struct Timer {
+  struct Timer *next;
+  struct Timer *prev;
+  // In ticks
+  unsigned long long expires;
+  void *owner;
+} Timer;
+
+// Hierarchical timing wheel: scheduling and cancelling are O(1) and each
+// tick only looks at one slot, timers due further out cascading down a
+// level as their time approaches. Not thread safe, each event loop owns one.
+typedef struct {
+  // Slot heads, each the sentinel of a circular list
+  Timer slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+  // Due timers not handed out yet
+  Timer expired;
+  // Last tick processed
+  unsigned long long now;
+  usize count;
+} TimerWheel;
+
+unsigned long long timer_clock_ms(void);
+void timer_wheel_init(TimerWheel *wheel, unsigned long long now_ms);
+void timer_wheel_schedule(TimerWheel *wheel, Timer *timer,
+                          unsigned long long expires_ms);
+void timer_wheel_cancel(TimerWheel *wheel, Timer *timer);
+Timer *timer_wheel_expire(TimerWheel *wheel, unsigned long long now_ms);
+int timer_wheel_next_ms(const TimerWheel *wheel, unsigned long long now_ms);
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef ALPHA_URING
+#define ALPHA_URING
+
+#include <linux/io_uring.h>
+
+#include "../alpha.h"
+#include "connection.h"
+#include "timer_wheel.h"
+
+// Provided receive buffers per loop, a power of two
+#define URING_BUFFERS 512
+#define URING_BUFFER_LEN 4096
+// File bodies go out through a buffer of this size per connection
+#define URING_FILE_CHUNK_LEN (64 * 1024)
+
+typedef struct {
+  Connection conn;
+  // Direct descriptor of the socket in the ring's file table
+  unsigned slot;
+  // Submitted operations whose last completion hasn't arrived yet, the
+  // connection can't be freed before they did
+  usize pending;
+  // Whether the multishot receive is armed
+  int receiving;
+  // Whether a send (and the file read linked before it) is in flight.
+  // Nothing in `out` or the segments may move until it completed.
+  int sending;
+  int sending_file;
+  // Receives were cancelled because unhandled input piled up while a
+  // response was being sent
+  int throttled;
+  // A file read linked before a send came up short
+  int failed;
+  // The client shut down its side, the connection closes once the
+  // responses to what it sent are out
+  int hung_up;
+  int closing;
+  char *chunk;
+  usize chunk_len;
+  struct iovec iov[OUTPUT_IOV_MAX];
+  struct msghdr msg;
+} UringConnection;
+
+// One ring per thread, accepting from a listening socket of its own like the
+// sharded epoll loops
+typedef struct {
+  AlphaApp *app;
+  int ring_fd;
+  int listen_fd;
+  // Submission queue shared with the kernel, `sq_tail` counting what was
+  // queued but not yet published
+  unsigned *sq_khead;
+  unsigned *sq_ktail;
+  unsigned sq_tail;
+  unsigned sq_mask;
+  unsigned sq_entries;
+  struct io_uring_sqe *sqes;
+  // Set once io_uring_enter failed for good, nothing more can be submitted
+  // and the loop stops
+  int broken;
+  // Completion queue
+  unsigned *cq_khead;
+  unsigned *cq_ktail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+  // Both queues' mapping and the entries' one
+  void *rings;
+  usize rings_len;
+  usize sqes_len;
+  // Provided buffer ring receives land in, handed back once copied out
+  struct io_uring_buf_ring *buffers;
+  char *buffers_memory;
+  unsigned short buffers_tail;
+  // Size of the direct descriptor table and slots taken in it
+  unsigned files;
+  unsigned open;
+  // Free slots below which connections are accepted one at a time
+  unsigned accept_reserve;
+  // Whether an accept is armed, and whether it's the multishot one
+  int accepting;
+  int accept_multishot;
+  // Where turned away clients' requests are read into and dropped
+  char discard[REQUEST_HEAD_MAX];
+  // Deadlines of the loop's connections
+  TimerWheel timers;
+} UringLoop;
+
+int uring_loop_init(UringLoop *loop, AlphaApp *app, int listen_fd);
+// Releases a ring uring_loop_init set up, leaving its listening socket open
+void uring_loop_free(UringLoop *loop);
+void *UringLoopHandler(void *arg);
+
+#endif
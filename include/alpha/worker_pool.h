@@ -0,0 +1,62 @@
+#ifndef ALPHA_WORKER_POOL
+#define ALPHA_WORKER_POOL
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+#include "request_dto.h"
+
+typedef struct {
+  atomic_size_t sequence;
+  Client client;
+} ClientQueueSlot;
+
+// Bounded multi-producer/multi-consumer ring of accepted clients. Slots carry
+// a sequence number so producers and consumers claim them with a single CAS
+// on their own cursor and never take a lock.
+typedef struct {
+  ClientQueueSlot *slots;
+  usize mask;
+  _Alignas(64) atomic_size_t head;
+  _Alignas(64) atomic_size_t tail;
+} ClientQueue;
+
+struct Connection;
+struct WorkerPool;
+
+typedef struct {
+  struct WorkerPool *pool;
+  pthread_t thread;
+  // Held while the worker switches clients, so the reaper never shuts down
+  // a socket that was already handed to someone else
+  pthread_mutex_t lock;
+  // The worker's connection, reused for every client it serves
+  struct Connection *conn;
+} Worker;
+
+typedef struct WorkerPool {
+  AlphaApp *app;
+  ClientQueue queue;
+  // Counts queued clients so idle workers sleep instead of spinning
+  sem_t ready;
+  // Counts free slots so the acceptor waits rather than overflowing the ring
+  sem_t free;
+  usize workers_count;
+  Worker *workers;
+  // Set when the pool couldn't be started, the workers already running exit
+  // at their next wake up
+  atomic_int stopping;
+} WorkerPool;
+
+int client_queue_init(ClientQueue *queue, usize capacity);
+int client_queue_push(ClientQueue *queue, Client client);
+int client_queue_pop(ClientQueue *queue, Client *client);
+
+int worker_pool_init(WorkerPool *pool, AlphaApp *app);
+void worker_pool_stop(WorkerPool *pool, usize started);
+void worker_pool_submit(WorkerPool *pool, Client client);
+void *WorkerHandler(void *arg);
+void *worker_pool_reaper(void *arg);
+
+#endif
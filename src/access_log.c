@@ -0,0 +1,182 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../exteral/log4c/include/log4c.h"
+
+#include "../include/alpha/access_log.h"
+#include "../include/alpha/buffer.h"
+
+// How long the writer sleeps once every ring is empty
+#define ACCESS_LOG_IDLE_NS (20 * 1000 * 1000)
+
+// Ring of the calling thread, created on its first record
+static _Thread_local AccessLogRing *thread_ring;
+static _Thread_local AccessLog *thread_ring_owner;
+
+// Helpers
+AccessLogRing *access_log_ring(AccessLog *log);
+void *access_log_writer(void *arg);
+void access_log_time(time_t time, char *time_str, time_t *time_str_at);
+void access_log_format(Buffer *out, const AccessRecord *record,
+                       char *time_str, time_t *time_str_at);
+
+AccessLog *access_log_new(AccessLogLevel level, usize sample,
+                          usize ring_capacity, FILE *file) {
+  AccessLog *log = calloc(1, sizeof(AccessLog));
+  if (!log) {
+    return NULL;
+  }
+  log->level = level;
+  log->sample = sample ? sample : 1;
+  log->ring_capacity = ring_capacity;
+  log->file = file;
+  pthread_mutex_init(&log->rings_lock, NULL);
+  pthread_t thread;
+  int status = pthread_create(&thread, NULL, access_log_writer, log);
+  if (status != 0) {
+    pthread_mutex_destroy(&log->rings_lock);
+    free(log);
+    errno = status;
+    return NULL;
+  }
+  pthread_detach(thread);
+  return log;
+}
+
+AccessLogRing *access_log_ring(AccessLog *log) {
+  if (thread_ring_owner == log) {
+    return thread_ring;
+  }
+  usize size = 2;
+  while (size < log->ring_capacity) {
+    size *= 2;
+  }
+  AccessLogRing *ring = calloc(1, sizeof(AccessLogRing));
+  if (!ring || !(ring->records = malloc(sizeof(AccessRecord) * size))) {
+    free(ring);
+    return NULL;
+  }
+  ring->mask = size - 1;
+  // Threads are never torn down while the server runs, so neither are their
+  // rings
+  pthread_mutex_lock(&log->rings_lock);
+  ring->next = atomic_load(&log->rings);
+  atomic_store_explicit(&log->rings, ring, memory_order_release);
+  pthread_mutex_unlock(&log->rings_lock);
+  thread_ring = ring;
+  thread_ring_owner = log;
+  return ring;
+}
+
+// Called by serving threads once a response was queued. Never blocks: when
+// the writer falls behind the record is counted as dropped instead.
+void access_log_record(AccessLog *log, Slice method, const char *path,
+                       StatusCode status, const struct timespec *started) {
+  if (!log || log->level == ACCESS_LOG_OFF ||
+      (log->level == ACCESS_LOG_ERRORS && status < 400)) {
+    return;
+  }
+  AccessLogRing *ring = access_log_ring(log);
+  if (!ring || (status < 400 && ring->seen++ % log->sample != 0)) {
+    return;
+  }
+  usize tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  usize head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (tail - head > ring->mask) {
+    atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    return;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  AccessRecord *record = &ring->records[tail & ring->mask];
+  usize path_len = strlen(path);
+  usize copied = path_len < ACCESS_LOG_PATH_MAX ? path_len
+                                                : ACCESS_LOG_PATH_MAX;
+  usize method_len = method.len < sizeof(record->method)
+                         ? method.len
+                         : sizeof(record->method);
+  // Second resolution is all the writer prints, the coarse clock is enough
+  struct timespec wall;
+  clock_gettime(CLOCK_REALTIME_COARSE, &wall);
+  record->time = wall.tv_sec;
+  record->duration_us = (now.tv_sec - started->tv_sec) * 1000000 +
+                        (now.tv_nsec - started->tv_nsec) / 1000;
+  record->status = status;
+  record->method_len = method_len;
+  record->path_len = path_len < 255 ? path_len : 255;
+  memcpy(record->method, method.ptr, method_len);
+  memcpy(record->path, path, copied);
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+usize access_log_dropped(AccessLog *log) {
+  return log ? atomic_load(&log->dropped) : 0;
+}
+
+// Drains every ring into one buffer and writes it with a single call, so
+// lines from different threads never interleave
+void *access_log_writer(void *arg) {
+  AccessLog *log = arg;
+  Buffer out = {0};
+  // Formatted once per second rather than once per line
+  char time_str[32] = "";
+  time_t time_str_at = -1;
+  struct timespec idle = {0, ACCESS_LOG_IDLE_NS};
+  while (1) {
+    usize dropped = 0;
+    AccessLogRing *ring =
+        atomic_load_explicit(&log->rings, memory_order_acquire);
+    for (; ring; ring = ring->next) {
+      usize head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+      usize tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+      for (; head != tail; ++head) {
+        access_log_format(&out, &ring->records[head & ring->mask], time_str,
+                          &time_str_at);
+      }
+      atomic_store_explicit(&ring->head, head, memory_order_release);
+      dropped += atomic_exchange_explicit(&ring->dropped, 0,
+                                          memory_order_relaxed);
+    }
+    if (dropped) {
+      atomic_fetch_add(&log->dropped, dropped);
+      access_log_time(time(NULL), time_str, &time_str_at);
+      buffer_appendf(&out, "%s %s access log dropped %lu records\n",
+                     time_str, LogLevel(WARN), dropped);
+    }
+    if (out.len == 0) {
+      nanosleep(&idle, NULL);
+      continue;
+    }
+    fwrite(out.data, 1, out.len, log->file);
+    fflush(log->file);
+    out.len = 0;
+  }
+  return NULL;
+}
+
+void access_log_time(time_t time, char *time_str, time_t *time_str_at) {
+  if (time != *time_str_at) {
+    struct tm local;
+    localtime_r(&time, &local);
+    strftime(time_str, 32, "[%Y-%m-%d %H:%M:%S]", &local);
+    *time_str_at = time;
+  }
+}
+
+void access_log_format(Buffer *out, const AccessRecord *record,
+                       char *time_str, time_t *time_str_at) {
+  access_log_time(record->time, time_str, time_str_at);
+  const char *color = record->status >= 500   ? "\033[0;31m"
+                      : record->status >= 400 ? "\033[0;33m"
+                                              : "\033[0;32m";
+  usize copied = record->path_len < ACCESS_LOG_PATH_MAX ? record->path_len
+                                                        : ACCESS_LOG_PATH_MAX;
+  buffer_appendf(out, "%s %s %.*s %.*s%s %s%u\033[0m %u.%03ums\n", time_str,
+                 LogLevel(INFO), record->method_len, record->method,
+                 (int)copied, record->path,
+                 record->path_len > ACCESS_LOG_PATH_MAX ? "..." : "", color,
+                 record->status, record->duration_us / 1000,
+                 record->duration_us % 1000);
+}
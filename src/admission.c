@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../include/alpha/admission.h"
+#include "../include/alpha/http.h"
+
+#define ADMISSION_REPLY_BODY "Service Unavailable"
+
+// Helpers
+int admission_take(atomic_size_t *counter, usize max);
+
+Admission *admission_new(usize max_connections, usize max_in_flight,
+                         usize queue_timeout_ms, AdmissionAction action,
+                         usize retry_after) {
+  Admission *admission = calloc(1, sizeof(Admission));
+  if (!admission) {
+    return NULL;
+  }
+  admission->max_connections = max_connections;
+  admission->max_in_flight = max_in_flight;
+  admission->queue_timeout = queue_timeout_ms * 1000000ULL;
+  if (action == ADMISSION_REJECT) {
+    char retry[48];
+    snprintf(retry, sizeof(retry), "Retry-After: %lu\r\n", retry_after);
+    if (http_write_head(&admission->reply, SERVICE_UNAVAILABLE, "text/plain",
+                        sizeof(ADMISSION_REPLY_BODY) - 1, retry,
+                        "Connection: close\r\n") == -1 ||
+        buffer_append(&admission->reply, ADMISSION_REPLY_BODY,
+                      sizeof(ADMISSION_REPLY_BODY) - 1) == -1) {
+      buffer_free(&admission->reply);
+      free(admission);
+      return NULL;
+    }
+  }
+  return admission;
+}
+
+// Counts one more against `max`, unless that would exceed it. A max of 0
+// means no limit, and then nothing is counted at all.
+int admission_take(atomic_size_t *counter, usize max) {
+  if (!max) {
+    return 0;
+  }
+  if (atomic_fetch_add_explicit(counter, 1, memory_order_relaxed) >= max) {
+    atomic_fetch_sub_explicit(counter, 1, memory_order_relaxed);
+    return -1;
+  }
+  return 0;
+}
+
+// Returns -1 when the client must be turned away with admission_reject
+int admission_connection_acquire(Admission *admission) {
+  return admission ? admission_take(&admission->connections,
+                                    admission->max_connections)
+                   : 0;
+}
+
+void admission_connection_release(Admission *admission) {
+  if (admission && admission->max_connections) {
+    atomic_fetch_sub_explicit(&admission->connections, 1,
+                              memory_order_relaxed);
+  }
+}
+
+// Returns -1 when the request must be answered with admission_refuse
+int admission_request_acquire(Admission *admission) {
+  return admission ? admission_take(&admission->in_flight,
+                                    admission->max_in_flight)
+                   : 0;
+}
+
+void admission_request_release(Admission *admission) {
+  if (admission && admission->max_in_flight) {
+    atomic_fetch_sub_explicit(&admission->in_flight, 1, memory_order_relaxed);
+  }
+}
+
+// Whether something queued at `since` waited too long to still be worth
+// serving, its client having likely given up already. `now` may be NULL.
+int admission_expired(Admission *admission, const struct timespec *since,
+                      const struct timespec *now) {
+  if (!admission || !admission->queue_timeout) {
+    return 0;
+  }
+  struct timespec current;
+  if (!now) {
+    clock_gettime(CLOCK_MONOTONIC, &current);
+    now = &current;
+  }
+  long long waited = (now->tv_sec - since->tv_sec) * 1000000000LL +
+                     (now->tv_nsec - since->tv_nsec);
+  return waited > (long long)admission->queue_timeout;
+}
+
+// Counts a client turned away and returns what it should be sent before
+// being disconnected, empty when it shouldn't get an answer
+const Buffer *admission_turn_away(Admission *admission) {
+  atomic_fetch_add_explicit(&admission->rejected, 1, memory_order_relaxed);
+  return &admission->reply;
+}
+
+// Queues the reply for a request turned away, the caller closing the
+// connection after it
+void admission_refuse(Admission *admission, Buffer *out) {
+  const Buffer *reply = admission_turn_away(admission);
+  if (reply->len) {
+    buffer_append(out, reply->data, reply->len);
+  }
+}
+
+// Turns away a client whose connection was never admitted and closes it.
+// The request head it already sent is read first, since closing a socket
+// with unread data resets it and the reply would be lost.
+void admission_reject(Admission *admission, int fd) {
+  const Buffer *reply = admission_turn_away(admission);
+  if (reply->len) {
+    char discard[REQUEST_HEAD_MAX];
+    recv(fd, discard, sizeof(discard), MSG_DONTWAIT);
+    send(fd, reply->data, reply->len, MSG_DONTWAIT | MSG_NOSIGNAL);
+  }
+  close(fd);
+}
+
+// Connections and requests turned away over the whole run
+usize admission_rejected(Admission *admission) {
+  return admission ? atomic_load(&admission->rejected) : 0;
+}
@@ -1,55 +1,194 @@
 #include <arpa/inet.h>
 #include <errno.h>
-#include <linux/in.h>
+#include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/endian.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #define LOG4C_IMPLEMENTATION
 #include "../exteral/log4c/include/log4c.h"
 
 #include "../include/alpha.h"
+#include "../include/alpha/event_loop.h"
 #include "../include/alpha/request.h"
 #include "../include/alpha/request_dto.h"
+#include "../include/alpha/uring.h"
+#include "../include/alpha/worker_pool.h"
 
-int init_tcp_socket(char *Host, usize Port);
+int init_tcp_socket(char *Host, usize Port, usize backlog);
+void run_threads(AlphaApp *app);
+void run_event_loops(AlphaApp *app);
+void run_sharded_event_loops(AlphaApp *app);
+void run_uring_loops(AlphaApp *app);
 
 Router Alpha_Router_New() {
-  Router router;
-  router._routesCount = 0;
-  router._capacity = ROUTER_INIT_CAP;
+  Router router = {0};
   return router;
 }
 
+AlphaConfig Alpha_DefaultConfig() {
+  AlphaConfig config = {
+      .mode = ALPHA_RUN_THREADS,
+      .threads = 0,
+      .workers = 0,
+      .queue_capacity = WORKER_POOL_DEFAULT_QUEUE_CAP,
+      .max_requests_per_connection = MAX_REQUESTS_PER_CONNECTION,
+      .static_cache_bytes = STATIC_CACHE_DEFAULT_BYTES,
+      .static_cache_max_file = STATIC_CACHE_DEFAULT_MAX_FILE,
+      .compress_cache_bytes = 0,
+      .compress_min_bytes = COMPRESS_DEFAULT_MIN_BYTES,
+      .max_body_bytes = REQUEST_BODY_MAX,
+      .access_log = ACCESS_LOG_ALL,
+      .access_log_sample = 1,
+      .access_log_ring = 0,
+      .metrics_path = NULL,
+      .backlog = BACK_LOG,
+      .max_connections = 0,
+      .max_in_flight = 0,
+      .queue_timeout_ms = 0,
+      .overload = ADMISSION_REJECT,
+      .retry_after = ADMISSION_RETRY_AFTER_DEFAULT,
+      .header_timeout_ms = HEADER_TIMEOUT_DEFAULT_MS,
+      .body_timeout_ms = BODY_TIMEOUT_DEFAULT_MS,
+      .write_timeout_ms = WRITE_TIMEOUT_DEFAULT_MS,
+      .idle_timeout_ms = IDLE_TIMEOUT_DEFAULT_MS,
+      .worker_idle_timeout_ms = WORKER_IDLE_TIMEOUT_DEFAULT_MS,
+  };
+  return config;
+}
+
 AlphaApp Alpha_New(char *Host, usize Port) {
+  return Alpha_NewWithConfig(Host, Port, Alpha_DefaultConfig());
+}
+
+AlphaApp Alpha_NewWithConfig(char *Host, usize Port, AlphaConfig config) {
   // TODO: validate args
   AlphaApp app;
   app._router = Alpha_Router_New();
-  app._backLog = BACK_LOG;
+  app._backLog = config.backlog ? config.backlog : BACK_LOG;
+  app._host = Host;
   app._port = Port;
-  app._fileDescriptor = init_tcp_socket(Host, Port);
+  app._config = config;
+  app._staticCache = NULL;
+  if (config.static_cache_bytes) {
+    app._staticCache = static_cache_new(config.static_cache_bytes,
+                                        config.static_cache_max_file);
+    if (!app._staticCache) {
+      Log(stderr, ERROR, "Couldn't allocate static cache: %s\n",
+          strerror(errno));
+    }
+  }
+  app._compressCache = NULL;
+  if (config.compress_cache_bytes) {
+    app._compressCache = compress_cache_new(config.compress_cache_bytes,
+                                            config.compress_min_bytes);
+    if (!app._compressCache) {
+      Log(stderr, ERROR, "Couldn't set up response compression: %s\n",
+          strerror(errno));
+    }
+  }
+  app._accessLog = NULL;
+  if (config.access_log != ACCESS_LOG_OFF) {
+    // Blocking workers are many and each serves one connection at a time
+    usize ring = config.access_log_ring;
+    if (ring == 0) {
+      ring = config.mode == ALPHA_RUN_THREADS ? ACCESS_LOG_RING_WORKER_DEFAULT
+                                              : ACCESS_LOG_RING_DEFAULT;
+    }
+    app._accessLog = access_log_new(config.access_log,
+                                    config.access_log_sample, ring, stdout);
+    if (!app._accessLog) {
+      Log(stderr, ERROR, "Couldn't start the access log: %s\n",
+          strerror(errno));
+    }
+  }
+  app._metrics = NULL;
+  if (config.metrics_path) {
+    app._metrics = metrics_new();
+    if (!app._metrics) {
+      Log(stderr, ERROR, "Couldn't set up metrics: %s\n", strerror(errno));
+    }
+  }
+  app._admission = NULL;
+  if (config.max_connections || config.max_in_flight ||
+      config.queue_timeout_ms) {
+    app._admission = admission_new(config.max_connections,
+                                   config.max_in_flight,
+                                   config.queue_timeout_ms, config.overload,
+                                   config.retry_after);
+    if (!app._admission) {
+      Log(stderr, ERROR, "Couldn't set up admission limits: %s\n",
+          strerror(errno));
+    }
+  }
+  app._fileDescriptor = init_tcp_socket(Host, Port, app._backLog);
   return app;
 }
 
-void Alpha_Get(AlphaApp *app, char *path, AlphaRouteHandler handler) {
-  // TODO: validate args
-  Route route = {
-      ._handler = handler,
-      ._method = GET,
-      ._path = path,
-  };
-  app->_router._routes[app->_router._routesCount++] = route;
+int Alpha_Get(AlphaApp *app, char *path, AlphaRouteHandler handler) {
+  return router_add(&app->_router, GET, path, handler, NULL);
+}
+
+int Alpha_Post(AlphaApp *app, char *path, AlphaRouteHandler handler) {
+  return router_add(&app->_router, POST, path, handler, NULL);
+}
+
+int Alpha_Put(AlphaApp *app, char *path, AlphaRouteHandler handler) {
+  return router_add(&app->_router, PUT, path, handler, NULL);
+}
+
+int Alpha_Delete(AlphaApp *app, char *path, AlphaRouteHandler handler) {
+  return router_add(&app->_router, DELETE, path, handler, NULL);
+}
+
+int Alpha_Patch(AlphaApp *app, char *path, AlphaRouteHandler handler) {
+  return router_add(&app->_router, PATCH, path, handler, NULL);
+}
+
+int Alpha_Stream(AlphaApp *app, HttpMethod method, char *path,
+                 AlphaBodyHandler on_body, AlphaRouteHandler handler) {
+  if (!on_body) {
+    Log(stderr, ERROR, "Couldn't register route %s: no body handler", path);
+    return -1;
+  }
+  return router_add(&app->_router, method, path, handler, on_body);
 }
 
 // printf("%s %d\n",
 // inet_ntoa(client_addr.sin_addr),ntohs(client_addr.sin_port));
 
 void Alpha_Run(AlphaApp *app) {
+  // sendfile(2) and splice(2) can't be told MSG_NOSIGNAL, a peer gone
+  // mid-file must not take the process down
+  signal(SIGPIPE, SIG_IGN);
+  switch (app->_config.mode) {
+  case ALPHA_RUN_EPOLL:
+    run_event_loops(app);
+    break;
+  case ALPHA_RUN_SHARDED:
+    run_sharded_event_loops(app);
+    break;
+  case ALPHA_RUN_URING:
+    run_uring_loops(app);
+    break;
+  case ALPHA_RUN_THREADS:
+    run_threads(app);
+    break;
+  }
+}
+
+void run_threads(AlphaApp *app) {
+  WorkerPool pool;
+  if (worker_pool_init(&pool, app) == -1) {
+    return;
+  }
   while (1) {
     struct sockaddr_in client_addr;
     usize client_addr_len = sizeof(client_addr);
@@ -62,25 +201,189 @@ void Alpha_Run(AlphaApp *app) {
       continue;
     }
 
+    if (admission_connection_acquire(app->_admission) == -1) {
+      admission_reject(app->_admission, client_fd);
+      continue;
+    }
     Client client = {.address = client_addr, .file_descriptor = client_fd};
-    RequestDTO *payload = malloc(sizeof(RequestDTO));
-    payload->app = app;
-    payload->client = client;
+    // Stamped for queue-time shedding once a worker picks the client up
+    if (app->_admission) {
+      clock_gettime(CLOCK_MONOTONIC, &client.accepted);
+    }
+    worker_pool_submit(&pool, client);
+  }
+}
+
+usize event_loops_count(AlphaApp *app) {
+  if (app->_config.threads) {
+    return app->_config.threads;
+  }
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 0 ? cpus : 1;
+}
+
+int set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+    Log(stderr, ERROR, "Couldn't make server non-blocking: %s\n",
+        strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+// Runs every loop (`loop_size` bytes each) on its own thread with
+// `handler`, the calling thread driving the first one. With `pin` set, loop i
+// is bound to CPU i (modulo the CPUs online).
+void start_event_loops(void *loops, usize loop_size, usize loops_count,
+                       void *(*handler)(void *), int pin) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  for (usize i = 0; i < loops_count; ++i) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (pin && cpus > 0) {
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      CPU_SET(i % cpus, &cpu_set);
+      if (i == 0) {
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+      } else {
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set), &cpu_set);
+      }
+    }
+    if (i > 0) {
+      pthread_t thread;
+      if (pthread_create(&thread, &attr, handler,
+                         (char *)loops + i * loop_size) != 0) {
+        Log(stderr, ERROR, "Couldn't spawn event loop\n");
+      } else {
+        pthread_detach(thread);
+      }
+    }
+    pthread_attr_destroy(&attr);
+  }
+  handler(loops);
+}
+
+void run_event_loops(AlphaApp *app) {
+  usize loops_count = event_loops_count(app);
+  if (set_nonblocking(app->_fileDescriptor) == -1) {
+    return;
+  }
+
+  EventLoop *loops = malloc(sizeof(EventLoop) * loops_count);
+  if (!loops) {
+    Log(stderr, ERROR, "Couldn't allocate event loops: %s\n", strerror(errno));
+    return;
+  }
+  usize ready = 0;
+  while (ready < loops_count &&
+         event_loop_init(&loops[ready], app, app->_fileDescriptor) == 0) {
+    ++ready;
+  }
+  if (ready == 0) {
+    Log(stderr, ERROR, "Couldn't start any event loop\n");
+    free(loops);
+    return;
+  }
+  if (ready < loops_count) {
+    Log(stderr, WARN, "Running %lu of %lu event loops\n", ready, loops_count);
+  }
+  start_event_loops(loops, sizeof(EventLoop), ready, EventLoopHandler, 0);
+}
+
+// Every shard owns a listening socket bound to the same port with
+// SO_REUSEPORT, so the kernel spreads connections across shards and no
+// accept() is ever shared between threads. Shards that can't be set up are
+// left out with a warning.
+void run_sharded_event_loops(AlphaApp *app) {
+  usize shards_count = event_loops_count(app);
+  EventLoop *shards = malloc(sizeof(EventLoop) * shards_count);
+  if (!shards) {
+    Log(stderr, ERROR, "Couldn't allocate shards: %s\n", strerror(errno));
+    return;
+  }
+  usize ready = 0;
+  for (; ready < shards_count; ++ready) {
+    int listen_fd = ready == 0 ? app->_fileDescriptor
+                               : init_tcp_socket(app->_host, app->_port,
+                                                 app->_backLog);
+    if (listen_fd == -1) {
+      break;
+    }
+    if (set_nonblocking(listen_fd) == -1 ||
+        event_loop_init(&shards[ready], app, listen_fd) == -1) {
+      if (listen_fd != app->_fileDescriptor) {
+        close(listen_fd);
+      }
+      break;
+    }
+  }
+  if (ready == 0) {
+    Log(stderr, ERROR, "Couldn't start any shard\n");
+    free(shards);
+    return;
+  }
+  if (ready < shards_count) {
+    Log(stderr, WARN, "Running %lu of %lu shards\n", ready, shards_count);
+  }
+  start_event_loops(shards, sizeof(EventLoop), ready, EventLoopHandler, 1);
+}
 
-    pthread_t thread;
-    pthread_create(&thread, NULL, RequestHandler, payload);
+// Shards like run_sharded_event_loops, each with a ring of its own. When a
+// ring can't be set up the kernel lacks io_uring or the parts of it used, or
+// the rings' locked memory ran out, and the epoll shards take over.
+void run_uring_loops(AlphaApp *app) {
+  usize rings_count = event_loops_count(app);
+  UringLoop *rings = malloc(sizeof(UringLoop) * rings_count);
+  if (!rings) {
+    Log(stderr, ERROR, "Couldn't allocate rings: %s\n", strerror(errno));
+    Log(stderr, WARN, "Falling back to epoll without io_uring\n");
+    run_sharded_event_loops(app);
+    return;
+  }
+  usize ready = 0;
+  for (; ready < rings_count; ++ready) {
+    int listen_fd = ready == 0 ? app->_fileDescriptor
+                               : init_tcp_socket(app->_host, app->_port,
+                                                 app->_backLog);
+    if (listen_fd == -1) {
+      break;
+    }
+    if (uring_loop_init(&rings[ready], app, listen_fd) == -1) {
+      if (listen_fd != app->_fileDescriptor) {
+        close(listen_fd);
+      }
+      break;
+    }
+  }
+  if (ready < rings_count) {
+    for (usize i = 0; i < ready; ++i) {
+      if (rings[i].listen_fd != app->_fileDescriptor) {
+        close(rings[i].listen_fd);
+      }
+      uring_loop_free(&rings[i]);
+    }
+    free(rings);
+    Log(stderr, WARN, "Falling back to epoll, %lu of %lu rings came up\n",
+        ready, rings_count);
+    run_sharded_event_loops(app);
+    return;
   }
+  start_event_loops(rings, sizeof(UringLoop), rings_count, UringLoopHandler,
+                    1);
 }
 
-int init_tcp_socket(char *Host, usize Port) {
+int init_tcp_socket(char *Host, usize Port, usize backlog) {
   int fd = socket(AF_INET, SOCK_STREAM, 0);
   if (fd == -1) {
     Log(stderr, ERROR, "Couldn't create server: %s\n", strerror(errno));
     return -1;
   }
-  if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &(int){1},
-                 sizeof(int)) == -1) {
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int)) == -1 ||
+      setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &(int){1}, sizeof(int)) == -1) {
     Log(stderr, ERROR, "Couldn't set to reuse Addr: %s\n", strerror(errno));
+    close(fd);
     return -1;
   }
   struct sockaddr_in saddr;
@@ -90,10 +393,12 @@ int init_tcp_socket(char *Host, usize Port) {
   socklen_t saddr_len = sizeof(saddr);
   if (bind(fd, (struct sockaddr *)&saddr, saddr_len) == -1) {
     Log(stderr, ERROR, "Couldn't Bind: %s\n", strerror(errno));
+    close(fd);
     return -1;
   }
-  if (listen(fd, BACK_LOG) == -1) {
+  if (listen(fd, backlog) == -1) {
     Log(stderr, ERROR, "Couldn't Listen: %s\n", strerror(errno));
+    close(fd);
     return -1;
   }
   return fd;
@@ -0,0 +1,60 @@
+#include <stdlib.h>
+
+#include "../include/alpha/arena.h"
+
+#define ARENA_ALIGN 16
+
+// Returns 16-byte aligned memory that lives until the next reset, or NULL
+void *arena_alloc(Arena *arena, usize size) {
+  size = (size + ARENA_ALIGN - 1) & ~(usize)(ARENA_ALIGN - 1);
+  ArenaChunk *chunk = arena->head;
+  if (!chunk || chunk->cap - chunk->used < size) {
+    usize cap = chunk ? chunk->cap * 2 : ARENA_CHUNK_MIN;
+    while (cap < size) {
+      cap *= 2;
+    }
+    ArenaChunk *next = malloc(sizeof(ArenaChunk) + cap);
+    if (!next) {
+      return NULL;
+    }
+    next->next = chunk;
+    next->cap = cap;
+    next->used = 0;
+    arena->head = chunk = next;
+  }
+  void *ptr = chunk->data + chunk->used;
+  chunk->used += size;
+  return ptr;
+}
+
+// Drops every allocation, keeping the newest chunk unless it grew past
+// ARENA_RETAIN_MAX for an unusually large request
+void arena_reset(Arena *arena) {
+  ArenaChunk *head = arena->head;
+  if (!head) {
+    return;
+  }
+  ArenaChunk *chunk = head->next;
+  while (chunk) {
+    ArenaChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  if (head->cap > ARENA_RETAIN_MAX) {
+    free(head);
+    arena->head = NULL;
+    return;
+  }
+  head->next = NULL;
+  head->used = 0;
+}
+
+void arena_free(Arena *arena) {
+  ArenaChunk *chunk = arena->head;
+  while (chunk) {
+    ArenaChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->head = NULL;
+}
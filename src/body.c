@@ -0,0 +1,177 @@
+#include <limits.h>
+#include <string.h>
+
+#include "../include/alpha/body.h"
+
+// Longest chunk size line (extensions included) and trailer section accepted
+#define CHUNK_LINE_MAX 1024
+#define CHUNK_TRAILERS_MAX REQUEST_HEAD_MAX
+
+// Helpers
+BodyResult body_reader_chunked(BodyReader *reader, char *data, usize len);
+int hex_digit(char c);
+
+void body_reader_init(BodyReader *reader, int chunked, usize length) {
+  memset(reader, 0, sizeof(BodyReader));
+  reader->chunked = chunked;
+  reader->remaining = length;
+  reader->state = CHUNK_SIZE;
+}
+
+// `data` holds the `len` bytes received since the start of the body
+BodyResult body_reader_execute(BodyReader *reader, char *data, usize len) {
+  if (reader->chunked) {
+    return body_reader_chunked(reader, data, len);
+  }
+  usize available = len - reader->consumed;
+  usize taken = available < reader->remaining ? available : reader->remaining;
+  reader->consumed += taken;
+  reader->decoded += taken;
+  reader->total += taken;
+  reader->remaining -= taken;
+  return reader->remaining ? BODY_INCOMPLETE : BODY_DONE;
+}
+
+void body_reader_discard(BodyReader *reader) {
+  reader->consumed = 0;
+  reader->decoded = 0;
+}
+
+void body_reader_compact(BodyReader *reader) {
+  reader->consumed = reader->decoded;
+}
+
+int hex_digit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  c |= 0x20;
+  return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// Chunk data is moved down over the framing in front of it, so the decoded
+// body ends up contiguous where the raw one started
+BodyResult body_reader_chunked(BodyReader *reader, char *data, usize len) {
+  while (reader->consumed < len) {
+    if (reader->state == CHUNK_DATA) {
+      usize available = len - reader->consumed;
+      usize taken = available < reader->chunk_left ? available
+                                                   : reader->chunk_left;
+      if (reader->decoded != reader->consumed) {
+        memmove(data + reader->decoded, data + reader->consumed, taken);
+      }
+      reader->consumed += taken;
+      reader->decoded += taken;
+      reader->total += taken;
+      reader->chunk_left -= taken;
+      if (reader->chunk_left == 0) {
+        reader->state = CHUNK_DATA_END;
+      }
+      continue;
+    }
+
+    char c = data[reader->consumed++];
+    // Trailers are skipped, their line_len counts the whole section
+    usize line_max =
+        reader->state < CHUNK_TRAILER ? CHUNK_LINE_MAX : CHUNK_TRAILERS_MAX;
+    if (++reader->line_len > line_max) {
+      return BODY_ERROR;
+    }
+    switch (reader->state) {
+    case CHUNK_SIZE: {
+      int digit = hex_digit(c);
+      if (digit != -1) {
+        if (reader->chunk_left > (ULONG_MAX >> 4)) {
+          return BODY_ERROR;
+        }
+        reader->chunk_left = reader->chunk_left << 4 | digit;
+        break;
+      }
+      // The first byte of the line has to be a digit
+      if (reader->line_len == 1) {
+        return BODY_ERROR;
+      }
+      if (c == ';' || c == ' ' || c == '\t') {
+        reader->state = CHUNK_EXTENSION;
+      } else if (c == '\r') {
+        reader->state = CHUNK_SIZE_LF;
+      } else if (c == '\n') {
+        goto size_done;
+      } else {
+        return BODY_ERROR;
+      }
+      break;
+    }
+    case CHUNK_EXTENSION:
+      if (c == '\r') {
+        reader->state = CHUNK_SIZE_LF;
+      } else if (c == '\n') {
+        goto size_done;
+      }
+      break;
+    case CHUNK_SIZE_LF:
+      if (c != '\n') {
+        return BODY_ERROR;
+      }
+    size_done:
+      reader->line_len = 0;
+      reader->state = reader->chunk_left ? CHUNK_DATA : CHUNK_TRAILER;
+      break;
+    case CHUNK_DATA_END:
+      if (c == '\r') {
+        reader->state = CHUNK_DATA_LF;
+        break;
+      }
+      // fallthrough
+    case CHUNK_DATA_LF:
+      if (c != '\n') {
+        return BODY_ERROR;
+      }
+      reader->line_len = 0;
+      reader->state = CHUNK_SIZE;
+      break;
+    case CHUNK_TRAILER:
+      if (c == '\r') {
+        reader->state = CHUNK_TRAILER_LF;
+      } else if (c == '\n') {
+        reader->state = CHUNK_DONE;
+        return BODY_DONE;
+      } else {
+        reader->state = CHUNK_TRAILER_LINE;
+      }
+      break;
+    case CHUNK_TRAILER_LINE:
+      if (c == '\n') {
+        reader->state = CHUNK_TRAILER;
+      }
+      break;
+    case CHUNK_TRAILER_LF:
+      if (c != '\n') {
+        return BODY_ERROR;
+      }
+      reader->state = CHUNK_DONE;
+      return BODY_DONE;
+    case CHUNK_DATA:
+    case CHUNK_DONE:
+      break;
+    }
+  }
+  return reader->state == CHUNK_DONE ? BODY_DONE : BODY_INCOMPLETE;
+}
+
+// Content-Length is all digits, anything else can't be framed safely
+int body_parse_length(Slice value, usize *length) {
+  if (value.len == 0) {
+    return -1;
+  }
+  usize result = 0;
+  for (usize i = 0; i < value.len; ++i) {
+    char c = value.ptr[i];
+    if (c < '0' || c > '9' || result > (ULONG_MAX - (c - '0')) / 10) {
+      return -1;
+    }
+    result = result * 10 + (c - '0');
+  }
+  *length = result;
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/alpha/buffer.h"
+
+#define BUFFER_MIN_CAP 1024
+
+int buffer_reserve(Buffer *buf, usize extra) {
+  if (buf->len + extra <= buf->cap) {
+    return 0;
+  }
+  usize new_cap = buf->cap ? buf->cap : BUFFER_MIN_CAP;
+  while (new_cap < buf->len + extra) {
+    new_cap *= 2;
+  }
+  char *data = realloc(buf->data, new_cap);
+  if (!data) {
+    return -1;
+  }
+  buf->data = data;
+  buf->cap = new_cap;
+  return 0;
+}
+
+int buffer_append(Buffer *buf, const void *data, usize len) {
+  if (buffer_reserve(buf, len) == -1) {
+    return -1;
+  }
+  memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+  return 0;
+}
+
+int buffer_appendf(Buffer *buf, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int status = buffer_vappendf(buf, fmt, args);
+  va_end(args);
+  return status;
+}
+
+int buffer_vappendf(Buffer *buf, const char *fmt, va_list args) {
+  va_list retry;
+  va_copy(retry, args);
+  int needed = vsnprintf(buf->data + buf->len, buf->cap - buf->len, fmt, args);
+  if (needed < 0) {
+    va_end(retry);
+    return -1;
+  }
+  if ((usize)needed >= buf->cap - buf->len) {
+    if (buffer_reserve(buf, needed + 1) == -1) {
+      va_end(retry);
+      return -1;
+    }
+    vsnprintf(buf->data + buf->len, buf->cap - buf->len, fmt, retry);
+  }
+  va_end(retry);
+  buf->len += needed;
+  return 0;
+}
+
+// Decimal digits of `value`, two at a time and without going through printf
+int buffer_append_usize(Buffer *buf, usize value) {
+  static const char pairs[] = "00010203040506070809"
+                              "10111213141516171819"
+                              "20212223242526272829"
+                              "30313233343536373839"
+                              "40414243444546474849"
+                              "50515253545556575859"
+                              "60616263646566676869"
+                              "70717273747576777879"
+                              "80818283848586878889"
+                              "90919293949596979899";
+  char digits[20];
+  char *ptr = digits + sizeof(digits);
+  while (value >= 100) {
+    ptr -= 2;
+    memcpy(ptr, pairs + (value % 100) * 2, 2);
+    value /= 100;
+  }
+  if (value >= 10) {
+    ptr -= 2;
+    memcpy(ptr, pairs + value * 2, 2);
+  } else {
+    *--ptr = '0' + value;
+  }
+  return buffer_append(buf, ptr, digits + sizeof(digits) - ptr);
+}
+
+// Drops the first `len` bytes, keeping whatever follows them
+void buffer_consume(Buffer *buf, usize len) {
+  if (len >= buf->len) {
+    buf->len = 0;
+    return;
+  }
+  memmove(buf->data, buf->data + len, buf->len - len);
+  buf->len -= len;
+}
+
+void buffer_free(Buffer *buf) {
+  free(buf->data);
+  buf->data = NULL;
+  buf->len = 0;
+  buf->cap = 0;
+}
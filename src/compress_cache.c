@@ -0,0 +1,159 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ALPHA_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "../include/alpha/compress_cache.h"
+
+// Helpers
+usize compress_cache_hash(const char *body, usize len);
+CompressedEntry *compress_cache_compress(const char *body, usize len,
+                                         usize hash);
+
+// Returns NULL with errno set to ENOTSUP when built without zlib
+CompressCache *compress_cache_new(usize budget, usize min_len) {
+#ifndef ALPHA_HAVE_ZLIB
+  (void)budget;
+  (void)min_len;
+  errno = ENOTSUP;
+  return NULL;
+#else
+  CompressCache *cache = calloc(1, sizeof(CompressCache));
+  if (!cache) {
+    return NULL;
+  }
+  cache->budget = budget;
+  cache->min_len = min_len;
+  for (usize i = 0; i < COMPRESS_CACHE_LOCKS; ++i) {
+    pthread_mutex_init(&cache->locks[i], NULL);
+  }
+  return cache;
+#endif
+}
+
+// FNV-1a
+usize compress_cache_hash(const char *body, usize len) {
+  usize hash = 14695981039346656037UL;
+  for (usize i = 0; i < len; ++i) {
+    hash ^= (unsigned char)body[i];
+    hash *= 1099511628211UL;
+  }
+  return hash;
+}
+
+CompressedEntry *compress_cache_compress(const char *body, usize len,
+                                         usize hash) {
+#ifndef ALPHA_HAVE_ZLIB
+  (void)body;
+  (void)len;
+  (void)hash;
+  return NULL;
+#else
+  z_stream stream = {0};
+  // 15 window bits plus 16 asks for a gzip wrapper instead of a zlib one
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return NULL;
+  }
+  usize bound = deflateBound(&stream, len);
+  CompressedEntry *entry = malloc(sizeof(CompressedEntry) + len + bound);
+  if (!entry) {
+    deflateEnd(&stream);
+    return NULL;
+  }
+  entry->plain = (char *)(entry + 1);
+  memcpy(entry->plain, body, len);
+  entry->plain_len = len;
+  entry->data = entry->plain + len;
+
+  stream.next_in = (Bytef *)entry->plain;
+  stream.avail_in = len;
+  stream.next_out = (Bytef *)entry->data;
+  stream.avail_out = bound;
+  int status = deflate(&stream, Z_FINISH);
+  entry->len = stream.total_out;
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END) {
+    free(entry);
+    return NULL;
+  }
+  // Not worth a Content-Encoding, remembered so it isn't tried again
+  if (entry->len >= len) {
+    entry->len = 0;
+  }
+  entry->bytes = sizeof(CompressedEntry) + len + entry->len;
+  CompressedEntry *shrunk = realloc(entry, entry->bytes);
+  if (shrunk) {
+    entry = shrunk;
+    entry->plain = (char *)(entry + 1);
+    entry->data = entry->plain + len;
+  }
+  if (!entry->len) {
+    entry->data = NULL;
+  }
+  entry->hash = hash;
+  atomic_init(&entry->refs, 1);
+  return entry;
+#endif
+}
+
+// Returns a referenced entry for `body`, compressing it on a miss, or NULL if
+// it can't be cached. Each distinct body is compressed once while it stays in
+// the cache.
+CompressedEntry *compress_cache_get(CompressCache *cache, const char *body,
+                                    usize len) {
+  if (len < cache->min_len) {
+    return NULL;
+  }
+  usize hash = compress_cache_hash(body, len);
+  usize slot = hash % COMPRESS_CACHE_SLOTS;
+  pthread_mutex_t *lock = &cache->locks[slot % COMPRESS_CACHE_LOCKS];
+
+  pthread_mutex_lock(lock);
+  CompressedEntry *entry = cache->slots[slot];
+  usize evicted_bytes = entry ? entry->bytes : 0;
+  if (entry && entry->hash == hash && entry->plain_len == len &&
+      memcmp(entry->plain, body, len) == 0) {
+    atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+    pthread_mutex_unlock(lock);
+    return entry;
+  }
+  pthread_mutex_unlock(lock);
+
+  // Compressing into a full cache would be paid on every response
+  usize bytes = atomic_load_explicit(&cache->bytes, memory_order_relaxed);
+  bytes = bytes > evicted_bytes ? bytes - evicted_bytes : 0;
+  if (bytes + len * 2 > cache->budget) {
+    return NULL;
+  }
+  entry = compress_cache_compress(body, len, hash);
+  if (!entry) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(lock);
+  CompressedEntry *evicted = cache->slots[slot];
+  cache->slots[slot] = entry;
+  atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&cache->bytes, entry->bytes,
+                            memory_order_relaxed);
+  if (evicted) {
+    atomic_fetch_sub_explicit(&cache->bytes, evicted->bytes,
+                              memory_order_relaxed);
+  }
+  pthread_mutex_unlock(lock);
+  if (evicted) {
+    compress_cache_release(evicted);
+  }
+  return entry;
+}
+
+void compress_cache_release(void *arg) {
+  CompressedEntry *entry = (CompressedEntry *)arg;
+  if (atomic_fetch_sub_explicit(&entry->refs, 1, memory_order_acq_rel) == 1) {
+    free(entry);
+  }
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/alpha/conditional.h"
+
+// Helpers
+int etag_list_matches(Slice list, const char *etag);
+
+void file_validators(const struct stat *file_stat, FileValidators *out) {
+  snprintf(out->etag, sizeof(out->etag), "\"%lx-%lx-%lx\"",
+           (unsigned long)file_stat->st_ino, (unsigned long)file_stat->st_size,
+           (unsigned long)file_stat->st_mtim.tv_sec * 1000000000UL +
+               file_stat->st_mtim.tv_nsec);
+  struct tm tm;
+  gmtime_r(&file_stat->st_mtim.tv_sec, &tm);
+  strftime(out->last_modified, sizeof(out->last_modified),
+           "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  out->mtime = file_stat->st_mtim.tv_sec;
+}
+
+// Weak comparison against each entity-tag of an If-None-Match list
+int etag_list_matches(Slice list, const char *etag) {
+  usize etag_len = strlen(etag);
+  const char *ptr = list.ptr;
+  const char *end = list.ptr + list.len;
+  while (ptr < end) {
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == ',')) {
+      ptr++;
+    }
+    if (ptr < end && *ptr == '*') {
+      return 1;
+    }
+    if (end - ptr >= 2 && ptr[0] == 'W' && ptr[1] == '/') {
+      ptr += 2;
+    }
+    const char *tag = ptr;
+    // Tags are quoted and can't contain quotes, so the closing one ends it
+    if (ptr < end && *ptr == '"') {
+      ptr++;
+      while (ptr < end && *ptr != '"') {
+        ptr++;
+      }
+      if (ptr < end) {
+        ptr++;
+      }
+    }
+    if ((usize)(ptr - tag) == etag_len && memcmp(tag, etag, etag_len) == 0) {
+      return 1;
+    }
+    while (ptr < end && *ptr != ',') {
+      ptr++;
+    }
+  }
+  return 0;
+}
+
+// Whether a GET for a file with `validators` can be answered with a 304.
+// If-Modified-Since is only looked at without If-None-Match.
+int is_not_modified(const HttpHeaders *headers,
+                    const FileValidators *validators) {
+  const HttpHeader *if_none_match =
+      headers_find(headers, HEADER_IF_NONE_MATCH);
+  if (if_none_match) {
+    return etag_list_matches(if_none_match->value, validators->etag);
+  }
+  const HttpHeader *if_modified_since =
+      headers_find(headers, HEADER_IF_MODIFIED_SINCE);
+  if (!if_modified_since) {
+    return 0;
+  }
+  // Clients mostly echo our own Last-Modified back, which spares parsing it
+  Slice since = if_modified_since->value;
+  if (since.len == strlen(validators->last_modified) &&
+      memcmp(since.ptr, validators->last_modified, since.len) == 0) {
+    return 1;
+  }
+  char date[HTTP_DATE_MAX];
+  if (since.len >= sizeof(date)) {
+    return 0;
+  }
+  memcpy(date, since.ptr, since.len);
+  date[since.len] = '\0';
+  struct tm tm = {0};
+  const char *parsed_end = strptime(date, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  if (!parsed_end || *parsed_end) {
+    return 0;
+  }
+  return validators->mtime <= timegm(&tm);
+}
+
+// Whether a Range request may be served partially: without If-Range always,
+// with it only if it names the current strong ETag or exact Last-Modified
+int if_range_matches(const HttpHeaders *headers,
+                     const FileValidators *validators) {
+  const HttpHeader *if_range = headers_find(headers, HEADER_IF_RANGE);
+  if (!if_range) {
+    return 1;
+  }
+  Slice value = if_range->value;
+  const char *validator = value.len && value.ptr[0] == '"'
+                              ? validators->etag
+                              : validators->last_modified;
+  return value.len == strlen(validator) &&
+         memcmp(value.ptr, validator, value.len) == 0;
+}
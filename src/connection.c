@@ -0,0 +1,488 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../exteral/log4c/include/log4c.h"
+
+#include "../include/alpha/connection.h"
+#include "../include/alpha/request.h"
+#include "../include/alpha/response.h"
+
+#define RECV_CHUNK_LEN 4096
+#define SPLICE_CHUNK_LEN (64 * 1024)
+
+OutputSegment *connection_push_segment(Connection *conn);
+void connection_pop_segment(Connection *conn);
+ssize_t connection_splice_file(Connection *conn, OutputSegment *file);
+ssize_t connection_send_file(Connection *conn, OutputSegment *file);
+ssize_t connection_send_memory(Connection *conn);
+ConnectionPhase connection_phase(Connection *conn);
+
+void connection_init(Connection *conn, AlphaApp *app, Client client,
+                     int blocking) {
+  memset(conn, 0, sizeof(Connection));
+  conn->client = client;
+  conn->app = app;
+  conn->blocking = blocking;
+  conn->pipe_fds[0] = -1;
+  conn->pipe_fds[1] = -1;
+  http_parser_reset(&conn->parser);
+}
+
+int connection_has_output(Connection *conn) {
+  return conn->out_sent < conn->out.len ||
+         conn->segments_head < conn->segments_count;
+}
+
+OutputSegment *connection_push_segment(Connection *conn) {
+  if (conn->segments_count == conn->segments_capacity) {
+    usize new_cap = conn->segments_capacity ? conn->segments_capacity * 2 : 4;
+    OutputSegment *segments =
+        realloc(conn->segments, sizeof(OutputSegment) * new_cap);
+    if (!segments) {
+      return NULL;
+    }
+    conn->segments = segments;
+    conn->segments_capacity = new_cap;
+  }
+  OutputSegment *segment = &conn->segments[conn->segments_count++];
+  memset(segment, 0, sizeof(OutputSegment));
+  segment->at = conn->out.len;
+  segment->fd = -1;
+  return segment;
+}
+
+// Takes ownership of `fd`, which is closed once `len` bytes from `offset`
+// have been sent after everything currently in `out`
+int connection_queue_file(Connection *conn, int fd, off_t offset, usize len) {
+  if (len == 0) {
+    close(fd);
+    return 0;
+  }
+  OutputSegment *segment = connection_push_segment(conn);
+  if (!segment) {
+    return -1;
+  }
+  segment->kind = OUTPUT_FILE;
+  segment->fd = fd;
+  segment->offset = offset;
+  segment->remaining = len;
+  return 0;
+}
+
+// Sends `len` bytes at `data` without copying them into `out`. `release`,
+// if given, is called with `release_arg` once they are no longer needed,
+// also when the connection closes before they were sent.
+int connection_queue_memory(Connection *conn, const char *data, usize len,
+                            void (*release)(void *), void *release_arg) {
+  if (len == 0) {
+    if (release) {
+      release(release_arg);
+    }
+    return 0;
+  }
+  OutputSegment *segment = connection_push_segment(conn);
+  if (!segment) {
+    return -1;
+  }
+  segment->kind = OUTPUT_MEMORY;
+  segment->data = data;
+  segment->remaining = len;
+  segment->release = release;
+  segment->release_arg = release_arg;
+  return 0;
+}
+
+void connection_pop_segment(Connection *conn) {
+  OutputSegment *segment = &conn->segments[conn->segments_head++];
+  if (segment->fd != -1) {
+    close(segment->fd);
+  }
+  if (segment->release) {
+    segment->release(segment->release_arg);
+  }
+}
+
+// Moves file bytes through a pipe for files sendfile(2) refuses. Returns the
+// bytes that reached the socket, 0 if the file ended early, or -1 with errno
+// set.
+ssize_t connection_splice_file(Connection *conn, OutputSegment *file) {
+  if (conn->pipe_fds[0] == -1 &&
+      pipe2(conn->pipe_fds, O_NONBLOCK | O_CLOEXEC) == -1) {
+    return -1;
+  }
+  if (conn->pipe_len == 0) {
+    ssize_t filled =
+        splice(file->fd, &file->offset, conn->pipe_fds[1], NULL,
+               file->remaining < SPLICE_CHUNK_LEN ? file->remaining
+                                                  : SPLICE_CHUNK_LEN,
+               SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (filled <= 0) {
+      return filled;
+    }
+    file->remaining -= filled;
+    conn->pipe_len = filled;
+  }
+  ssize_t sent = splice(conn->pipe_fds[0], NULL, conn->client.file_descriptor,
+                        NULL, conn->pipe_len,
+                        SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE);
+  if (sent > 0) {
+    conn->pipe_len -= sent;
+  }
+  return sent;
+}
+
+// Streams the file segment at the head of the queue
+ssize_t connection_send_file(Connection *conn, OutputSegment *file) {
+  ssize_t sent;
+  if (conn->pipe_len == 0) {
+    sent = sendfile(conn->client.file_descriptor, file->fd, &file->offset,
+                    file->remaining);
+    if (sent > 0) {
+      file->remaining -= sent;
+    } else if (sent == -1 && (errno == EINVAL || errno == ENOSYS)) {
+      sent = connection_splice_file(conn, file);
+    }
+  } else {
+    sent = connection_splice_file(conn, file);
+  }
+  // The file shrank since its Content-Length was sent, the response can't be
+  // completed
+  if (sent == 0) {
+    errno = EPIPE;
+    return -1;
+  }
+  if (sent > 0 && file->remaining == 0 && conn->pipe_len == 0) {
+    connection_pop_segment(conn);
+  }
+  return sent;
+}
+
+// Points `iov` at `out` and the memory segments queued up to the next file,
+// at most OUTPUT_IOV_MAX pieces. `more` is set when output follows them.
+usize connection_gather_output(Connection *conn, struct iovec *iov,
+                               int *more) {
+  usize iov_count = 0;
+  usize pos = conn->out_sent;
+  *more = 0;
+  for (usize i = conn->segments_head; iov_count < OUTPUT_IOV_MAX;) {
+    OutputSegment *segment = i < conn->segments_count ? &conn->segments[i]
+                                                      : NULL;
+    usize limit = segment ? segment->at : conn->out.len;
+    if (pos < limit) {
+      iov[iov_count++] = (struct iovec){conn->out.data + pos, limit - pos};
+      pos = limit;
+      continue;
+    }
+    if (!segment) {
+      break;
+    }
+    if (segment->kind == OUTPUT_FILE) {
+      *more = 1;
+      break;
+    }
+    iov[iov_count++] =
+        (struct iovec){(void *)segment->data, segment->remaining};
+    i++;
+  }
+  if (iov_count == OUTPUT_IOV_MAX) {
+    *more = 1;
+  }
+  return iov_count;
+}
+
+// Marks `sent` bytes at the front of the output as sent, releasing the
+// segments that went out whole
+void connection_advance_output(Connection *conn, usize sent) {
+  while (sent) {
+    OutputSegment *segment = conn->segments_head < conn->segments_count
+                                 ? &conn->segments[conn->segments_head]
+                                 : NULL;
+    usize limit = segment ? segment->at : conn->out.len;
+    if (conn->out_sent < limit) {
+      usize taken = limit - conn->out_sent < sent ? limit - conn->out_sent
+                                                  : sent;
+      conn->out_sent += taken;
+      sent -= taken;
+      continue;
+    }
+    usize taken = segment->remaining < sent ? segment->remaining : sent;
+    if (segment->kind == OUTPUT_FILE) {
+      segment->offset += taken;
+    } else {
+      segment->data += taken;
+    }
+    segment->remaining -= taken;
+    sent -= taken;
+    if (segment->remaining == 0) {
+      connection_pop_segment(conn);
+    }
+  }
+}
+
+// Gathers the memory output into one sendmsg(2), so a response leaves in as
+// few packets as the socket allows. MSG_MORE keeps headers from leaving in a
+// segment of their own when a file body follows them.
+ssize_t connection_send_memory(Connection *conn) {
+  struct iovec iov[OUTPUT_IOV_MAX];
+  int more;
+  struct msghdr msg = {.msg_iov = iov,
+                       .msg_iovlen = connection_gather_output(conn, iov,
+                                                              &more)};
+  ssize_t sent = sendmsg(conn->client.file_descriptor, &msg,
+                         MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+  if (sent > 0) {
+    connection_advance_output(conn, sent);
+  }
+  return sent;
+}
+
+// Forgets output that has all been sent, so `out` starts over
+void connection_reset_output(Connection *conn) {
+  conn->out.len = 0;
+  conn->out_sent = 0;
+  conn->segments_head = 0;
+  conn->segments_count = 0;
+}
+
+// Sends as much pending output as the socket takes. On a non-blocking socket
+// whatever is left stays queued so the write resumes on the next call.
+ConnectionStatus connection_flush(Connection *conn) {
+  while (connection_has_output(conn)) {
+    // A blocked send can't be watched from here, the reaper interrupts it
+    if (conn->blocking) {
+      connection_arm(conn, timer_clock_ms());
+    }
+    OutputSegment *segment = conn->segments_head < conn->segments_count
+                                 ? &conn->segments[conn->segments_head]
+                                 : NULL;
+    ssize_t sent =
+        segment && segment->kind == OUTPUT_FILE &&
+                conn->out_sent >= segment->at
+            ? connection_send_file(conn, segment)
+            : connection_send_memory(conn);
+    if (sent == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return CONNECTION_WANT_WRITE;
+      }
+      return CONNECTION_CLOSE;
+    }
+  }
+  connection_reset_output(conn);
+  return CONNECTION_DONE;
+}
+
+// Drives the connection as far as the socket allows: flushes pending output,
+// handles every complete request sitting in `in` and reads more input. On a
+// blocking socket this only returns once the connection is done.
+ConnectionStatus connection_serve(Connection *conn) {
+  while (1) {
+    response_stream_produce(conn);
+    // Pipelined requests are all answered before a single flush, but wait
+    // behind a streamed response
+    while (!conn->close_after_write && !conn->stream.producer &&
+           handle_request(conn)) {
+    }
+    if (connection_has_output(conn)) {
+      ConnectionStatus status = connection_flush(conn);
+      if (status != CONNECTION_DONE) {
+        return status;
+      }
+    }
+    if (conn->stream.producer) {
+      continue;
+    }
+    if (conn->close_after_write) {
+      return CONNECTION_CLOSE;
+    }
+    buffer_consume(&conn->in, conn->in_offset);
+    conn->in_offset = 0;
+    if (conn->blocking) {
+      connection_arm(conn, timer_clock_ms());
+    }
+    if (buffer_reserve(&conn->in, RECV_CHUNK_LEN) == -1) {
+      Log(stderr, ERROR, "Couldn't grow request buffer: %s", strerror(errno));
+      return CONNECTION_CLOSE;
+    }
+    ssize_t read_len = recv(conn->client.file_descriptor,
+                            conn->in.data + conn->in.len,
+                            conn->in.cap - conn->in.len, 0);
+    if (read_len > 0) {
+      // Queue time runs from the last input, a client sending its head
+      // slowly hasn't been kept waiting
+      if (conn->app->_admission) {
+        clock_gettime(CLOCK_MONOTONIC, &conn->received);
+      }
+      conn->in.len += read_len;
+      continue;
+    }
+    if (read_len == 0) {
+      return CONNECTION_CLOSE;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return CONNECTION_WANT_READ;
+    }
+    return CONNECTION_CLOSE;
+  }
+}
+
+// Appends input that was received into some other buffer, as the io_uring
+// backend's receives are
+int connection_receive(Connection *conn, const char *data, usize len) {
+  // Queue time runs from the last input, a client sending its head slowly
+  // hasn't been kept waiting
+  if (conn->app->_admission) {
+    clock_gettime(CLOCK_MONOTONIC, &conn->received);
+  }
+  if (buffer_append(&conn->in, data, len) == -1) {
+    Log(stderr, ERROR, "Couldn't grow request buffer: %s", strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+// The Connection header line the current response needs, if any
+const char *connection_header(Connection *conn) {
+  if (!conn->keep_alive) {
+    return "Connection: close\r\n";
+  }
+  return conn->http10 ? "Connection: keep-alive\r\n" : "";
+}
+
+ConnectionPhase connection_phase(Connection *conn) {
+  if (connection_has_output(conn) || conn->stream.producer) {
+    return CONNECTION_WRITING;
+  }
+  if (conn->reading_body) {
+    return CONNECTION_READING_BODY;
+  }
+  // A new client owes a request head right away
+  if (conn->in.len > conn->in_offset || conn->requests_count == 0) {
+    return CONNECTION_READING_HEAD;
+  }
+  return CONNECTION_IDLE;
+}
+
+// Sets the deadline for what the connection is about to wait for. A request
+// head has to be complete within its timeout however slowly it trickles in,
+// so its deadline only moves once the head is done; the other timeouts only
+// catch stalls and restart on every call.
+void connection_arm(Connection *conn, unsigned long long now_ms) {
+  ConnectionPhase phase = connection_phase(conn);
+  if (phase == CONNECTION_READING_HEAD && conn->phase == phase) {
+    return;
+  }
+  conn->phase = phase;
+  const AlphaConfig *config = &conn->app->_config;
+  usize timeout;
+  switch (phase) {
+  case CONNECTION_READING_HEAD:
+    timeout = config->header_timeout_ms;
+    break;
+  case CONNECTION_READING_BODY:
+    timeout = config->body_timeout_ms;
+    break;
+  case CONNECTION_WRITING:
+    timeout = config->write_timeout_ms;
+    break;
+  default:
+    // Only workers block, and an idle one serves nobody else meanwhile
+    timeout = conn->blocking ? config->worker_idle_timeout_ms
+                             : config->idle_timeout_ms;
+    break;
+  }
+  atomic_store_explicit(&conn->deadline, timeout ? now_ms + timeout : 0,
+                        memory_order_relaxed);
+}
+
+// Makes sure the connection's timer fires by its deadline. Deadlines that
+// only moved later, as they do on every read and write, leave the timer
+// alone: it finds out when it fires and is scheduled again then.
+void connection_schedule(Connection *conn, TimerWheel *timers,
+                         unsigned long long now_ms) {
+  connection_arm(conn, now_ms);
+  unsigned long long deadline =
+      atomic_load_explicit(&conn->deadline, memory_order_relaxed);
+  if (!deadline) {
+    timer_wheel_cancel(timers, &conn->timer);
+  } else if (!conn->timer.next ||
+             deadline < conn->timer.expires * TIMER_WHEEL_TICK_MS) {
+    timer_wheel_schedule(timers, &conn->timer, deadline);
+  }
+}
+
+// Points an idle connection at a new client, keeping its buffers around
+void connection_reuse(Connection *conn, Client client) {
+  conn->client = client;
+  conn->in.len = 0;
+  conn->in_offset = 0;
+  http_parser_reset(&conn->parser);
+  conn->reading_body = 0;
+  conn->routed = 0;
+  conn->context = NULL;
+  arena_reset(&conn->arena);
+  conn->out.len = 0;
+  conn->out_sent = 0;
+  conn->keep_alive = 0;
+  conn->http10 = 0;
+  conn->requests_count = 0;
+  conn->close_after_write = 0;
+  conn->phase = 0;
+}
+
+void connection_close(Connection *conn) {
+  response_stream_release(conn);
+  // Closed while its request was still being read
+  if (conn->admitted) {
+    admission_request_release(conn->app->_admission);
+    conn->admitted = 0;
+  }
+  admission_connection_release(conn->app->_admission);
+  atomic_store_explicit(&conn->deadline, 0, memory_order_relaxed);
+  // The io_uring backend closes its direct descriptors itself
+  if (conn->client.file_descriptor != -1) {
+    close(conn->client.file_descriptor);
+    conn->client.file_descriptor = -1;
+  }
+  while (conn->segments_head < conn->segments_count) {
+    connection_pop_segment(conn);
+  }
+  conn->segments_head = 0;
+  conn->segments_count = 0;
+  // Leftovers of an unfinished splice would leak into the next client
+  if (conn->pipe_len) {
+    close(conn->pipe_fds[0]);
+    close(conn->pipe_fds[1]);
+    conn->pipe_fds[0] = -1;
+    conn->pipe_fds[1] = -1;
+    conn->pipe_len = 0;
+  }
+}
+
+void connection_free(Connection *conn) {
+  buffer_free(&conn->in);
+  buffer_free(&conn->out);
+  buffer_free(&conn->scratch);
+  arena_free(&conn->arena);
+  free(conn->segments);
+  conn->segments = NULL;
+  conn->segments_capacity = 0;
+  if (conn->pipe_fds[0] != -1) {
+    close(conn->pipe_fds[0]);
+    close(conn->pipe_fds[1]);
+    conn->pipe_fds[0] = -1;
+    conn->pipe_fds[1] = -1;
+  }
+}
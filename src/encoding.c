@@ -0,0 +1,134 @@
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include "../include/alpha/encoding.h"
+
+// Helpers
+int encoding_is_space(char c);
+int encoding_q_is_zero(const char *ptr, const char *end);
+
+int encoding_is_space(char c) { return c == ' ' || c == '\t'; }
+
+// True for "0", "0." and "0.000", the only way a q-value refuses a coding
+int encoding_q_is_zero(const char *ptr, const char *end) {
+  if (ptr == end || *ptr != '0') {
+    return 0;
+  }
+  ptr++;
+  if (ptr < end && *ptr == '.') {
+    ptr++;
+    while (ptr < end && *ptr == '0') {
+      ptr++;
+    }
+  }
+  return ptr == end;
+}
+
+// Codings from an Accept-Encoding value the client takes, honoring q=0 and
+// the `*` wildcard
+unsigned accepted_encodings(Slice accept_encoding) {
+  unsigned accepted = 0;
+  unsigned refused = 0;
+  int wildcard = 0;
+  const char *ptr = accept_encoding.ptr;
+  const char *end = accept_encoding.ptr + accept_encoding.len;
+  while (ptr < end) {
+    while (ptr < end && (encoding_is_space(*ptr) || *ptr == ',')) {
+      ptr++;
+    }
+    const char *name = ptr;
+    while (ptr < end && *ptr != ',' && *ptr != ';' &&
+           !encoding_is_space(*ptr)) {
+      ptr++;
+    }
+    usize name_len = ptr - name;
+
+    int allowed = 1;
+    while (ptr < end && *ptr != ',') {
+      if (*ptr != ';') {
+        ptr++;
+        continue;
+      }
+      ptr++;
+      while (ptr < end && encoding_is_space(*ptr)) {
+        ptr++;
+      }
+      const char *param = ptr;
+      while (ptr < end && *ptr != ',' && *ptr != ';') {
+        ptr++;
+      }
+      const char *param_end = ptr;
+      while (param_end > param && encoding_is_space(param_end[-1])) {
+        param_end--;
+      }
+      if (param_end - param >= 2 && (param[0] == 'q' || param[0] == 'Q') &&
+          param[1] == '=') {
+        allowed = !encoding_q_is_zero(param + 2, param_end);
+      }
+    }
+
+    unsigned coding = 0;
+    if ((name_len == 4 && strncasecmp(name, "gzip", 4) == 0) ||
+        (name_len == 6 && strncasecmp(name, "x-gzip", 6) == 0)) {
+      coding = ENCODING_GZIP;
+    } else if (name_len == 2 && strncasecmp(name, "br", 2) == 0) {
+      coding = ENCODING_BR;
+    } else if (name_len == 1 && *name == '*') {
+      wildcard = allowed ? 1 : -1;
+      continue;
+    }
+    if (allowed) {
+      accepted |= coding;
+    } else {
+      refused |= coding;
+    }
+  }
+  // `*` only covers the codings that weren't listed on their own
+  if (wildcard == 1) {
+    accepted |= (ENCODING_GZIP | ENCODING_BR) & ~refused;
+  }
+  return accepted & ~refused;
+}
+
+// Text formats shrink well, images, fonts and archives are already compressed
+int is_compressible(const char *content_type) {
+  return strncmp(content_type, "text/", 5) == 0 ||
+         strstr(content_type, "json") || strstr(content_type, "javascript") ||
+         strstr(content_type, "xml");
+}
+
+// Precompressed copies sitting next to `path`, e.g. `app.js.br`
+unsigned precompressed_siblings(const char *path) {
+  static const ContentEncoding encodings[] = {ENCODING_BR, ENCODING_GZIP};
+  unsigned found = 0;
+  char sibling[PATH_MAX];
+  for (usize i = 0; i < sizeof(encodings) / sizeof(encodings[0]); ++i) {
+    struct stat file_stat;
+    if (snprintf(sibling, sizeof(sibling), "%s%s", path,
+                 encoding_suffix(encodings[i])) < (int)sizeof(sibling) &&
+        stat(sibling, &file_stat) == 0 && S_ISREG(file_stat.st_mode)) {
+      found |= encodings[i];
+    }
+  }
+  return found;
+}
+
+const char *encoding_suffix(ContentEncoding encoding) {
+  return encoding == ENCODING_BR ? ".br" : ".gz";
+}
+
+// Extra header lines for a response in `encoding` (0 for identity). Responses
+// that could have been compressed say so with Vary for caches downstream.
+const char *encoding_headers(unsigned encoding, const char *content_type) {
+  switch (encoding) {
+  case ENCODING_GZIP:
+    return "Content-Encoding: gzip\r\n" VARY_ACCEPT_ENCODING;
+  case ENCODING_BR:
+    return "Content-Encoding: br\r\n" VARY_ACCEPT_ENCODING;
+  default:
+    return is_compressible(content_type) ? VARY_ACCEPT_ENCODING : "";
+  }
+}
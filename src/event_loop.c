@@ -0,0 +1,146 @@
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../exteral/log4c/include/log4c.h"
+
+#include "../include/alpha/connection.h"
+#include "../include/alpha/event_loop.h"
+
+#define EVENT_LOOP_MAX_EVENTS 256
+
+void event_loop_accept(EventLoop *loop);
+void event_loop_reap(EventLoop *loop, unsigned long long now_ms);
+void event_loop_close(EventLoop *loop, Connection *conn);
+
+int event_loop_init(EventLoop *loop, AlphaApp *app, int listen_fd) {
+  loop->app = app;
+  loop->listen_fd = listen_fd;
+  loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (loop->epoll_fd == -1) {
+    Log(stderr, ERROR, "Couldn't create epoll instance: %s", strerror(errno));
+    return -1;
+  }
+  // Every loop watches the same listening socket; EPOLLEXCLUSIVE wakes just
+  // one of them per incoming connection
+  struct epoll_event event = {
+      .events = EPOLLIN | EPOLLEXCLUSIVE,
+      .data.ptr = NULL,
+  };
+  if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) == -1) {
+    Log(stderr, ERROR, "Couldn't watch listening socket: %s", strerror(errno));
+    close(loop->epoll_fd);
+    return -1;
+  }
+  timer_wheel_init(&loop->timers, timer_clock_ms());
+  return 0;
+}
+
+void *EventLoopHandler(void *arg) {
+  EventLoop *loop = (EventLoop *)arg;
+  struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+  while (1) {
+    int ready = epoll_wait(loop->epoll_fd, events, EVENT_LOOP_MAX_EVENTS,
+                           timer_wheel_next_ms(&loop->timers,
+                                               timer_clock_ms()));
+    if (ready == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      Log(stderr, ERROR, "Couldn't wait for events: %s", strerror(errno));
+      return NULL;
+    }
+    unsigned long long now = timer_clock_ms();
+    for (int i = 0; i < ready; ++i) {
+      Connection *conn = events[i].data.ptr;
+      if (!conn) {
+        event_loop_accept(loop);
+        continue;
+      }
+      if (connection_serve(conn) == CONNECTION_CLOSE) {
+        event_loop_close(loop, conn);
+      } else {
+        connection_schedule(conn, &loop->timers, now);
+      }
+    }
+    event_loop_reap(loop, now);
+  }
+  return NULL;
+}
+
+// Closes the connections whose deadline passed
+void event_loop_reap(EventLoop *loop, unsigned long long now_ms) {
+  Timer *timer;
+  while ((timer = timer_wheel_expire(&loop->timers, now_ms))) {
+    Connection *conn = timer->owner;
+    unsigned long long deadline =
+        atomic_load_explicit(&conn->deadline, memory_order_relaxed);
+    if (!deadline) {
+      continue;
+    }
+    if (deadline > now_ms) {
+      timer_wheel_schedule(&loop->timers, timer, deadline);
+      continue;
+    }
+    event_loop_close(loop, conn);
+  }
+}
+
+void event_loop_close(EventLoop *loop, Connection *conn) {
+  timer_wheel_cancel(&loop->timers, &conn->timer);
+  connection_close(conn);
+  connection_free(conn);
+  free(conn);
+}
+
+void event_loop_accept(EventLoop *loop) {
+  unsigned long long now = timer_clock_ms();
+  while (1) {
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+    int client_fd =
+        accept4(loop->listen_fd, (struct sockaddr *)&client_addr,
+                &client_addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_fd == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        Log(stderr, ERROR, "Couldn't Accept conn: %s", strerror(errno));
+      }
+      return;
+    }
+
+    if (admission_connection_acquire(loop->app->_admission) == -1) {
+      admission_reject(loop->app->_admission, client_fd);
+      continue;
+    }
+    Connection *conn = malloc(sizeof(Connection));
+    if (!conn) {
+      Log(stderr, ERROR, "Couldn't allocate connection: %s", strerror(errno));
+      close(client_fd);
+      admission_connection_release(loop->app->_admission);
+      continue;
+    }
+    Client client = {.address = client_addr, .file_descriptor = client_fd};
+    connection_init(conn, loop->app, client, 0);
+    conn->timer.owner = conn;
+
+    // Edge-triggered: the connection is only reported again once new data
+    // arrives or the socket becomes writable after an EAGAIN
+    struct epoll_event event = {
+        .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+        .data.ptr = conn,
+    };
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, client_fd, &event) == -1) {
+      Log(stderr, ERROR, "Couldn't watch client: %s", strerror(errno));
+      event_loop_close(loop, conn);
+      continue;
+    }
+    connection_schedule(conn, &loop->timers, now);
+  }
+}
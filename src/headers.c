@@ -0,0 +1,103 @@
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../include/alpha/headers.h"
+
+typedef struct {
+  const char *name;
+  usize len;
+  HeaderId id;
+} KnownHeader;
+
+#define KNOWN_HEADER(name, id) {name, sizeof(name) - 1, id}
+
+const KnownHeader KNOWN_HEADERS[] = {
+    KNOWN_HEADER("Accept", HEADER_ACCEPT),
+    KNOWN_HEADER("Accept-Encoding", HEADER_ACCEPT_ENCODING),
+    KNOWN_HEADER("Accept-Language", HEADER_ACCEPT_LANGUAGE),
+    KNOWN_HEADER("Authorization", HEADER_AUTHORIZATION),
+    KNOWN_HEADER("Cache-Control", HEADER_CACHE_CONTROL),
+    KNOWN_HEADER("Connection", HEADER_CONNECTION),
+    KNOWN_HEADER("Content-Length", HEADER_CONTENT_LENGTH),
+    KNOWN_HEADER("Content-Type", HEADER_CONTENT_TYPE),
+    KNOWN_HEADER("Cookie", HEADER_COOKIE),
+    KNOWN_HEADER("Expect", HEADER_EXPECT),
+    KNOWN_HEADER("Host", HEADER_HOST),
+    KNOWN_HEADER("If-Match", HEADER_IF_MATCH),
+    KNOWN_HEADER("If-Modified-Since", HEADER_IF_MODIFIED_SINCE),
+    KNOWN_HEADER("If-None-Match", HEADER_IF_NONE_MATCH),
+    KNOWN_HEADER("If-Range", HEADER_IF_RANGE),
+    KNOWN_HEADER("If-Unmodified-Since", HEADER_IF_UNMODIFIED_SINCE),
+    KNOWN_HEADER("Origin", HEADER_ORIGIN),
+    KNOWN_HEADER("Range", HEADER_RANGE),
+    KNOWN_HEADER("Referer", HEADER_REFERER),
+    KNOWN_HEADER("Transfer-Encoding", HEADER_TRANSFER_ENCODING),
+    KNOWN_HEADER("Upgrade", HEADER_UPGRADE),
+    KNOWN_HEADER("User-Agent", HEADER_USER_AGENT),
+    KNOWN_HEADER("X-Forwarded-For", HEADER_X_FORWARDED_FOR),
+};
+
+#define KNOWN_HEADERS_LEN (sizeof(KNOWN_HEADERS) / sizeof(KnownHeader))
+
+// Length and first letter rule out almost every candidate before any
+// case-insensitive compare runs
+HeaderId header_id(Slice name) {
+  if (name.len == 0) {
+    return HEADER_UNKNOWN;
+  }
+  int first = tolower((unsigned char)name.ptr[0]);
+  for (usize i = 0; i < KNOWN_HEADERS_LEN; ++i) {
+    const KnownHeader *known = &KNOWN_HEADERS[i];
+    if (known->len == name.len && tolower(known->name[0]) == first &&
+        strncasecmp(known->name, name.ptr, name.len) == 0) {
+      return known->id;
+    }
+  }
+  return HEADER_UNKNOWN;
+}
+
+void headers_reset(HttpHeaders *headers) {
+  headers->count = 0;
+  memset(headers->first, 0, sizeof(headers->first));
+}
+
+// Returns -1 once REQUEST_HEADERS_MAX headers are stored
+int headers_add(HttpHeaders *headers, Slice name, Slice value) {
+  if (headers->count == REQUEST_HEADERS_MAX) {
+    return -1;
+  }
+  HttpHeader *header = &headers->entries[headers->count++];
+  header->name = name;
+  header->value = value;
+  header->id = header_id(name);
+  if (header->id != HEADER_UNKNOWN && !headers->first[header->id]) {
+    headers->first[header->id] = headers->count;
+  }
+  return 0;
+}
+
+const HttpHeader *headers_find(const HttpHeaders *headers, HeaderId id) {
+  if (id <= HEADER_UNKNOWN || id >= HEADERS_KNOWN_COUNT ||
+      !headers->first[id]) {
+    return NULL;
+  }
+  return &headers->entries[headers->first[id] - 1];
+}
+
+const HttpHeader *headers_find_name(const HttpHeaders *headers,
+                                    const char *name) {
+  Slice wanted = {name, strlen(name)};
+  HeaderId id = header_id(wanted);
+  if (id != HEADER_UNKNOWN) {
+    return headers_find(headers, id);
+  }
+  for (usize i = 0; i < headers->count; ++i) {
+    const HttpHeader *header = &headers->entries[i];
+    if (header->name.len == wanted.len &&
+        strncasecmp(header->name.ptr, name, wanted.len) == 0) {
+      return header;
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,90 @@
+#include <string.h>
+
+#include "../include/alpha/http.h"
+
+#define STATUS_LINE(code, reason)                                              \
+  [code] = {"HTTP/1.1 " #code " " reason "\r\n",                               \
+            sizeof("HTTP/1.1 " #code " " reason "\r\n") - 1}
+
+// Indexed by status code, so a response never formats its status line
+const Slice STATUS_LINES[HTTP_STATUS_MAX] = {
+    STATUS_LINE(200, "OK"),
+    STATUS_LINE(201, "Created"),
+    STATUS_LINE(202, "Accepted"),
+    STATUS_LINE(204, "No Content"),
+    STATUS_LINE(206, "Partial Content"),
+    STATUS_LINE(301, "Moved Permanently"),
+    STATUS_LINE(302, "Found"),
+    STATUS_LINE(303, "See Other"),
+    STATUS_LINE(304, "Not Modified"),
+    STATUS_LINE(307, "Temporary Redirect"),
+    STATUS_LINE(308, "Permanent Redirect"),
+    STATUS_LINE(400, "Bad Request"),
+    STATUS_LINE(401, "Unauthorized"),
+    STATUS_LINE(403, "Forbidden"),
+    STATUS_LINE(404, "Not Found"),
+    STATUS_LINE(405, "Method Not Allowed"),
+    STATUS_LINE(408, "Request Timeout"),
+    STATUS_LINE(409, "Conflict"),
+    STATUS_LINE(410, "Gone"),
+    STATUS_LINE(411, "Length Required"),
+    STATUS_LINE(412, "Precondition Failed"),
+    STATUS_LINE(413, "Content Too Large"),
+    STATUS_LINE(414, "URI Too Long"),
+    STATUS_LINE(415, "Unsupported Media Type"),
+    STATUS_LINE(416, "Range Not Satisfiable"),
+    STATUS_LINE(417, "Expectation Failed"),
+    STATUS_LINE(422, "Unprocessable Content"),
+    STATUS_LINE(429, "Too Many Requests"),
+    STATUS_LINE(431, "Request Header Fields Too Large"),
+    STATUS_LINE(500, "Internal Server Error"),
+    STATUS_LINE(501, "Not Implemented"),
+    STATUS_LINE(502, "Bad Gateway"),
+    STATUS_LINE(503, "Service Unavailable"),
+    STATUS_LINE(504, "Gateway Timeout"),
+    STATUS_LINE(505, "HTTP Version Not Supported"),
+};
+
+// The prebuilt status line for `status`, empty for codes without one
+Slice http_status_line(StatusCode status) {
+  if ((unsigned)status >= HTTP_STATUS_MAX) {
+    return (Slice){0};
+  }
+  return STATUS_LINES[status];
+}
+
+int http_write_status_line(Buffer *out, StatusCode status) {
+  Slice line = http_status_line(status);
+  if (line.len) {
+    return buffer_append(out, line.ptr, line.len);
+  }
+  // Handlers may answer with codes the table doesn't know, the reason
+  // phrase is optional
+  return buffer_appendf(out, "HTTP/1.1 %d \r\n", status);
+}
+
+// Writes the status line, Content-Type, Content-Length, `extra_headers`, the
+// `connection` header and the blank line, all with plain copies
+int http_write_head(Buffer *out, StatusCode status, const char *content_type,
+                    usize content_length, const char *extra_headers,
+                    const char *connection) {
+  usize type_len = strlen(content_type);
+  usize extra_len = strlen(extra_headers);
+  usize connection_len = strlen(connection);
+  // Enough for the longest status line and the fixed parts, so none of the
+  // copies below can fail
+  if (buffer_reserve(out, 128 + type_len + extra_len + connection_len) ==
+          -1 ||
+      http_write_status_line(out, status) == -1) {
+    return -1;
+  }
+  buffer_append(out, "Content-Type: ", 14);
+  buffer_append(out, content_type, type_len);
+  buffer_append(out, "\r\nContent-Length: ", 18);
+  buffer_append_usize(out, content_length);
+  buffer_append(out, "\r\n", 2);
+  buffer_append(out, extra_headers, extra_len);
+  buffer_append(out, connection, connection_len);
+  buffer_append(out, "\r\n", 2);
+  return 0;
+}
@@ -0,0 +1,180 @@
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../exteral/jack/include/jack.h"
+
+#include "../include/alpha/json.h"
+
+// Helpers
+int json_write_array(Buffer *out, const JsonArray *array);
+int json_write_integer(Buffer *out, signed long long number);
+
+// Compact serialization of `object` appended to `out`: no whitespace, one
+// pass, strings escaped. jack's Json_Stringfy pretty-prints through stdio and
+// doesn't escape at all.
+int json_write(Buffer *out, const Json *object) {
+  if (buffer_append(out, "{", 1) == -1) {
+    return -1;
+  }
+  for (usize i = 0; i < object->entries_count; ++i) {
+    const JsonKeyValuePair *pair = &object->entries[i];
+    if ((i > 0 && buffer_append(out, ",", 1) == -1) ||
+        json_write_string(out, pair->key, strlen(pair->key)) == -1 ||
+        buffer_append(out, ":", 1) == -1 ||
+        json_write_value(out, &pair->value) == -1) {
+      return -1;
+    }
+  }
+  return buffer_append(out, "}", 1);
+}
+
+int json_write_value(Buffer *out, const JsonValue *value) {
+  switch (value->type) {
+  case JSON_NUMBER:
+    return json_write_integer(out, value->data.number);
+  case JSON_STRING:
+    return json_write_string(out, value->data.string,
+                             strlen(value->data.string));
+  case JSON_ARRAY:
+    return json_write_array(out, &value->data.array);
+  case JSON_OBJECT:
+    return json_write(out, value->data.object);
+  case JSON_BOOLEAN:
+    return value->data.boolean ? buffer_append(out, "true", 4)
+                               : buffer_append(out, "false", 5);
+  case JSON_NULL:
+  default:
+    return buffer_append(out, "null", 4);
+  }
+}
+
+int json_write_array(Buffer *out, const JsonArray *array) {
+  if (buffer_append(out, "[", 1) == -1) {
+    return -1;
+  }
+  for (usize i = 0; i < array->length; ++i) {
+    if ((i > 0 && buffer_append(out, ",", 1) == -1) ||
+        json_write_value(out, &array->entries[i]) == -1) {
+      return -1;
+    }
+  }
+  return buffer_append(out, "]", 1);
+}
+
+int json_write_integer(Buffer *out, signed long long number) {
+  if (number < 0) {
+    if (buffer_append(out, "-", 1) == -1) {
+      return -1;
+    }
+    // Negated as unsigned so LLONG_MIN doesn't overflow
+    return buffer_append_usize(out, -(unsigned long long)number);
+  }
+  return buffer_append_usize(out, number);
+}
+
+// Copies the runs that need no escaping in one go, so clean strings cost a
+// vector scan and a memcpy
+int json_write_string(Buffer *out, const char *str, usize len) {
+  static const char hex[] = "0123456789abcdef";
+  // Worst case every byte becomes \u00XX
+  if (buffer_reserve(out, len * 6 + 2) == -1) {
+    return -1;
+  }
+  char *dst = out->data + out->len;
+  *dst++ = '"';
+  const char *end = str + len;
+  while (str < end) {
+    const char *escape = json_find_escape(str, end);
+    memcpy(dst, str, escape - str);
+    dst += escape - str;
+    if (escape == end) {
+      break;
+    }
+    unsigned char c = *escape;
+    *dst++ = '\\';
+    switch (c) {
+    case '"':
+    case '\\':
+      *dst++ = c;
+      break;
+    case '\b':
+      *dst++ = 'b';
+      break;
+    case '\f':
+      *dst++ = 'f';
+      break;
+    case '\n':
+      *dst++ = 'n';
+      break;
+    case '\r':
+      *dst++ = 'r';
+      break;
+    case '\t':
+      *dst++ = 't';
+      break;
+    default:
+      memcpy(dst, "u00", 3);
+      dst[3] = hex[c >> 4];
+      dst[4] = hex[c & 0xf];
+      dst += 5;
+      break;
+    }
+    str = escape + 1;
+  }
+  *dst++ = '"';
+  out->len = dst - out->data;
+  return 0;
+}
+
+// First byte in [ptr, end) that can't appear raw in a JSON string: a quote,
+// a backslash or a control character
+const char *json_find_escape(const char *ptr, const char *end) {
+#if defined(__AVX2__)
+  const __m256i space = _mm256_set1_epi8(0x20);
+  const __m256i minus_one = _mm256_set1_epi8(-1);
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  while (end - ptr >= 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)ptr);
+    // Signed compares, so bytes >= 0x80 are negative and left alone
+    __m256i hit = _mm256_and_si256(_mm256_cmpgt_epi8(space, chunk),
+                                   _mm256_cmpgt_epi8(chunk, minus_one));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(chunk, quote));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(chunk, backslash));
+    unsigned int mask = _mm256_movemask_epi8(hit);
+    if (mask) {
+      return ptr + __builtin_ctz(mask);
+    }
+    ptr += 32;
+  }
+#elif defined(__SSE2__)
+  const __m128i space = _mm_set1_epi8(0x20);
+  const __m128i minus_one = _mm_set1_epi8(-1);
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  while (end - ptr >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)ptr);
+    __m128i hit = _mm_and_si128(_mm_cmpgt_epi8(space, chunk),
+                                _mm_cmpgt_epi8(chunk, minus_one));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(chunk, quote));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(chunk, backslash));
+    unsigned int mask = _mm_movemask_epi8(hit);
+    if (mask) {
+      return ptr + __builtin_ctz(mask);
+    }
+    ptr += 16;
+  }
+#endif
+  for (; ptr < end; ++ptr) {
+    unsigned char c = *ptr;
+    if (c < 0x20 || c == '"' || c == '\\') {
+      return ptr;
+    }
+  }
+  return end;
+}
@@ -0,0 +1,735 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../include/alpha/json.h"
+
+#define JSON_BLOCK 64
+
+// Bit i of each mask describes byte i of a 64-byte block
+typedef struct {
+  uint64_t quote;
+  uint64_t backslash;
+  uint64_t op;
+  uint64_t whitespace;
+  uint64_t control;
+  uint64_t high;
+} JsonBlockMasks;
+
+typedef struct {
+  const char *data;
+  usize len;
+  // Stage 1 output: offsets of structural characters and of the first byte
+  // of every string, number and literal. Only needed while parsing, so it
+  // lives on the heap rather than in the arena.
+  uint32_t *indices;
+  usize count;
+  usize capacity;
+  // Members or items of every container, in the order they're opened
+  uint32_t *counts;
+  usize containers;
+  usize next;
+  usize next_container;
+  Arena *arena;
+  JsonError *error;
+} JsonParser;
+
+// Helpers
+void json_block_masks(const char *block, JsonBlockMasks *masks);
+uint64_t json_escaped(uint64_t backslash, uint64_t *prev_escaped);
+uint64_t json_prefix_xor(uint64_t bits);
+int json_index(JsonParser *parser);
+int json_index_grow(JsonParser *parser);
+const JsonNode *json_parse_document(JsonParser *parser);
+int json_count_children(JsonParser *parser);
+int json_utf8_valid(const unsigned char *ptr, const unsigned char *end);
+int json_fail(JsonParser *parser, usize offset, const char *message);
+int json_parse_value(JsonParser *parser, JsonNode *node);
+int json_parse_container(JsonParser *parser, JsonNode *node, usize open);
+int json_parse_string(JsonParser *parser, usize offset, Slice *out);
+int json_decode_string(JsonParser *parser, const char *ptr,
+                       const char *end, Slice *out);
+int json_parse_number(JsonParser *parser, usize offset, JsonNode *node);
+int json_parse_literal(JsonParser *parser, usize offset, const char *literal,
+                       usize literal_len);
+int json_is_delimiter(JsonParser *parser, usize offset);
+
+// Parses `len` bytes of JSON into a tree allocated from `arena`. Strings
+// without escapes point into `data`, which has to outlive the tree. Returns
+// NULL and fills `error` if the input isn't valid JSON.
+const JsonNode *json_parse(Arena *arena, const char *data, usize len,
+                           JsonError *error) {
+  JsonParser parser = {
+      .data = data,
+      .len = len,
+      .arena = arena,
+      .error = error,
+  };
+  if (len > UINT32_MAX) {
+    json_fail(&parser, 0, "document too large");
+    return NULL;
+  }
+  const JsonNode *root = json_parse_document(&parser);
+  free(parser.indices);
+  free(parser.counts);
+  return root;
+}
+
+const JsonNode *json_parse_document(JsonParser *parser) {
+  if (json_index(parser) == -1) {
+    return NULL;
+  }
+  parser->counts = malloc(sizeof(uint32_t) * (parser->containers + 1));
+  JsonNode *root = arena_alloc(parser->arena, sizeof(JsonNode));
+  if (!parser->counts || !root) {
+    json_fail(parser, 0, "out of memory");
+    return NULL;
+  }
+  if (json_count_children(parser) == -1) {
+    return NULL;
+  }
+  if (parser->count == 0) {
+    json_fail(parser, parser->len, "empty document");
+    return NULL;
+  }
+  if (json_parse_value(parser, root) == -1) {
+    return NULL;
+  }
+  if (parser->next != parser->count) {
+    json_fail(parser, parser->indices[parser->next],
+              "unexpected data after the document");
+    return NULL;
+  }
+  return root;
+}
+
+int json_fail(JsonParser *parser, usize offset, const char *message) {
+  if (parser->error) {
+    parser->error->message = message;
+    parser->error->offset = offset;
+  }
+  return -1;
+}
+
+void json_block_masks(const char *block, JsonBlockMasks *masks) {
+#if defined(__AVX2__)
+  uint64_t quote = 0, backslash = 0, op = 0, whitespace = 0, control = 0,
+           high = 0;
+  for (int half = 0; half < 2; ++half) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)(block + half * 32));
+    // Folding 0x20 into '[' ']' turns them into '{' '}', so both pairs take
+    // two compares
+    __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+    __m256i is_op = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+                        _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(',')),
+                        _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(':'))));
+    __m256i is_space = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+                        _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')),
+                        _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))));
+    // Signed compares, so bytes >= 0x80 are negative and left alone
+    __m256i is_control = _mm256_and_si256(
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), chunk),
+        _mm256_cmpgt_epi8(chunk, _mm256_set1_epi8(-1)));
+    int shift = half * 32;
+    quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                 _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')))
+             << shift;
+    backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                     _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\')))
+                 << shift;
+    op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_op) << shift;
+    whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_space) << shift;
+    control |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_control) << shift;
+    high |= (uint64_t)(uint32_t)_mm256_movemask_epi8(chunk) << shift;
+  }
+#elif defined(__SSE2__)
+  uint64_t quote = 0, backslash = 0, op = 0, whitespace = 0, control = 0,
+           high = 0;
+  for (int quarter = 0; quarter < 4; ++quarter) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(block + quarter * 16));
+    // Folding 0x20 into '[' ']' turns them into '{' '}', so both pairs take
+    // two compares
+    __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+    __m128i is_op = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                     _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(',')),
+                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8(':'))));
+    __m128i is_space = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')),
+                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+    __m128i is_control =
+        _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(0x20), chunk),
+                      _mm_cmpgt_epi8(chunk, _mm_set1_epi8(-1)));
+    int shift = quarter * 16;
+    quote |= (uint64_t)_mm_movemask_epi8(
+                 _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')))
+             << shift;
+    backslash |= (uint64_t)_mm_movemask_epi8(
+                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')))
+                 << shift;
+    op |= (uint64_t)_mm_movemask_epi8(is_op) << shift;
+    whitespace |= (uint64_t)_mm_movemask_epi8(is_space) << shift;
+    control |= (uint64_t)_mm_movemask_epi8(is_control) << shift;
+    high |= (uint64_t)_mm_movemask_epi8(chunk) << shift;
+  }
+#else
+  uint64_t quote = 0, backslash = 0, op = 0, whitespace = 0, control = 0,
+           high = 0;
+  for (int i = 0; i < JSON_BLOCK; ++i) {
+    unsigned char c = block[i];
+    uint64_t bit = (uint64_t)1 << i;
+    quote |= c == '"' ? bit : 0;
+    backslash |= c == '\\' ? bit : 0;
+    op |= (c == '{' || c == '}' || c == '[' || c == ']' || c == ',' ||
+           c == ':')
+              ? bit
+              : 0;
+    whitespace |= (c == ' ' || c == '\t' || c == '\n' || c == '\r') ? bit : 0;
+    control |= c < 0x20 ? bit : 0;
+    high |= c >= 0x80 ? bit : 0;
+  }
+#endif
+  masks->quote = quote;
+  masks->backslash = backslash;
+  masks->op = op;
+  masks->whitespace = whitespace;
+  masks->control = control;
+  masks->high = high;
+}
+
+// Bytes preceded by an odd run of backslashes, carrying runs that cross into
+// the next block (simdjson's branchless version)
+uint64_t json_escaped(uint64_t backslash, uint64_t *prev_escaped) {
+  const uint64_t even_bits = 0x5555555555555555ULL;
+  backslash &= ~*prev_escaped;
+  uint64_t follows_escape = backslash << 1 | *prev_escaped;
+  uint64_t odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+  uint64_t sequences_starting_on_even_bits;
+  *prev_escaped = __builtin_add_overflow(odd_sequence_starts, backslash,
+                                         &sequences_starting_on_even_bits);
+  uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+  return (even_bits ^ invert_mask) & follows_escape;
+}
+
+// Bit i is set when an odd number of bits up to and including i are, which
+// turns quote positions into a mask of what lies inside strings
+uint64_t json_prefix_xor(uint64_t bits) {
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+}
+
+// Stage 1: classifies 64 bytes at a time and records where every token
+// starts. Strings are masked out as a whole, so nothing inside them is ever
+// looked at again until a handler reads them.
+int json_index(JsonParser *parser) {
+  uint64_t prev_escaped = 0;
+  uint64_t prev_in_string = 0;
+  uint64_t prev_scalar = 0;
+  uint64_t high = 0;
+  char padded[JSON_BLOCK];
+  for (usize base = 0; base < parser->len; base += JSON_BLOCK) {
+    const char *block = parser->data + base;
+    usize block_len = parser->len - base;
+    if (block_len < JSON_BLOCK) {
+      memset(padded, ' ', JSON_BLOCK);
+      memcpy(padded, block, block_len);
+      block = padded;
+    }
+    JsonBlockMasks masks;
+    json_block_masks(block, &masks);
+
+    uint64_t escaped = json_escaped(masks.backslash, &prev_escaped);
+    uint64_t quote = masks.quote & ~escaped;
+    // Opening quotes and string contents, but not closing quotes
+    uint64_t in_string = json_prefix_xor(quote) ^ prev_in_string;
+    prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+    uint64_t string_tail = in_string ^ quote;
+    if (masks.control & in_string) {
+      return json_fail(parser,
+                       base + __builtin_ctzll(masks.control & in_string),
+                       "control character in string");
+    }
+
+    uint64_t op = masks.op & ~in_string;
+    uint64_t scalar = ~(op | masks.whitespace);
+    uint64_t nonquote_scalar = scalar & ~quote;
+    uint64_t follows_scalar = nonquote_scalar << 1 | prev_scalar;
+    prev_scalar = nonquote_scalar >> 63;
+    uint64_t structural = (op | (scalar & ~follows_scalar)) & ~string_tail;
+    high |= masks.high;
+
+    // The padding past the end is whitespace and never structural
+    if (parser->capacity - parser->count < JSON_BLOCK &&
+        json_index_grow(parser) == -1) {
+      return json_fail(parser, base, "out of memory");
+    }
+    while (structural) {
+      usize offset = base + __builtin_ctzll(structural);
+      char c = parser->data[offset];
+      parser->containers += c == '{' || c == '[';
+      parser->indices[parser->count++] = offset;
+      structural &= structural - 1;
+    }
+  }
+  if (prev_in_string) {
+    return json_fail(parser, parser->len, "unterminated string");
+  }
+  if (high && !json_utf8_valid((const unsigned char *)parser->data,
+                               (const unsigned char *)parser->data +
+                                   parser->len)) {
+    return json_fail(parser, 0, "invalid UTF-8");
+  }
+  return 0;
+}
+
+// Room for another block's worth of tokens. Documents usually hold a token
+// every few bytes, so the index starts at a quarter of the input and only
+// reaches a token per byte for input built to get there.
+int json_index_grow(JsonParser *parser) {
+  usize capacity = parser->capacity ? parser->capacity * 2
+                                    : parser->len / 4 + JSON_BLOCK;
+  if (capacity > parser->len + JSON_BLOCK) {
+    capacity = parser->len + JSON_BLOCK;
+  }
+  uint32_t *indices = realloc(parser->indices, sizeof(uint32_t) * capacity);
+  if (!indices) {
+    return -1;
+  }
+  parser->indices = indices;
+  parser->capacity = capacity;
+  return 0;
+}
+
+int json_utf8_valid(const unsigned char *ptr, const unsigned char *end) {
+  while (ptr < end) {
+    unsigned char c = *ptr;
+    if (c < 0x80) {
+      ptr++;
+      continue;
+    }
+    usize len;
+    uint32_t code;
+    if ((c & 0xe0) == 0xc0) {
+      len = 2;
+      code = c & 0x1f;
+    } else if ((c & 0xf0) == 0xe0) {
+      len = 3;
+      code = c & 0x0f;
+    } else if ((c & 0xf8) == 0xf0) {
+      len = 4;
+      code = c & 0x07;
+    } else {
+      return 0;
+    }
+    if ((usize)(end - ptr) < len) {
+      return 0;
+    }
+    for (usize i = 1; i < len; ++i) {
+      if ((ptr[i] & 0xc0) != 0x80) {
+        return 0;
+      }
+      code = code << 6 | (ptr[i] & 0x3f);
+    }
+    // Overlong forms, surrogates and code points past U+10FFFF
+    if ((len == 2 && code < 0x80) || (len == 3 && code < 0x800) ||
+        (len == 4 && code < 0x10000) || code > 0x10ffff ||
+        (code >= 0xd800 && code <= 0xdfff)) {
+      return 0;
+    }
+    ptr += len;
+  }
+  return 1;
+}
+
+// Matches brackets and counts the children of every container, so stage 2
+// allocates each one exactly once
+int json_count_children(JsonParser *parser) {
+  // Index of each open container and its place in `counts`
+  uint32_t stack[JSON_DEPTH_MAX];
+  uint32_t ordinals[JSON_DEPTH_MAX];
+  usize depth = 0;
+  usize containers = 0;
+  for (usize i = 0; i < parser->count; ++i) {
+    char c = parser->data[parser->indices[i]];
+    if (c == '{' || c == '[') {
+      if (depth == JSON_DEPTH_MAX) {
+        return json_fail(parser, parser->indices[i], "nested too deeply");
+      }
+      parser->counts[containers] = 0;
+      ordinals[depth] = containers++;
+      stack[depth++] = i;
+    } else if (c == ',') {
+      if (depth == 0) {
+        return json_fail(parser, parser->indices[i], "unexpected ','");
+      }
+      parser->counts[ordinals[depth - 1]]++;
+    } else if (c == '}' || c == ']') {
+      if (depth == 0 ||
+          parser->data[parser->indices[stack[depth - 1]]] != c - 2) {
+        return json_fail(parser, parser->indices[i], "mismatched bracket");
+      }
+      uint32_t open = stack[--depth];
+      uint32_t *count = &parser->counts[ordinals[depth]];
+      // Commas separate children, an empty container has neither
+      *count = open + 1 == i ? 0 : *count + 1;
+    }
+  }
+  if (depth) {
+    return json_fail(parser, parser->len, "unclosed bracket");
+  }
+  return 0;
+}
+
+// Stage 2: builds the tree walking the indices only. Nesting is bounded by
+// stage 1, so the recursion is too.
+int json_parse_value(JsonParser *parser, JsonNode *node) {
+  if (parser->next == parser->count) {
+    return json_fail(parser, parser->len, "unexpected end of document");
+  }
+  usize index = parser->next++;
+  usize offset = parser->indices[index];
+  memset(node, 0, sizeof(JsonNode));
+  switch (parser->data[offset]) {
+  case '{':
+  case '[':
+    return json_parse_container(parser, node, index);
+  case '"':
+    node->type = JSON_NODE_STRING;
+    return json_parse_string(parser, offset, &node->string);
+  case 't':
+    node->type = JSON_NODE_TRUE;
+    return json_parse_literal(parser, offset, "true", 4);
+  case 'f':
+    node->type = JSON_NODE_FALSE;
+    return json_parse_literal(parser, offset, "false", 5);
+  case 'n':
+    node->type = JSON_NODE_NULL;
+    return json_parse_literal(parser, offset, "null", 4);
+  case '-':
+  case '0':
+  case '1':
+  case '2':
+  case '3':
+  case '4':
+  case '5':
+  case '6':
+  case '7':
+  case '8':
+  case '9':
+    return json_parse_number(parser, offset, node);
+  default:
+    return json_fail(parser, offset, "unexpected character");
+  }
+}
+
+int json_parse_container(JsonParser *parser, JsonNode *node, usize open) {
+  int is_object = parser->data[parser->indices[open]] == '{';
+  char close = is_object ? '}' : ']';
+  // Containers are reached in the order they were opened
+  usize count = parser->counts[parser->next_container++];
+  node->type = is_object ? JSON_NODE_OBJECT : JSON_NODE_ARRAY;
+  node->count = count;
+  if (count == 0) {
+    // The matching bracket directly follows, stage 1 checked it
+    parser->next++;
+    return 0;
+  }
+  void *children = arena_alloc(parser->arena, (is_object ? sizeof(JsonMember)
+                                                         : sizeof(JsonNode)) *
+                                                  count);
+  if (!children) {
+    return json_fail(parser, parser->indices[open], "out of memory");
+  }
+  if (is_object) {
+    node->members = children;
+  } else {
+    node->items = children;
+  }
+
+  for (usize i = 0; i < count; ++i) {
+    JsonNode *child = is_object ? NULL : &node->items[i];
+    if (is_object) {
+      JsonMember *member = &node->members[i];
+      usize key = parser->indices[parser->next];
+      if (parser->data[key] != '"') {
+        return json_fail(parser, key, "expected a string key");
+      }
+      parser->next++;
+      if (json_parse_string(parser, key, &member->key) == -1) {
+        return -1;
+      }
+      usize colon = parser->indices[parser->next];
+      if (parser->data[colon] != ':') {
+        return json_fail(parser, colon, "expected ':'");
+      }
+      parser->next++;
+      child = &member->value;
+    }
+    if (json_parse_value(parser, child) == -1) {
+      return -1;
+    }
+    // Brackets are balanced, so a separator or the close always follows
+    usize separator = parser->indices[parser->next++];
+    char expected = i + 1 == count ? close : ',';
+    if (parser->data[separator] != expected) {
+      return json_fail(parser, separator,
+                       expected == ',' ? "expected ','" : "expected the end");
+    }
+  }
+  return 0;
+}
+
+int json_parse_string(JsonParser *parser, usize offset, Slice *out) {
+  const char *start = parser->data + offset + 1;
+  const char *end = parser->data + parser->len;
+  const char *stop = json_find_escape(start, end);
+  if (stop < end && *stop == '"') {
+    *out = (Slice){start, stop - start};
+    return 0;
+  }
+  return json_decode_string(parser, start, end, out);
+}
+
+// Slow path for strings with escapes: finds the closing quote, then decodes
+// into the arena (never longer than the raw string)
+int json_decode_string(JsonParser *parser, const char *ptr,
+                       const char *end, Slice *out) {
+  const char *close = ptr;
+  while (1) {
+    close = json_find_escape(close, end);
+    if (close == end) {
+      return json_fail(parser, parser->len, "unterminated string");
+    }
+    if (*close == '"') {
+      break;
+    }
+    if (*close != '\\' || close + 1 == end) {
+      return json_fail(parser, close - parser->data,
+                       "control character in string");
+    }
+    close += 2;
+  }
+
+  char *decoded = arena_alloc(parser->arena, close - ptr);
+  if (!decoded) {
+    return json_fail(parser, ptr - parser->data, "out of memory");
+  }
+  char *dst = decoded;
+  while (ptr < close) {
+    if (*ptr != '\\') {
+      *dst++ = *ptr++;
+      continue;
+    }
+    const char *escape = ptr;
+    ptr++;
+    switch (*ptr++) {
+    case '"':
+      *dst++ = '"';
+      break;
+    case '\\':
+      *dst++ = '\\';
+      break;
+    case '/':
+      *dst++ = '/';
+      break;
+    case 'b':
+      *dst++ = '\b';
+      break;
+    case 'f':
+      *dst++ = '\f';
+      break;
+    case 'n':
+      *dst++ = '\n';
+      break;
+    case 'r':
+      *dst++ = '\r';
+      break;
+    case 't':
+      *dst++ = '\t';
+      break;
+    case 'u': {
+      uint32_t code = 0;
+      for (int units = 0; units < 2; ++units) {
+        uint32_t unit = 0;
+        if (close - ptr < 4) {
+          return json_fail(parser, escape - parser->data,
+                           "invalid \\u escape");
+        }
+        for (int i = 0; i < 4; ++i) {
+          char c = *ptr++;
+          unit <<= 4;
+          if (c >= '0' && c <= '9') {
+            unit |= c - '0';
+          } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+            unit |= (c | 0x20) - 'a' + 10;
+          } else {
+            return json_fail(parser, escape - parser->data,
+                             "invalid \\u escape");
+          }
+        }
+        if (units == 0) {
+          code = unit;
+          if (unit < 0xd800 || unit > 0xdfff) {
+            break;
+          }
+          // A high surrogate needs a low one in the next escape
+          if (unit > 0xdbff || close - ptr < 6 || ptr[0] != '\\' ||
+              ptr[1] != 'u') {
+            return json_fail(parser, escape - parser->data,
+                             "unpaired surrogate");
+          }
+          ptr += 2;
+        } else {
+          if (unit < 0xdc00 || unit > 0xdfff) {
+            return json_fail(parser, escape - parser->data,
+                             "unpaired surrogate");
+          }
+          code = 0x10000 + ((code - 0xd800) << 10) + (unit - 0xdc00);
+        }
+      }
+      if (code < 0x80) {
+        *dst++ = code;
+      } else if (code < 0x800) {
+        *dst++ = 0xc0 | code >> 6;
+        *dst++ = 0x80 | (code & 0x3f);
+      } else if (code < 0x10000) {
+        *dst++ = 0xe0 | code >> 12;
+        *dst++ = 0x80 | (code >> 6 & 0x3f);
+        *dst++ = 0x80 | (code & 0x3f);
+      } else {
+        *dst++ = 0xf0 | code >> 18;
+        *dst++ = 0x80 | (code >> 12 & 0x3f);
+        *dst++ = 0x80 | (code >> 6 & 0x3f);
+        *dst++ = 0x80 | (code & 0x3f);
+      }
+      break;
+    }
+    default:
+      return json_fail(parser, escape - parser->data, "invalid escape");
+    }
+  }
+  *out = (Slice){decoded, dst - decoded};
+  return 0;
+}
+
+// Whether the token that started before `offset` ends there
+int json_is_delimiter(JsonParser *parser, usize offset) {
+  if (offset >= parser->len) {
+    return 1;
+  }
+  char c = parser->data[offset];
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',' ||
+         c == ':' || c == ']' || c == '}' || c == '[' || c == '{';
+}
+
+int json_parse_literal(JsonParser *parser, usize offset, const char *literal,
+                       usize literal_len) {
+  if (parser->len - offset < literal_len ||
+      memcmp(parser->data + offset, literal, literal_len) != 0 ||
+      !json_is_delimiter(parser, offset + literal_len)) {
+    return json_fail(parser, offset, "invalid literal");
+  }
+  return 0;
+}
+
+// Integers of up to 18 digits are exact and skip strtod
+int json_parse_number(JsonParser *parser, usize offset, JsonNode *node) {
+  const char *start = parser->data + offset;
+  const char *ptr = start;
+  const char *end = parser->data + parser->len;
+  int negative = ptr < end && *ptr == '-';
+  ptr += negative;
+  const char *digits = ptr;
+  if (ptr == end || *ptr < '0' || *ptr > '9') {
+    return json_fail(parser, offset, "invalid number");
+  }
+  uint64_t integer = 0;
+  if (*ptr == '0') {
+    ptr++;
+  } else {
+    while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+      integer = integer * 10 + (*ptr++ - '0');
+    }
+  }
+  usize digits_len = ptr - digits;
+  int is_integer = 1;
+  if (ptr < end && *ptr == '.') {
+    is_integer = 0;
+    ptr++;
+    if (ptr == end || *ptr < '0' || *ptr > '9') {
+      return json_fail(parser, offset, "invalid number");
+    }
+    while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+      ptr++;
+    }
+  }
+  if (ptr < end && (*ptr == 'e' || *ptr == 'E')) {
+    is_integer = 0;
+    ptr++;
+    if (ptr < end && (*ptr == '+' || *ptr == '-')) {
+      ptr++;
+    }
+    if (ptr == end || *ptr < '0' || *ptr > '9') {
+      return json_fail(parser, offset, "invalid number");
+    }
+    while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+      ptr++;
+    }
+  }
+  if (!json_is_delimiter(parser, ptr - parser->data)) {
+    return json_fail(parser, offset, "invalid number");
+  }
+
+  node->type = JSON_NODE_NUMBER;
+  if (is_integer && digits_len <= 18) {
+    node->is_integer = 1;
+    node->integer = negative ? -(long long)integer : (long long)integer;
+    node->number = node->integer;
+    return 0;
+  }
+  // strtod needs a terminated copy, the body isn't
+  usize len = ptr - start;
+  char local[64];
+  char *copy =
+      len < sizeof(local) ? local : arena_alloc(parser->arena, len + 1);
+  if (!copy) {
+    return json_fail(parser, offset, "out of memory");
+  }
+  memcpy(copy, start, len);
+  copy[len] = '\0';
+  node->number = strtod(copy, NULL);
+  return 0;
+}
+
+const JsonNode *JsonNode_Get(const JsonNode *object, const char *key) {
+  if (!object || object->type != JSON_NODE_OBJECT) {
+    return NULL;
+  }
+  usize key_len = strlen(key);
+  for (usize i = 0; i < object->count; ++i) {
+    const JsonMember *member = &object->members[i];
+    if (member->key.len == key_len &&
+        memcmp(member->key.ptr, key, key_len) == 0) {
+      return &member->value;
+    }
+  }
+  return NULL;
+}
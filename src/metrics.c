@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/alpha/metrics.h"
+
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+
+// Prometheus bucket bounds, in microseconds
+static const unsigned long LATENCY_BOUNDS[] = {
+    100,    250,    500,     1000,    2500,    5000,     10000,   25000,
+    50000,  100000, 250000,  500000,  1000000, 2500000,  5000000, 10000000,
+};
+#define LATENCY_BOUNDS_COUNT (sizeof(LATENCY_BOUNDS) / sizeof(*LATENCY_BOUNDS))
+
+static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+#define QUANTILES_COUNT (sizeof(QUANTILES) / sizeof(*QUANTILES))
+
+static const char *METHOD_NAMES[HTTP_METHODS_COUNT + 1] = {
+    "", "GET", "POST", "PUT", "DELETE", "PATCH",
+};
+
+// Shard of the calling thread, created on its first record
+static _Thread_local MetricsShard *thread_shard;
+static _Thread_local Metrics *thread_shard_owner;
+
+typedef enum {
+  FAMILY_REQUESTS = 0,
+  FAMILY_BYTES_IN,
+  FAMILY_BYTES_OUT,
+  FAMILY_DURATION,
+  FAMILY_QUANTILES,
+  FAMILIES_COUNT,
+} MetricFamily;
+
+static const char *FAMILY_HEADERS[FAMILIES_COUNT] = {
+    "# HELP alpha_requests_total Requests answered.\n"
+    "# TYPE alpha_requests_total counter\n",
+    "# HELP alpha_request_bytes_total Request heads and bodies read.\n"
+    "# TYPE alpha_request_bytes_total counter\n",
+    "# HELP alpha_response_bytes_total Response bytes queued.\n"
+    "# TYPE alpha_response_bytes_total counter\n",
+    "# HELP alpha_request_duration_seconds Time from a complete request head "
+    "to its response being queued.\n"
+    "# TYPE alpha_request_duration_seconds histogram\n",
+    "# HELP alpha_request_duration_quantile_seconds Latency quantiles, within "
+    "12.5%.\n"
+    "# TYPE alpha_request_duration_quantile_seconds gauge\n",
+};
+
+typedef struct {
+  unsigned long requests[METRICS_STATUS_CLASSES];
+  unsigned long bytes_in;
+  unsigned long bytes_out;
+  unsigned long duration_us;
+  unsigned long buckets[METRICS_BUCKETS];
+} RouteTotals;
+
+// Helpers
+MetricsShard *metrics_shard(Metrics *metrics, const Router *router);
+usize latency_bucket(unsigned long us);
+unsigned long latency_bucket_max(usize bucket);
+void metric_add(atomic_ulong *counter, unsigned long value);
+void metrics_sum(Metrics *metrics, usize slot, RouteTotals *totals);
+int metrics_write_family(Buffer *out, MetricFamily family,
+                         const Route *route, const RouteTotals *totals);
+int write_sample(Buffer *out, const char *name, const Route *route,
+                 const char *label, const char *value);
+
+Metrics *metrics_new(void) {
+  Metrics *metrics = calloc(1, sizeof(Metrics));
+  if (!metrics) {
+    return NULL;
+  }
+  pthread_mutex_init(&metrics->shards_lock, NULL);
+  return metrics;
+}
+
+// Routes are all registered before the server runs, so the shard is sized
+// for them once
+MetricsShard *metrics_shard(Metrics *metrics, const Router *router) {
+  if (thread_shard_owner == metrics) {
+    return thread_shard;
+  }
+  usize routes_count = router->_routesCount + 1;
+  usize size = sizeof(MetricsShard) + sizeof(RouteMetrics) * routes_count;
+  MetricsShard *shard = aligned_alloc(64, (size + 63) & ~(usize)63);
+  if (!shard) {
+    return NULL;
+  }
+  memset(shard, 0, size);
+  shard->routes_count = routes_count;
+  pthread_mutex_lock(&metrics->shards_lock);
+  shard->next = atomic_load(&metrics->shards);
+  atomic_store_explicit(&metrics->shards, shard, memory_order_release);
+  pthread_mutex_unlock(&metrics->shards_lock);
+  thread_shard = shard;
+  thread_shard_owner = metrics;
+  return shard;
+}
+
+// Index of the sub-bucket holding `us`: values below 8 get one each, every
+// power of two above is split in 8
+usize latency_bucket(unsigned long us) {
+  if (us < METRICS_SUB_BUCKETS) {
+    return us;
+  }
+  usize msb = 63 - __builtin_clzl(us);
+  usize bucket = (msb - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS +
+                 ((us >> (msb - METRICS_SUB_BUCKET_BITS)) &
+                  (METRICS_SUB_BUCKETS - 1));
+  return bucket < METRICS_BUCKETS ? bucket : METRICS_BUCKETS - 1;
+}
+
+unsigned long latency_bucket_max(usize bucket) {
+  if (bucket < METRICS_SUB_BUCKETS) {
+    return bucket;
+  }
+  usize shift = bucket / METRICS_SUB_BUCKETS - 1;
+  unsigned long sub = bucket % METRICS_SUB_BUCKETS;
+  return ((METRICS_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+// Single writer, so no read-modify-write instruction is needed
+void metric_add(atomic_ulong *counter, unsigned long value) {
+  atomic_store_explicit(
+      counter,
+      atomic_load_explicit(counter, memory_order_relaxed) + value,
+      memory_order_relaxed);
+}
+
+// `route` is NULL for requests no route matched
+void metrics_record(Metrics *metrics, const Router *router, const Route *route,
+                    StatusCode status, usize bytes_in, usize bytes_out,
+                    const struct timespec *started) {
+  if (!metrics) {
+    return;
+  }
+  MetricsShard *shard = metrics_shard(metrics, router);
+  usize slot = route ? route->_id : 0;
+  if (!shard || slot >= shard->routes_count) {
+    return;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  unsigned long us = (now.tv_sec - started->tv_sec) * 1000000 +
+                     (now.tv_nsec - started->tv_nsec) / 1000;
+  usize class = status / 100 - 1;
+  RouteMetrics *counters = &shard->routes[slot];
+  metric_add(&counters->requests[class < METRICS_STATUS_CLASSES ? class : 4],
+             1);
+  metric_add(&counters->bytes_in, bytes_in);
+  metric_add(&counters->bytes_out, bytes_out);
+  metric_add(&counters->duration_us, us);
+  metric_add(&counters->buckets[latency_bucket(us)], 1);
+}
+
+void metrics_sum(Metrics *metrics, usize slot, RouteTotals *totals) {
+  memset(totals, 0, sizeof(RouteTotals));
+  MetricsShard *shard =
+      atomic_load_explicit(&metrics->shards, memory_order_acquire);
+  for (; shard; shard = shard->next) {
+    if (slot >= shard->routes_count) {
+      continue;
+    }
+    RouteMetrics *counters = &shard->routes[slot];
+    for (usize i = 0; i < METRICS_STATUS_CLASSES; ++i) {
+      totals->requests[i] += atomic_load_explicit(&counters->requests[i],
+                                                  memory_order_relaxed);
+    }
+    totals->bytes_in +=
+        atomic_load_explicit(&counters->bytes_in, memory_order_relaxed);
+    totals->bytes_out +=
+        atomic_load_explicit(&counters->bytes_out, memory_order_relaxed);
+    totals->duration_us +=
+        atomic_load_explicit(&counters->duration_us, memory_order_relaxed);
+    for (usize i = 0; i < METRICS_BUCKETS; ++i) {
+      totals->buckets[i] +=
+          atomic_load_explicit(&counters->buckets[i], memory_order_relaxed);
+    }
+  }
+}
+
+int metrics_write(Metrics *metrics, const Router *router, Buffer *out) {
+  usize slots = router->_routesCount + 1;
+  RouteTotals *totals = malloc(sizeof(RouteTotals) * slots);
+  if (!totals) {
+    return -1;
+  }
+  for (usize slot = 0; slot < slots; ++slot) {
+    metrics_sum(metrics, slot, &totals[slot]);
+  }
+  // Prometheus wants the samples of a family together, after its TYPE
+  int status = 0;
+  for (MetricFamily family = 0; family < FAMILIES_COUNT; ++family) {
+    status |= buffer_appendf(out, "%s", FAMILY_HEADERS[family]);
+    for (usize slot = 0; slot < slots; ++slot) {
+      const Route *route = slot ? &router->_routes[slot - 1] : NULL;
+      status |= metrics_write_family(out, family, route, &totals[slot]);
+    }
+  }
+  free(totals);
+  return status ? -1 : 0;
+}
+
+int metrics_write_family(Buffer *out, MetricFamily family,
+                         const Route *route, const RouteTotals *totals) {
+  unsigned long count = 0;
+  for (usize i = 0; i < METRICS_STATUS_CLASSES; ++i) {
+    count += totals->requests[i];
+  }
+  // Unmatched requests are only worth a line once there are some
+  if (!route && count == 0) {
+    return 0;
+  }
+  char label[32];
+  char value[32];
+  int status = 0;
+  switch (family) {
+  case FAMILY_REQUESTS:
+    for (usize i = 0; i < METRICS_STATUS_CLASSES; ++i) {
+      if (totals->requests[i]) {
+        snprintf(label, sizeof(label), ",code=\"%luxx\"", i + 1);
+        snprintf(value, sizeof(value), "%lu", totals->requests[i]);
+        status |=
+            write_sample(out, "alpha_requests_total", route, label, value);
+      }
+    }
+    break;
+  case FAMILY_BYTES_IN:
+    snprintf(value, sizeof(value), "%lu", totals->bytes_in);
+    status |= write_sample(out, "alpha_request_bytes_total", route, "", value);
+    break;
+  case FAMILY_BYTES_OUT:
+    snprintf(value, sizeof(value), "%lu", totals->bytes_out);
+    status |=
+        write_sample(out, "alpha_response_bytes_total", route, "", value);
+    break;
+  case FAMILY_DURATION: {
+    // Fine buckets are folded into the coarser Prometheus ones by their
+    // upper bound, so a bucket never counts latencies above its `le`
+    unsigned long cumulative = 0;
+    usize bucket = 0;
+    for (usize i = 0; i < LATENCY_BOUNDS_COUNT; ++i) {
+      while (bucket < METRICS_BUCKETS &&
+             latency_bucket_max(bucket) < LATENCY_BOUNDS[i]) {
+        cumulative += totals->buckets[bucket++];
+      }
+      snprintf(label, sizeof(label), ",le=\"%g\"", LATENCY_BOUNDS[i] / 1e6);
+      snprintf(value, sizeof(value), "%lu", cumulative);
+      status |= write_sample(out, "alpha_request_duration_seconds_bucket",
+                             route, label, value);
+    }
+    snprintf(value, sizeof(value), "%lu", count);
+    status |= write_sample(out, "alpha_request_duration_seconds_bucket", route,
+                           ",le=\"+Inf\"", value);
+    status |= write_sample(out, "alpha_request_duration_seconds_count", route,
+                           "", value);
+    snprintf(value, sizeof(value), "%g", totals->duration_us / 1e6);
+    status |= write_sample(out, "alpha_request_duration_seconds_sum", route,
+                           "", value);
+    break;
+  }
+  case FAMILY_QUANTILES:
+    for (usize i = 0; i < QUANTILES_COUNT && count; ++i) {
+      unsigned long rank = QUANTILES[i] * count;
+      unsigned long seen = 0;
+      usize j = 0;
+      while (j < METRICS_BUCKETS - 1 &&
+             (seen += totals->buckets[j]) <= rank) {
+        j++;
+      }
+      snprintf(label, sizeof(label), ",quantile=\"%g\"", QUANTILES[i]);
+      snprintf(value, sizeof(value), "%g", latency_bucket_max(j) / 1e6);
+      status |= write_sample(out, "alpha_request_duration_quantile_seconds",
+                             route, label, value);
+    }
+    break;
+  case FAMILIES_COUNT:
+    break;
+  }
+  return status ? -1 : 0;
+}
+
+// `name{method="GET",route="/users/:id"<label>} value`, with the route
+// escaped as Prometheus label values need
+int write_sample(Buffer *out, const char *name, const Route *route,
+                 const char *label, const char *value) {
+  const char *method = route ? METHOD_NAMES[route->_method] : "";
+  const char *path = route ? route->_path : "";
+  if (buffer_appendf(out, "%s{method=\"%s\",route=\"", name, method) == -1) {
+    return -1;
+  }
+  for (const char *c = path; *c; ++c) {
+    if ((*c == '"' || *c == '\\') && buffer_append(out, "\\", 1) == -1) {
+      return -1;
+    }
+    if (buffer_append(out, c, 1) == -1) {
+      return -1;
+    }
+  }
+  return buffer_appendf(out, "\"%s} %s\n", label, value);
+}
@@ -0,0 +1,61 @@
+#include <string.h>
+#include <strings.h>
+
+#include "../include/alpha/common.h"
+#include "../include/alpha/mime.h"
+
+typedef struct {
+  const char *extension;
+  const char *type;
+} MimeType;
+
+const MimeType MIME_TYPES[] = {
+    {"html", "text/html; charset=utf-8"},
+    {"htm", "text/html; charset=utf-8"},
+    {"css", "text/css; charset=utf-8"},
+    {"js", "text/javascript; charset=utf-8"},
+    {"mjs", "text/javascript; charset=utf-8"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"txt", "text/plain; charset=utf-8"},
+    {"csv", "text/csv; charset=utf-8"},
+    {"xml", "application/xml"},
+    {"svg", "image/svg+xml"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"avif", "image/avif"},
+    {"ico", "image/x-icon"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"otf", "font/otf"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"},
+    {"zip", "application/zip"},
+    {"gz", "application/gzip"},
+    {"mp4", "video/mp4"},
+    {"webm", "video/webm"},
+    {"mp3", "audio/mpeg"},
+    {"ogg", "audio/ogg"},
+    {"wav", "audio/wav"},
+};
+
+#define MIME_TYPES_LEN (sizeof(MIME_TYPES) / sizeof(MimeType))
+
+// Content type for `path` going by its extension, MIME_DEFAULT if unknown
+const char *mime_type(const char *path) {
+  const char *dot = strrchr(path, '.');
+  if (!dot || strchr(dot, '/')) {
+    return MIME_DEFAULT;
+  }
+  const char *extension = dot + 1;
+  for (usize i = 0; i < MIME_TYPES_LEN; ++i) {
+    if (strcasecmp(MIME_TYPES[i].extension, extension) == 0) {
+      return MIME_TYPES[i].type;
+    }
+  }
+  return MIME_DEFAULT;
+}
@@ -0,0 +1,211 @@
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../include/alpha/parser.h"
+
+// Helpers
+const char *parser_find_ctl(const char *ptr, const char *end);
+void parser_rebase(HttpParser *parser, const char *base);
+int parser_request_line(HttpParser *parser, const char *line,
+                        const char *line_end);
+int parser_header_line(HttpParser *parser, const char *line,
+                       const char *line_end);
+
+void http_parser_reset(HttpParser *parser) {
+  parser->state = PARSER_REQUEST_LINE;
+  parser->base = NULL;
+  parser->offset = 0;
+  parser->scanned = 0;
+  parser->method = (Slice){0};
+  parser->path = (Slice){0};
+  parser->minor_version = 0;
+  headers_reset(&parser->headers);
+}
+
+// Parses as much of the request head starting at `data` as is available.
+// Lines already parsed by a previous call are not looked at again, so feeding
+// the same request one read at a time stays linear.
+ParseResult http_parser_execute(HttpParser *parser, const char *data,
+                                usize len) {
+  parser_rebase(parser, data);
+  const char *end = data + len;
+  if (len > REQUEST_HEAD_MAX) {
+    end = data + REQUEST_HEAD_MAX;
+  }
+
+  while (parser->state != PARSER_DONE) {
+    const char *line = data + parser->offset;
+    const char *line_end = parser_find_ctl(data + parser->scanned, end);
+    if (line_end == end) {
+      parser->scanned = line_end - data;
+      return len > REQUEST_HEAD_MAX ? PARSE_TOO_LARGE : PARSE_INCOMPLETE;
+    }
+
+    usize eol_len = 1;
+    if (*line_end == '\r') {
+      if (line_end + 1 == end) {
+        parser->scanned = line_end - data;
+        return len > REQUEST_HEAD_MAX ? PARSE_TOO_LARGE : PARSE_INCOMPLETE;
+      }
+      if (line_end[1] != '\n') {
+        return PARSE_ERROR;
+      }
+      eol_len = 2;
+    } else if (*line_end != '\n') {
+      return PARSE_ERROR;
+    }
+
+    int status = parser->state == PARSER_REQUEST_LINE
+                     ? parser_request_line(parser, line, line_end)
+                     : parser_header_line(parser, line, line_end);
+    if (status != PARSE_DONE) {
+      return status;
+    }
+    parser->offset = line_end + eol_len - data;
+    parser->scanned = parser->offset;
+  }
+  return PARSE_DONE;
+}
+
+// Returns the first control character in [ptr, end) other than HTAB, which
+// is where a line ends (CR or LF) or turns out to be invalid
+const char *parser_find_ctl(const char *ptr, const char *end) {
+#if defined(__AVX2__)
+  const __m256i space = _mm256_set1_epi8(0x20);
+  const __m256i minus_one = _mm256_set1_epi8(-1);
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i del = _mm256_set1_epi8(0x7f);
+  while (end - ptr >= 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)ptr);
+    // Signed compares, so bytes >= 0x80 are negative and left alone
+    __m256i ctl = _mm256_and_si256(_mm256_cmpgt_epi8(space, chunk),
+                                   _mm256_cmpgt_epi8(chunk, minus_one));
+    ctl = _mm256_andnot_si256(_mm256_cmpeq_epi8(chunk, tab), ctl);
+    ctl = _mm256_or_si256(ctl, _mm256_cmpeq_epi8(chunk, del));
+    unsigned int mask = _mm256_movemask_epi8(ctl);
+    if (mask) {
+      return ptr + __builtin_ctz(mask);
+    }
+    ptr += 32;
+  }
+#elif defined(__SSE4_2__)
+  // 0x00-0x08, 0x0a-0x1f and 0x7f, the same ranges picohttpparser scans for
+  const __m128i ranges = _mm_setr_epi8(0x00, 0x08, 0x0a, 0x1f, 0x7f, 0x7f, 0,
+                                       0, 0, 0, 0, 0, 0, 0, 0, 0);
+  while (end - ptr >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)ptr);
+    int index = _mm_cmpestri(ranges, 6, chunk, 16,
+                             _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES |
+                                 _SIDD_LEAST_SIGNIFICANT);
+    if (index != 16) {
+      return ptr + index;
+    }
+    ptr += 16;
+  }
+#elif defined(__SSE2__)
+  const __m128i space = _mm_set1_epi8(0x20);
+  const __m128i minus_one = _mm_set1_epi8(-1);
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i del = _mm_set1_epi8(0x7f);
+  while (end - ptr >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)ptr);
+    __m128i ctl = _mm_and_si128(_mm_cmpgt_epi8(space, chunk),
+                                _mm_cmpgt_epi8(chunk, minus_one));
+    ctl = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, tab), ctl);
+    ctl = _mm_or_si128(ctl, _mm_cmpeq_epi8(chunk, del));
+    unsigned int mask = _mm_movemask_epi8(ctl);
+    if (mask) {
+      return ptr + __builtin_ctz(mask);
+    }
+    ptr += 16;
+  }
+#endif
+  for (; ptr < end; ++ptr) {
+    unsigned char c = *ptr;
+    if ((c < 0x20 && c != '\t') || c == 0x7f) {
+      return ptr;
+    }
+  }
+  return end;
+}
+
+void parser_rebase(HttpParser *parser, const char *base) {
+  if (parser->base == base) {
+    return;
+  }
+  if (parser->base) {
+    intptr_t delta = (intptr_t)base - (intptr_t)parser->base;
+    parser->method.ptr = (const char *)((intptr_t)parser->method.ptr + delta);
+    parser->path.ptr = (const char *)((intptr_t)parser->path.ptr + delta);
+    for (usize i = 0; i < parser->headers.count; ++i) {
+      HttpHeader *header = &parser->headers.entries[i];
+      header->name.ptr = (const char *)((intptr_t)header->name.ptr + delta);
+      header->value.ptr = (const char *)((intptr_t)header->value.ptr + delta);
+    }
+  }
+  parser->base = base;
+}
+
+int parser_request_line(HttpParser *parser, const char *line,
+                        const char *line_end) {
+  // Stray empty lines before a request are tolerated (RFC 9112 2.2)
+  if (line == line_end) {
+    return PARSE_DONE;
+  }
+  const char *method_end = memchr(line, ' ', line_end - line);
+  if (!method_end || method_end == line) {
+    return PARSE_ERROR;
+  }
+  const char *path = method_end + 1;
+  const char *path_end = memchr(path, ' ', line_end - path);
+  if (!path_end || path_end == path) {
+    return PARSE_ERROR;
+  }
+  const char *version = path_end + 1;
+  if (line_end - version != 8 || memcmp(version, "HTTP/1.", 7) != 0 ||
+      (version[7] != '0' && version[7] != '1')) {
+    return PARSE_ERROR;
+  }
+  parser->method = (Slice){line, method_end - line};
+  parser->path = (Slice){path, path_end - path};
+  parser->minor_version = version[7] - '0';
+  parser->state = PARSER_HEADERS;
+  return PARSE_DONE;
+}
+
+int parser_header_line(HttpParser *parser, const char *line,
+                       const char *line_end) {
+  if (line == line_end) {
+    parser->state = PARSER_DONE;
+    return PARSE_DONE;
+  }
+  // Obsolete line folding isn't supported
+  if (*line == ' ' || *line == '\t') {
+    return PARSE_ERROR;
+  }
+  const char *colon = memchr(line, ':', line_end - line);
+  if (!colon || colon == line || colon[-1] == ' ' || colon[-1] == '\t') {
+    return PARSE_ERROR;
+  }
+  const char *value = colon + 1;
+  const char *value_end = line_end;
+  while (value < value_end && (*value == ' ' || *value == '\t')) {
+    value++;
+  }
+  while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) {
+    value_end--;
+  }
+  if (headers_add(&parser->headers, (Slice){line, colon - line},
+                  (Slice){value, value_end - value}) == -1) {
+    return PARSE_TOO_LARGE;
+  }
+  return PARSE_DONE;
+}
@@ -0,0 +1,134 @@
+#include <limits.h>
+#include <stddef.h>
+#include <strings.h>
+
+#include "../include/alpha/range.h"
+
+// Helpers
+const char *range_parse_number(const char *ptr, const char *end, usize *out);
+void range_coalesce(ByteRanges *ranges);
+
+// Reads the digits at `ptr` into `out`. Returns where they end, or NULL if
+// there are none or they overflow.
+const char *range_parse_number(const char *ptr, const char *end, usize *out) {
+  const char *start = ptr;
+  usize value = 0;
+  while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+    usize digit = *ptr - '0';
+    if (value > (ULONG_MAX - digit) / 10) {
+      return NULL;
+    }
+    value = value * 10 + digit;
+    ptr++;
+  }
+  *out = value;
+  return ptr == start ? NULL : ptr;
+}
+
+// Sorts the ranges and merges those that overlap or touch, so repeating
+// ranges can't make the response larger than the file (RFC 9110 14.2)
+void range_coalesce(ByteRanges *ranges) {
+  for (usize i = 1; i < ranges->count; ++i) {
+    ByteRange range = ranges->entries[i];
+    usize j = i;
+    while (j > 0 && ranges->entries[j - 1].start > range.start) {
+      ranges->entries[j] = ranges->entries[j - 1];
+      j--;
+    }
+    ranges->entries[j] = range;
+  }
+  usize merged = 0;
+  for (usize i = 1; i < ranges->count; ++i) {
+    ByteRange *last = &ranges->entries[merged];
+    ByteRange *range = &ranges->entries[i];
+    usize last_end = last->start + last->len;
+    if (range->start <= last_end) {
+      usize range_end = range->start + range->len;
+      if (range_end > last_end) {
+        last->len = range_end - last->start;
+      }
+    } else {
+      ranges->entries[++merged] = *range;
+    }
+  }
+  if (ranges->count) {
+    ranges->count = merged + 1;
+  }
+}
+
+// Resolves a `bytes=` Range header against a file of `size` bytes. Ranges
+// starting past the end are dropped, the rest are clamped to the file and
+// coalesced. A malformed header is ignored as a whole, as RFC 9110 asks.
+RangeResult parse_ranges(Slice range, usize size, ByteRanges *ranges) {
+  ranges->count = 0;
+  if (range.len < 6 || strncasecmp(range.ptr, "bytes=", 6) != 0) {
+    return RANGE_IGNORED;
+  }
+  const char *ptr = range.ptr + 6;
+  const char *end = range.ptr + range.len;
+  usize specs = 0;
+  while (ptr < end) {
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == ',')) {
+      ptr++;
+    }
+    if (ptr == end) {
+      break;
+    }
+    if (++specs > RANGES_MAX) {
+      return RANGE_IGNORED;
+    }
+
+    usize first = 0;
+    usize last = 0;
+    int has_first = 0;
+    int has_last = 0;
+    if (*ptr != '-') {
+      if (!(ptr = range_parse_number(ptr, end, &first))) {
+        return RANGE_IGNORED;
+      }
+      has_first = 1;
+    }
+    if (ptr == end || *ptr != '-') {
+      return RANGE_IGNORED;
+    }
+    ptr++;
+    if (ptr < end && *ptr >= '0' && *ptr <= '9') {
+      if (!(ptr = range_parse_number(ptr, end, &last))) {
+        return RANGE_IGNORED;
+      }
+      has_last = 1;
+    }
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t')) {
+      ptr++;
+    }
+    if ((ptr < end && *ptr != ',') || (!has_first && !has_last) ||
+        (has_first && has_last && last < first)) {
+      return RANGE_IGNORED;
+    }
+
+    ByteRange resolved;
+    if (!has_first) {
+      // Suffix range: the last `last` bytes
+      if (last == 0 || size == 0) {
+        continue;
+      }
+      resolved.start = last < size ? size - last : 0;
+      resolved.len = size - resolved.start;
+    } else {
+      if (first >= size) {
+        continue;
+      }
+      if (!has_last || last >= size) {
+        last = size - 1;
+      }
+      resolved.start = first;
+      resolved.len = last - first + 1;
+    }
+    ranges->entries[ranges->count++] = resolved;
+  }
+  if (specs == 0) {
+    return RANGE_IGNORED;
+  }
+  range_coalesce(ranges);
+  return ranges->count ? RANGE_SATISFIABLE : RANGE_UNSATISFIABLE;
+}
@@ -1,115 +1,533 @@
 #include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <unistd.h>
 
 #include "../exteral/log4c/include/log4c.h"
 
+#include "../include/alpha/connection.h"
 #include "../include/alpha/request.h"
-#include "../include/alpha/request_dto.h"
 #include "../include/alpha/response.h"
-
-#define STATUS_CODE(code)                                                      \
-  ((code) == 200   ? "\033[0;32m200\033[0m"                                    \
-   : (code) == 404 ? "\033[0;33m404\033[0m"                                    \
-   : (code) == 500 ? "\033[0;33m500\033[0m"                                    \
-                   : "Unknown Status Code")
+#include "../include/alpha/router.h"
 
 // Helpers
-char *fread_line(FILE *fp);
-char *fchop_while(FILE *fp, char stop_char);
-HttpMethod fextract_request_method(FILE *fp);
-
-void handle_request(RequestDTO *payload);
-void handle_request_get(RequestDTO *payload, FILE *client_fp, char *path);
-
-// Called on each accepted connetion
-void *RequestHandler(void *arg) {
-  RequestDTO *payload = (RequestDTO *)arg;
-  handle_request(payload);
-  return NULL;
-}
-
-void handle_request(RequestDTO *payload) {
-  FILE *client_fp = fdopen(payload->client.file_descriptor, "r");
-  if (!client_fp) {
-    Log(stderr, ERROR, "Couldn't open client fd: %s\n", strerror(errno));
-    goto difer;
-  }
-  HttpMethod method = fextract_request_method(client_fp);
-  if (method == -1) {
-    send_string_response(&payload->client.file_descriptor, 400,
-                         "Unexpected Http Method", "Unexpected Http Method");
-    goto difer;
-  }
-  char *path = fchop_while(client_fp, ' ');
-  switch (method) {
-  case GET:
-    handle_request_get(payload, client_fp, path);
-    break;
-  case POST:
-    send_string_response(&payload->client.file_descriptor, 400,
-                         "POST requests are not supported yet",
-                         "POST requests are not supported yet");
-    break;
+HttpMethod extract_request_method(Slice method);
+int header_has_token(Slice value, const char *token);
+int header_equals(Slice value, const char *token);
+int request_start(Connection *conn);
+int request_framing(Connection *conn, int *chunked, usize *body_len);
+int request_read_body(Connection *conn);
+const Route *request_route(Connection *conn, HttpMethod *method);
+void request_dispatch(Connection *conn, Slice body);
+void request_fail(Connection *conn, StatusCode status, char *message);
+void request_shed(Connection *conn);
+void request_finished(Connection *conn, const Route *route, StatusCode status,
+                     usize out_at, usize segments_at);
+void respond_with_metrics(Connection *conn);
+
+// Handles the request found at `conn->in_offset`, if it is complete, and
+// moves the offset past it so pipelined requests are picked up in order.
+// Returns 1 when a response was queued and 0 when more input is needed.
+int handle_request(Connection *conn) {
+  HttpParser *parser = &conn->parser;
+  ParseResult result =
+      http_parser_execute(parser, conn->in.data + conn->in_offset,
+                          conn->in.len - conn->in_offset);
+  if (result == PARSE_INCOMPLETE) {
+    return 0;
+  }
+  if (result != PARSE_DONE) {
+    conn->keep_alive = 0;
+    if (result == PARSE_TOO_LARGE) {
+      send_string_response(conn, 431, "Request header too large",
+                           "Request header too large");
+    } else {
+      send_string_response(conn, 400, "Malformed request",
+                           "Malformed request");
+    }
+    conn->close_after_write = 1;
+    return 1;
+  }
+  if (!conn->reading_body && request_start(conn) == -1) {
+    return 1;
   }
-  free(path);
-difer:
-  fclose(client_fp);
-  close(payload->client.file_descriptor);
-  free(payload);
+  return request_read_body(conn);
 }
 
-Route *match_route(Router *router, char *path, HttpMethod method) {
-  for (usize i = 0; i < router->_routesCount; ++i) {
-    Route *r = &router->_routes[i];
-    if (strcmp(path, r->_path) == 0 && method == r->_method) {
-      return r;
+// Settles persistence and body framing once the head is complete. Returns
+// -1 after queueing a response that closes the connection.
+int request_start(Connection *conn) {
+  HttpParser *parser = &conn->parser;
+  clock_gettime(CLOCK_MONOTONIC, &conn->request_started);
+  // The space that ended the path is overwritten in place so handlers get a
+  // C string without a copy
+  char *path = (char *)parser->path.ptr;
+  path[parser->path.len] = '\0';
+
+  Admission *admission = conn->app->_admission;
+  if (admission_expired(admission, &conn->received, &conn->request_started) ||
+      admission_request_acquire(admission) == -1) {
+    request_shed(conn);
+    return -1;
+  }
+  conn->admitted = 1;
+
+  // HTTP/1.1 connections persist unless told otherwise, HTTP/1.0 ones only
+  // when asked to
+  int http10 = parser->minor_version == 0;
+  int keep_alive = !http10;
+  const HttpHeader *connection =
+      headers_find(&parser->headers, HEADER_CONNECTION);
+  if (connection) {
+    if (header_has_token(connection->value, "close")) {
+      keep_alive = 0;
+    } else if (header_has_token(connection->value, "keep-alive")) {
+      keep_alive = 1;
     }
   }
-  return NULL;
+  usize max_requests = conn->app->_config.max_requests_per_connection;
+  conn->requests_count += 1;
+  if (max_requests && conn->requests_count >= max_requests) {
+    keep_alive = 0;
+  }
+  conn->keep_alive = keep_alive;
+  conn->http10 = http10;
+
+  int chunked;
+  usize body_len;
+  if (request_framing(conn, &chunked, &body_len) == -1) {
+    return -1;
+  }
+  int has_body = chunked || body_len;
+  body_reader_init(&conn->body, chunked, body_len);
+
+  HttpMethod method;
+  const Route *route = request_route(conn, &method);
+  if (has_body) {
+    // Nobody wants the body, answering right away beats reading it
+    if (!route && method == (HttpMethod)-1) {
+      request_fail(conn, NOT_IMPLEMENTED, "Method not implemented");
+      return -1;
+    }
+    if (!route) {
+      request_fail(conn, NOT_FOUND, "404 path not found");
+      return -1;
+    }
+    if (!route->_onBody && body_len > conn->app->_config.max_body_bytes) {
+      request_fail(conn, PAYLOAD_TOO_LARGE, "Request body too large");
+      return -1;
+    }
+    const HttpHeader *expect = headers_find(&parser->headers, HEADER_EXPECT);
+    if (expect && !http10 && header_equals(expect->value, "100-continue")) {
+      buffer_append(&conn->out, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+    }
+  }
+  conn->reading_body = 1;
+  conn->context = NULL;
+  return 0;
 }
 
-void handle_request_get(RequestDTO *payload, FILE *client_fp, char *path) {
-  const Route *route = match_route(&payload->app->_router, path, GET);
+// Works out how the body is framed from every Transfer-Encoding and
+// Content-Length header, since a peer in front of us may have picked another
+// one than the first. Anything two parties could read differently is refused.
+int request_framing(Connection *conn, int *chunked, usize *body_len) {
+  const HttpHeaders *headers = &conn->parser.headers;
+  int has_length = 0;
+  int has_encoding = 0;
+  int chunked_count = 0;
+  int other_count = 0;
+  // Whether the last coding seen, the one framing the body, is chunked
+  int chunked_last = 0;
+  *body_len = 0;
+  for (usize i = 0; i < headers->count; ++i) {
+    const HttpHeader *header = &headers->entries[i];
+    if (header->id == HEADER_CONTENT_LENGTH) {
+      usize len;
+      if (body_parse_length(header->value, &len) == -1 ||
+          (has_length && len != *body_len)) {
+        request_fail(conn, BAD_REQUEST, "Malformed request");
+        return -1;
+      }
+      has_length = 1;
+      *body_len = len;
+    } else if (header->id == HEADER_TRANSFER_ENCODING) {
+      has_encoding = 1;
+      const char *ptr = header->value.ptr;
+      const char *end = ptr + header->value.len;
+      while (ptr < end) {
+        while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == ',')) {
+          ptr++;
+        }
+        const char *item = ptr;
+        while (ptr < end && *ptr != ',') {
+          ptr++;
+        }
+        const char *item_end = ptr;
+        while (item_end > item &&
+               (item_end[-1] == ' ' || item_end[-1] == '\t')) {
+          item_end--;
+        }
+        if (item == item_end) {
+          continue;
+        }
+        chunked_last =
+            header_equals((Slice){item, item_end - item}, "chunked");
+        chunked_count += chunked_last;
+        other_count += !chunked_last;
+      }
+    }
+  }
+  *chunked = has_encoding;
+  if (!has_encoding) {
+    return 0;
+  }
+  // Without chunked last the body would run until the connection closes
+  if (has_length || !chunked_last || chunked_count > 1) {
+    request_fail(conn, BAD_REQUEST, "Malformed request");
+    return -1;
+  }
+  // Only chunked is understood as a transfer coding
+  if (other_count) {
+    request_fail(conn, NOT_IMPLEMENTED, "Unsupported transfer encoding");
+    return -1;
+  }
+  return 0;
+}
+
+// Reads as much of the body as has arrived and answers the request once it
+// is complete. Streamed routes get each piece as it comes and the bytes are
+// dropped right away, so an upload never piles up in `in`.
+int request_read_body(Connection *conn) {
+  HttpParser *parser = &conn->parser;
+  char *body = conn->in.data + conn->in_offset + parser->offset;
+  usize available = conn->in.len - conn->in_offset - parser->offset;
+  BodyResult result = body_reader_execute(&conn->body, body, available);
+  if (result == BODY_ERROR) {
+    request_fail(conn, BAD_REQUEST, "Malformed request body");
+    return 1;
+  }
+
+  HttpMethod method;
+  const Route *route = request_route(conn, &method);
+  if (route && route->_onBody) {
+    if (conn->body.decoded) {
+      Request request = {
+          .method = method,
+          .path = parser->path.ptr,
+          .headers = &parser->headers,
+          .params = &conn->params,
+          .arena = &conn->arena,
+          .context = conn->context,
+          ._max_body_bytes = conn->app->_config.max_body_bytes,
+      };
+      int status =
+          route->_onBody(&request, (Slice){body, conn->body.decoded});
+      conn->context = request.context;
+      if (status == -1) {
+        request_fail(conn, BAD_REQUEST, "Request body rejected");
+        return 1;
+      }
+    }
+    memmove(body, body + conn->body.consumed,
+            available - conn->body.consumed);
+    conn->in.len -= conn->body.consumed;
+    body_reader_discard(&conn->body);
+  } else {
+    // Only the decoded bytes count against the limit, so the chunk framing
+    // behind them is dropped rather than left to pile up in `in`
+    usize framing = conn->body.consumed - conn->body.decoded;
+    if (framing) {
+      memmove(body + conn->body.decoded, body + conn->body.consumed,
+              available - conn->body.consumed);
+      conn->in.len -= framing;
+      body_reader_compact(&conn->body);
+    }
+    if (conn->body.total > conn->app->_config.max_body_bytes) {
+      request_fail(conn, PAYLOAD_TOO_LARGE, "Request body too large");
+      return 1;
+    }
+  }
+  if (result == BODY_INCOMPLETE) {
+    return 0;
+  }
+
+  usize request_len = parser->offset + conn->body.consumed;
+  request_dispatch(conn, (Slice){body, conn->body.decoded});
+  conn->in_offset += request_len;
+  conn->close_after_write = !conn->keep_alive;
+  conn->reading_body = 0;
+  conn->routed = 0;
+  conn->context = NULL;
+  http_parser_reset(parser);
+  // A streamed response may still use it, it's reset once that ends
+  if (!conn->stream.producer) {
+    arena_reset(&conn->arena);
+  }
+  return 1;
+}
+
+// Matches the request once, later calls only rebase the captured params
+// when `in` was grown or compacted since
+const Route *request_route(Connection *conn, HttpMethod *method) {
+  const char *path = conn->parser.path.ptr;
+  if (!conn->routed) {
+    conn->routed = 1;
+    conn->route = NULL;
+    conn->params.count = 0;
+    conn->method = extract_request_method(conn->parser.method);
+    if (conn->method != (HttpMethod)-1) {
+      conn->route = match_route(&conn->app->_router, (char *)path,
+                                conn->method, &conn->params);
+    }
+  } else if (conn->route_path != path) {
+    intptr_t delta = (intptr_t)path - (intptr_t)conn->route_path;
+    for (usize i = 0; i < conn->params.count; ++i) {
+      Slice *value = &conn->params.entries[i].value;
+      value->ptr = (const char *)((intptr_t)value->ptr + delta);
+    }
+  }
+  conn->route_path = path;
+  *method = conn->method;
+  return conn->route;
+}
+
+void request_dispatch(Connection *conn, Slice body) {
+  HttpParser *parser = &conn->parser;
+  const char *path = parser->path.ptr;
+  HttpMethod method;
+  const Route *route = request_route(conn, &method);
+  usize out_at = conn->out.len;
+  usize segments_at = conn->segments_count;
+  const char *metrics_path = conn->app->_config.metrics_path;
+  StatusCode status;
   if (!route) {
-    send_string_response(&payload->client.file_descriptor, 400,
-                         "404 path not found", "404 path not found");
-    Log(stdout, INFO, "GET %s %s", path, STATUS_CODE(NOT_FOUND));
+    // Routes registered by the application win over the metrics path
+    if (method == GET && conn->app->_metrics &&
+        strncmp(path, metrics_path, strcspn(path, "?")) == 0 &&
+        metrics_path[strcspn(path, "?")] == '\0') {
+      status = OK;
+      respond_with_metrics(conn);
+    } else if (method == (HttpMethod)-1) {
+      status = NOT_IMPLEMENTED;
+      send_string_response(conn, status, "Method not implemented",
+                           "Method not implemented");
+    } else {
+      status = NOT_FOUND;
+      send_string_response(conn, status, "404 path not found",
+                           "404 path not found");
+    }
   } else {
     const Request request = {
-        .method = GET,
+        .method = method,
         .path = path,
+        .headers = &parser->headers,
+        .params = &conn->params,
+        .body = route->_onBody ? (Slice){0} : body,
+        .arena = &conn->arena,
+        .context = conn->context,
+        ._max_body_bytes = conn->app->_config.max_body_bytes,
     };
     const Response response = route->_handler(request);
-    response_handler(&payload->client.file_descriptor, response);
-    Log(stdout, INFO, "GET %s %s", path, STATUS_CODE(response.statusCode));
+    response_handler(conn, response);
+    status = response.statusCode;
+  }
+  request_finished(conn, route, status, out_at, segments_at);
+}
+
+// Accounts for a request whose response was queued since `out` held
+// `out_at` bytes and `segments_at` segments
+void request_finished(Connection *conn, const Route *route, StatusCode status,
+                      usize out_at, usize segments_at) {
+  HttpParser *parser = &conn->parser;
+  if (conn->admitted) {
+    admission_request_release(conn->app->_admission);
+    conn->admitted = 0;
+  }
+  access_log_record(conn->app->_accessLog, parser->method, parser->path.ptr,
+                    status, &conn->request_started);
+  if (!conn->app->_metrics) {
+    return;
   }
+  usize bytes_out = conn->out.len - out_at;
+  for (usize i = segments_at; i < conn->segments_count; ++i) {
+    bytes_out += conn->segments[i].remaining;
+  }
+  metrics_record(conn->app->_metrics, &conn->app->_router, route, status,
+                 parser->offset + conn->body.total, bytes_out,
+                 &conn->request_started);
 }
 
-HttpMethod fextract_request_method(FILE *client_fp) {
-  char *provided_method_buf = fchop_while(client_fp, ' ');
+void respond_with_metrics(Connection *conn) {
+  conn->scratch.len = 0;
+  if (metrics_write(conn->app->_metrics, &conn->app->_router,
+                    &conn->scratch) == -1) {
+    send_string_response(conn, INTERNAL_ERROR, "Couldn't collect metrics",
+                         "Couldn't collect metrics");
+    return;
+  }
+  http_write_head(&conn->out, OK, "text/plain; version=0.0.4",
+                  conn->scratch.len, "", connection_header(conn));
+  buffer_append(&conn->out, conn->scratch.data, conn->scratch.len);
+}
+
+// Answers with an error that leaves the rest of the input unframed, so the
+// connection closes after it
+void request_fail(Connection *conn, StatusCode status, char *message) {
+  usize out_at = conn->out.len;
+  usize segments_at = conn->segments_count;
   HttpMethod method;
-  if (strcmp("GET", provided_method_buf) == 0) {
-    method = GET;
-  } else if (strcmp("POST", provided_method_buf)) {
-    method = POST;
-  } else {
-    method = -1;
+  const Route *route = request_route(conn, &method);
+  conn->keep_alive = 0;
+  send_string_response(conn, status, message, message);
+  request_finished(conn, route, status, out_at, segments_at);
+  conn->close_after_write = 1;
+  conn->reading_body = 0;
+}
+
+// Turns the request away unread because the server is overloaded
+void request_shed(Connection *conn) {
+  usize out_at = conn->out.len;
+  usize segments_at = conn->segments_count;
+  HttpMethod method;
+  const Route *route = request_route(conn, &method);
+  conn->keep_alive = 0;
+  admission_refuse(conn->app->_admission, &conn->out);
+  request_finished(conn, route, SERVICE_UNAVAILABLE, out_at, segments_at);
+  conn->close_after_write = 1;
+  conn->reading_body = 0;
+}
+
+Slice Request_Header(const Request *req, HeaderId id) {
+  const HttpHeader *header = headers_find(req->headers, id);
+  return header ? header->value : (Slice){0};
+}
+
+Slice Request_GetHeader(const Request *req, const char *name) {
+  const HttpHeader *header = headers_find_name(req->headers, name);
+  return header ? header->value : (Slice){0};
+}
+
+usize Request_HeadersCount(const Request *req) { return req->headers->count; }
+
+HttpHeader Request_HeaderAt(const Request *req, usize index) {
+  return req->headers->entries[index];
+}
+
+Slice Request_GetParam(const Request *req, const char *name) {
+  usize name_len = strlen(name);
+  for (usize i = 0; i < req->params->count; ++i) {
+    const RouteParam *param = &req->params->entries[i];
+    if (param->name.len == name_len &&
+        memcmp(param->name.ptr, name, name_len) == 0) {
+      return param->value;
+    }
+  }
+  return (Slice){0};
+}
+
+void *Request_Alloc(const Request *req, usize size) {
+  return arena_alloc(req->arena, size);
+}
+
+char *Request_Sprintf(const Request *req, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(NULL, 0, fmt, args);
+  va_end(args);
+  char *str = len < 0 ? NULL : arena_alloc(req->arena, len + 1);
+  if (!str) {
+    return NULL;
   }
-  free(provided_method_buf);
-  return method;
+  va_start(args, fmt);
+  vsnprintf(str, len + 1, fmt, args);
+  va_end(args);
+  return str;
 }
 
-char *fchop_while(FILE *fp, char stop_char) {
-  int c;
-  char *buf = NULL;
-  usize buf_len = 0;
-  FILE *buf_stream = open_memstream(&buf, &buf_len);
-  while ((c = fgetc(fp)) != EOF) {
-    if (c == stop_char)
-      break;
-    fputc(c, buf_stream);
+const JsonNode *Request_Json(const Request *req, JsonError *error) {
+  // The parser's index takes up to 4 bytes per input byte while it runs
+  if (req->body.len > req->_max_body_bytes) {
+    if (error) {
+      *error = (JsonError){.message = "document too large", .offset = 0};
+    }
+    return NULL;
+  }
+  return json_parse(req->arena, req->body.ptr, req->body.len, error);
+}
+
+Response Request_JsonErrorResponse(const Request *req,
+                                   const JsonError *error) {
+  char *body = Request_Sprintf(req, "Invalid JSON at byte %lu: %s",
+                               error->offset, error->message);
+  Response response = {
+      .type = RESPONSE_HTML,
+      .statusCode = BAD_REQUEST,
+      .payload.html = {.title = "Bad Request",
+                       .body = body ? body : "Invalid JSON"},
+  };
+  return response;
+}
+
+HttpMethod extract_request_method(Slice method) {
+  switch (method.len) {
+  case 3:
+    if (memcmp("GET", method.ptr, 3) == 0) {
+      return GET;
+    }
+    if (memcmp("PUT", method.ptr, 3) == 0) {
+      return PUT;
+    }
+    break;
+  case 4:
+    if (memcmp("POST", method.ptr, 4) == 0) {
+      return POST;
+    }
+    break;
+  case 5:
+    if (memcmp("PATCH", method.ptr, 5) == 0) {
+      return PATCH;
+    }
+    break;
+  case 6:
+    if (memcmp("DELETE", method.ptr, 6) == 0) {
+      return DELETE;
+    }
+    break;
+  }
+  return -1;
+}
+
+int header_equals(Slice value, const char *token) {
+  usize token_len = strlen(token);
+  return value.len == token_len &&
+         strncasecmp(value.ptr, token, token_len) == 0;
+}
+
+// Looks for `token` in a comma separated header value, ignoring case
+int header_has_token(Slice value, const char *token) {
+  usize token_len = strlen(token);
+  const char *ptr = value.ptr;
+  const char *end = value.ptr + value.len;
+  while (ptr < end) {
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == ',')) {
+      ptr++;
+    }
+    const char *item = ptr;
+    while (ptr < end && *ptr != ',') {
+      ptr++;
+    }
+    const char *item_end = ptr;
+    while (item_end > item && (item_end[-1] == ' ' || item_end[-1] == '\t')) {
+      item_end--;
+    }
+    if ((usize)(item_end - item) == token_len &&
+        strncasecmp(item, token, token_len) == 0) {
+      return 1;
+    }
   }
-  fclose(buf_stream);
-  return buf;
+  return 0;
 }
@@ -1,149 +1,527 @@
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define JACK_IMPLEMENTATION
 #include "../exteral/jack/include/jack.h"
 #include "../exteral/log4c/include/log4c.h"
 
 #include "../include/alpha.h"
+#include "../include/alpha/compress_cache.h"
+#include "../include/alpha/conditional.h"
+#include "../include/alpha/connection.h"
+#include "../include/alpha/encoding.h"
+#include "../include/alpha/json.h"
+#include "../include/alpha/mime.h"
+#include "../include/alpha/range.h"
+#include "../include/alpha/static_cache.h"
 #include "../include/alpha/response.h"
 #include "../include/alpha/templates.h"
 
-char *join_strings(char *lhs, char *rhs) {
-  usize lhs_len = strlen(lhs);
-  usize rhs_len = strlen(rhs);
-  char *buf = malloc(sizeof(char) * (lhs_len + rhs_len + 1));
-  strncpy(buf, lhs, lhs_len);
-  strncpy(buf + lhs_len, rhs, rhs_len);
-  return buf;
-}
+// Length of an HTML page without its title and body
+#define HTML_TEMPLATE_LEN                                                      \
+  (sizeof(HTML_TEMPLATE_HEAD) + sizeof(HTML_TEMPLATE_MID) +                    \
+   sizeof(HTML_TEMPLATE_TAIL) - 3)
+
+void respond_with_file(Connection *conn, Response response,
+                       const char *content_type);
+int respond_with_variant(Connection *conn, Response response,
+                         const char *file_path, const char *content_type,
+                         ContentEncoding encoding);
+int respond_with_opened_file(Connection *conn, Response response,
+                             const char *file_path, const char *content_type,
+                             unsigned encoding);
+void respond_with_file_fd(Connection *conn, Response response,
+                          const char *content_type, unsigned encoding, int fd,
+                          struct stat *file_stat);
+void respond_with_cached_file(Connection *conn, Response response,
+                              CacheEntry *entry);
+void respond_not_modified(Connection *conn, const FileValidators *validators,
+                          const char *content_type);
+int respond_with_ranges(Connection *conn, Response response,
+                        const char *content_type,
+                        const FileValidators *validators, unsigned encoding,
+                        int fd, CacheEntry *entry, usize size);
+void respond_with_byteranges(Connection *conn, const char *content_type,
+                             const FileValidators *validators,
+                             unsigned encoding, int fd, CacheEntry *entry,
+                             usize size, ByteRanges *ranges);
+int queue_file_part(Connection *conn, int fd, CacheEntry *entry,
+                    ByteRange *part);
+int write_html_page(Buffer *out, const char *title, usize title_len,
+                    const char *body, usize body_len);
+const char *dynamic_encoding_headers(Connection *conn);
+int wants_compression(Connection *conn, usize body_len);
+void respond_with_body(Connection *conn, StatusCode status,
+                       const char *content_type, const char *body,
+                       usize body_len);
 
-void response_handler(int *client_fd, Response response) {
+void response_handler(Connection *conn, Response response) {
   switch (response.type) {
   case RESPONSE_HTML:
-    handle_response_with_html(client_fd, response);
+    handle_response_with_html(conn, response);
     break;
   case RESPONSE_JSON:
-    handle_response_with_json(client_fd, response);
+    handle_response_with_json(conn, response);
     break;
   case RESPONSE_HTML_FILE:
-    handle_response_with_html_file(client_fd, response);
+    handle_response_with_html_file(conn, response);
     break;
   case RESPONSE_JSON_FILE:
-    handle_response_with_json_file(client_fd, response);
+    handle_response_with_json_file(conn, response);
+    break;
+  case RESPONSE_FILE:
+    handle_response_with_file(conn, response);
+    break;
+  case RESPONSE_STREAM:
+    handle_response_with_stream(conn, response);
     break;
   }
 }
 
-void send_string_response(int *client_fd, StatusCode status_code, char *title,
-                          char *text) {
+void send_string_response(Connection *conn, StatusCode status_code,
+                          char *title, char *text) {
   Response response = {
       .payload.html.title = title,
       .payload.html.body = text,
       .statusCode = status_code,
       .type = RESPONSE_HTML,
   };
-  handle_response_with_html(client_fd, response);
+  handle_response_with_html(conn, response);
 }
 
-void handle_response_with_html(int *client_fd, Response response) {
+void handle_response_with_html(Connection *conn, Response response) {
   usize page_title_len = strlen(response.payload.html.title);
-  usize body_template_len = strlen(HTML_TEMPLATE);
   usize html_text_len = strlen(response.payload.html.body);
-  dprintf(*client_fd, HTTP_HEADER_TEMPLATE, response.statusCode, "text/html",
-          page_title_len + body_template_len + html_text_len);
-  dprintf(*client_fd, HTML_TEMPLATE, response.payload.html.title,
-          response.payload.html.body);
+  usize body_len = page_title_len + HTML_TEMPLATE_LEN + html_text_len;
+  if (wants_compression(conn, body_len)) {
+    conn->scratch.len = 0;
+    write_html_page(&conn->scratch, response.payload.html.title,
+                    page_title_len, response.payload.html.body,
+                    html_text_len);
+    respond_with_body(conn, response.statusCode, "text/html",
+                      conn->scratch.data, conn->scratch.len);
+    return;
+  }
+  http_write_head(&conn->out, response.statusCode, "text/html", body_len,
+                  dynamic_encoding_headers(conn), connection_header(conn));
+  write_html_page(&conn->out, response.payload.html.title, page_title_len,
+                  response.payload.html.body, html_text_len);
 }
 
-void handle_response_with_json(int *client_fd, Response response) {
-  char *json_string = Json_Stringfy(*response.payload.jsonObject, 0);
-  dprintf(*client_fd, HTTP_HEADER_TEMPLATE, response.statusCode,
-          "application/json", strlen(json_string));
-  dprintf(*client_fd, "%s", json_string);
+// Copies the page around `title` and `body` piece by piece instead of
+// formatting it
+int write_html_page(Buffer *out, const char *title, usize title_len,
+                    const char *body, usize body_len) {
+  if (buffer_reserve(out, HTML_TEMPLATE_LEN + title_len + body_len) == -1) {
+    return -1;
+  }
+  buffer_append(out, HTML_TEMPLATE_HEAD, sizeof(HTML_TEMPLATE_HEAD) - 1);
+  buffer_append(out, title, title_len);
+  buffer_append(out, HTML_TEMPLATE_MID, sizeof(HTML_TEMPLATE_MID) - 1);
+  buffer_append(out, body, body_len);
+  buffer_append(out, HTML_TEMPLATE_TAIL, sizeof(HTML_TEMPLATE_TAIL) - 1);
+  return 0;
 }
 
-void handle_response_with_html_file(int *client_fd, Response response) {
-  FILE *file =
-      fopen(join_strings(STATIC_FOLDER_PATH, response.payload.filePath), "r");
-
-  if (!file) {
-    Log(stderr, ERROR, "Couldn't respond with file %s: %s",
-        response.payload.filePath, strerror(errno));
-    send_string_response(client_fd, 500, "Internal ERROR",
+// Serialized into the connection's scratch buffer, which is reused across
+// responses, and copied behind the head once its length is known
+void handle_response_with_json(Connection *conn, Response response) {
+  conn->scratch.len = 0;
+  if (json_write(&conn->scratch, response.payload.jsonObject) == -1) {
+    Log(stderr, ERROR, "Couldn't serialize JSON response: %s",
+        strerror(errno));
+    send_string_response(conn, 500, "Internal ERROR",
                          "<h1>Internal Server ERROR</h1>");
     return;
   }
+  respond_with_body(conn, response.statusCode, "application/json",
+                    conn->scratch.data, conn->scratch.len);
+}
 
-  fseek(file, 0, SEEK_END);
-  usize file_len = ftell(file);
-  fseek(file, 0, SEEK_SET);
-
-  dprintf(*client_fd, HTTP_HEADER_TEMPLATE, response.statusCode, "text/html",
-          file_len);
+// Vary for HTML and JSON responses, which may be gzipped for other clients
+const char *dynamic_encoding_headers(Connection *conn) {
+  return conn->app->_compressCache ? VARY_ACCEPT_ENCODING : "";
+}
 
-  usize read_len = 0;
-  usize chunck_len = 512;
-  char chunck[chunck_len];
+int wants_compression(Connection *conn, usize body_len) {
+  CompressCache *cache = conn->app->_compressCache;
+  if (!cache || body_len < cache->min_len) {
+    return 0;
+  }
+  const HttpHeader *accept_encoding =
+      headers_find(&conn->parser.headers, HEADER_ACCEPT_ENCODING);
+  return accept_encoding &&
+         (accepted_encodings(accept_encoding->value) & ENCODING_GZIP);
+}
 
-  while (1) {
-    read_len = fread(chunck, sizeof(char), chunck_len, file);
-    if (read_len < 0) {
-      Log(stderr, ERROR, "Couldn't read chunck from specified file %s\n",
-          strerror(errno));
-      send_string_response(client_fd, 500, "Internal ERROR",
-                           "<h1>Internal Server ERROR</h1>");
-      fclose(file);
-      return;
-    }
-    dprintf(*client_fd, "%s", chunck);
-    if (read_len < chunck_len) {
-      break;
+// Queues a rendered body, gzipped from the compress cache when the client
+// takes it so a repeated body is only ever compressed once
+void respond_with_body(Connection *conn, StatusCode status,
+                       const char *content_type, const char *body,
+                       usize body_len) {
+  CompressedEntry *entry =
+      wants_compression(conn, body_len)
+          ? compress_cache_get(conn->app->_compressCache, body, body_len)
+          : NULL;
+  if (entry && entry->data) {
+    http_write_head(&conn->out, status, content_type, entry->len,
+                    encoding_headers(ENCODING_GZIP, content_type),
+                    connection_header(conn));
+    if (connection_queue_memory(conn, entry->data, entry->len,
+                                compress_cache_release, entry) == -1) {
+      Log(stderr, ERROR, "Couldn't queue response: %s", strerror(errno));
+      compress_cache_release(entry);
+      conn->keep_alive = 0;
+      conn->close_after_write = 1;
     }
+    return;
+  }
+  if (entry) {
+    compress_cache_release(entry);
   }
+  http_write_head(&conn->out, status, content_type, body_len,
+                  dynamic_encoding_headers(conn), connection_header(conn));
+  buffer_append(&conn->out, body, body_len);
+}
 
-  fclose(file);
+void handle_response_with_html_file(Connection *conn, Response response) {
+  respond_with_file(conn, response, "text/html");
 }
 
-void handle_response_with_json_file(int *client_fd, Response response) {
-  FILE *file =
-      fopen(join_strings(STATIC_FOLDER_PATH, response.payload.filePath), "r");
+void handle_response_with_json_file(Connection *conn, Response response) {
+  respond_with_file(conn, response, "application/json");
+}
 
-  if (!file) {
+void handle_response_with_file(Connection *conn, Response response) {
+  respond_with_file(conn, response, NULL);
+}
+
+// Small files come from the static cache, anything else goes out with
+// sendfile(2): only the header goes through `out` and the body never gets
+// copied into user space. A `.br` or `.gz` sibling of the file is sent
+// instead when the client accepts it. A NULL `content_type` is inferred from
+// the file extension.
+void respond_with_file(Connection *conn, Response response,
+                       const char *content_type) {
+  char file_path[PATH_MAX];
+  if (snprintf(file_path, sizeof(file_path), "%s%s", STATIC_FOLDER_PATH,
+               response.payload.filePath) >= (int)sizeof(file_path)) {
+    Log(stderr, ERROR, "Couldn't respond with file %s: path too long",
+        response.payload.filePath);
+    send_string_response(conn, 500, "Internal ERROR",
+                         "<h1>Internal Server ERROR</h1>");
+    return;
+  }
+  if (!content_type) {
+    content_type = mime_type(file_path);
+  }
+
+  unsigned accepted = 0;
+  if (is_compressible(content_type)) {
+    const HttpHeader *accept_encoding =
+        headers_find(&conn->parser.headers, HEADER_ACCEPT_ENCODING);
+    accepted = accept_encoding ? accepted_encodings(accept_encoding->value) : 0;
+  }
+  StaticCache *cache = conn->app->_staticCache;
+  int fd = -1;
+  struct stat file_stat;
+  CacheEntry *entry =
+      cache ? static_cache_get(cache, file_path, content_type, 0,
+                               response.statusCode, &fd, &file_stat)
+            : NULL;
+  // Cached files know their siblings, uncached ones find out by opening them
+  unsigned usable =
+      entry ? accepted & atomic_load_explicit(&entry->siblings,
+                                              memory_order_relaxed)
+            : accepted;
+  // Brotli first, it's the smaller of the two
+  if (((usable & ENCODING_BR) &&
+       respond_with_variant(conn, response, file_path, content_type,
+                            ENCODING_BR)) ||
+      ((usable & ENCODING_GZIP) &&
+       respond_with_variant(conn, response, file_path, content_type,
+                            ENCODING_GZIP))) {
+    if (entry) {
+      static_cache_release(entry);
+    } else if (fd != -1) {
+      close(fd);
+    }
+    return;
+  }
+  if (entry) {
+    respond_with_cached_file(conn, response, entry);
+    return;
+  }
+  // The cache already opened a file too large for it, or found there's none
+  if (fd != -1) {
+    respond_with_file_fd(conn, response, content_type, 0, fd, &file_stat);
+    return;
+  }
+  if (cache ||
+      !respond_with_opened_file(conn, response, file_path, content_type, 0)) {
     Log(stderr, ERROR, "Couldn't respond with file %s: %s",
         response.payload.filePath, strerror(errno));
-    send_string_response(client_fd, 500, "Internal ERROR",
+    send_string_response(conn, 500, "Internal ERROR",
                          "<h1>Internal Server ERROR</h1>");
+  }
+}
+
+// Sends the `encoding` sibling of `file_path`. Returns 0 if there is none.
+int respond_with_variant(Connection *conn, Response response,
+                         const char *file_path, const char *content_type,
+                         ContentEncoding encoding) {
+  char variant_path[PATH_MAX];
+  if (snprintf(variant_path, sizeof(variant_path), "%s%s", file_path,
+               encoding_suffix(encoding)) >= (int)sizeof(variant_path)) {
+    return 0;
+  }
+  StaticCache *cache = conn->app->_staticCache;
+  if (!cache) {
+    return respond_with_opened_file(conn, response, variant_path,
+                                    content_type, encoding);
+  }
+  int fd;
+  struct stat file_stat;
+  CacheEntry *entry = static_cache_get(cache, variant_path, content_type,
+                                       encoding, response.statusCode, &fd,
+                                       &file_stat);
+  if (entry) {
+    respond_with_cached_file(conn, response, entry);
+    return 1;
+  }
+  if (fd == -1) {
+    return 0;
+  }
+  respond_with_file_fd(conn, response, content_type, encoding, fd,
+                       &file_stat);
+  return 1;
+}
+
+// Streams `file_path` with sendfile(2), or answers with a 304 off a stat(2)
+// alone when the client's copy is current. Returns 0 with errno set if it
+// isn't a regular file that can be opened.
+int respond_with_opened_file(Connection *conn, Response response,
+                             const char *file_path, const char *content_type,
+                             unsigned encoding) {
+  struct stat file_stat;
+  if (stat(file_path, &file_stat) == -1) {
+    return 0;
+  }
+  if (!S_ISREG(file_stat.st_mode)) {
+    errno = EINVAL;
+    return 0;
+  }
+  FileValidators validators;
+  file_validators(&file_stat, &validators);
+  if (response.statusCode == OK &&
+      is_not_modified(&conn->parser.headers, &validators)) {
+    respond_not_modified(conn, &validators, content_type);
+    return 1;
+  }
+
+  int fd = open(file_path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return 0;
+  }
+  // The file may have been replaced since the stat(2)
+  if (fstat(fd, &file_stat) == -1) {
+    close(fd);
+    return 0;
+  }
+  respond_with_file_fd(conn, response, content_type, encoding, fd,
+                       &file_stat);
+  return 1;
+}
+
+// Streams the open regular file `fd`, described by `file_stat`, with
+// sendfile(2). Takes over `fd`.
+void respond_with_file_fd(Connection *conn, Response response,
+                          const char *content_type, unsigned encoding, int fd,
+                          struct stat *file_stat) {
+  FileValidators validators;
+  file_validators(file_stat, &validators);
+  if (response.statusCode == OK &&
+      is_not_modified(&conn->parser.headers, &validators)) {
+    respond_not_modified(conn, &validators, content_type);
+    close(fd);
+    return;
+  }
+  if (respond_with_ranges(conn, response, content_type, &validators, encoding,
+                          fd, NULL, file_stat->st_size)) {
     return;
   }
+  char headers[VALIDATOR_HEADERS_MAX];
+  snprintf(headers, sizeof(headers), VALIDATOR_HEADERS_TEMPLATE,
+           validators.etag, validators.last_modified,
+           encoding_headers(encoding, content_type));
+  http_write_head(&conn->out, response.statusCode, content_type,
+                  file_stat->st_size, headers, connection_header(conn));
+  if (connection_queue_file(conn, fd, 0, file_stat->st_size) == -1) {
+    Log(stderr, ERROR, "Couldn't queue file %s: %s",
+        response.payload.filePath, strerror(errno));
+    close(fd);
+    conn->keep_alive = 0;
+    conn->close_after_write = 1;
+  }
+}
 
-  fseek(file, 0, SEEK_END);
-  usize file_len = ftell(file);
-  fseek(file, 0, SEEK_SET);
+// The cached header block, the Connection header and the cached body leave
+// in a single writev. Takes over the reference on `entry`.
+void respond_with_cached_file(Connection *conn, Response response,
+                              CacheEntry *entry) {
+  if (response.statusCode == OK &&
+      is_not_modified(&conn->parser.headers, &entry->validators)) {
+    respond_not_modified(conn, &entry->validators, entry->content_type);
+    static_cache_release(entry);
+    return;
+  }
+  if (respond_with_ranges(conn, response, entry->content_type,
+                          &entry->validators, entry->encoding, -1, entry,
+                          entry->body_len)) {
+    return;
+  }
+  if (connection_queue_memory(conn, entry->header, entry->header_len, NULL,
+                              NULL) == -1 ||
+      buffer_appendf(&conn->out, "%s\r\n", connection_header(conn)) == -1 ||
+      connection_queue_memory(conn, entry->body, entry->body_len,
+                              static_cache_release, entry) == -1) {
+    Log(stderr, ERROR, "Couldn't queue file %s: %s",
+        response.payload.filePath, strerror(errno));
+    static_cache_release(entry);
+    conn->keep_alive = 0;
+    conn->close_after_write = 1;
+  }
+}
+
+// Header-only answer telling the client its copy is still good
+void respond_not_modified(Connection *conn, const FileValidators *validators,
+                          const char *content_type) {
+  http_write_status_line(&conn->out, NOT_MODIFIED);
+  buffer_appendf(&conn->out, NOT_MODIFIED_TEMPLATE, validators->etag,
+                 validators->last_modified, encoding_headers(0, content_type),
+                 connection_header(conn));
+}
+
+// Answers a Range request for a file of `size` bytes whose body is read from
+// `fd`, or from the cached `entry` when `fd` is -1. Returns 0 if the whole
+// file has to be sent instead, otherwise `fd` or `entry` have been taken
+// over.
+int respond_with_ranges(Connection *conn, Response response,
+                        const char *content_type,
+                        const FileValidators *validators, unsigned encoding,
+                        int fd, CacheEntry *entry, usize size) {
+  const HttpHeader *range = headers_find(&conn->parser.headers, HEADER_RANGE);
+  if (!range || response.statusCode != OK ||
+      !if_range_matches(&conn->parser.headers, validators)) {
+    return 0;
+  }
+  ByteRanges ranges;
+  RangeResult result = parse_ranges(range->value, size, &ranges);
+  if (result == RANGE_IGNORED) {
+    return 0;
+  }
+
+  if (result == RANGE_UNSATISFIABLE) {
+    http_write_status_line(&conn->out, RANGE_NOT_SATISFIABLE);
+    buffer_appendf(&conn->out, RANGE_NOT_SATISFIABLE_TEMPLATE, size,
+                   connection_header(conn));
+  } else if (ranges.count == 1) {
+    ByteRange *part = &ranges.entries[0];
+    char headers[VALIDATOR_HEADERS_MAX + 64];
+    snprintf(headers, sizeof(headers),
+             VALIDATOR_HEADERS_TEMPLATE "Content-Range: bytes %lu-%lu/%lu\r\n",
+             validators->etag, validators->last_modified,
+             encoding_headers(encoding, content_type), part->start,
+             part->start + part->len - 1, size);
+    http_write_head(&conn->out, PARTIAL_CONTENT, content_type, part->len,
+                    headers, connection_header(conn));
+    queue_file_part(conn, fd, entry, part);
+  } else {
+    respond_with_byteranges(conn, content_type, validators, encoding, fd,
+                            entry, size, &ranges);
+  }
 
-  dprintf(*client_fd, HTTP_HEADER_TEMPLATE, response.statusCode,
-          "application/json", file_len);
+  if (entry) {
+    static_cache_release(entry);
+  } else {
+    close(fd);
+  }
+  return 1;
+}
 
-  usize read_len = 0;
-  usize chunck_len = 512;
-  char chunck[chunck_len];
+// Several ranges go out as a multipart/byteranges body, each part carrying
+// its own Content-Range
+void respond_with_byteranges(Connection *conn, const char *content_type,
+                             const FileValidators *validators,
+                             unsigned encoding, int fd, CacheEntry *entry,
+                             usize size, ByteRanges *ranges) {
+  static atomic_ulong boundaries = 0;
+  char boundary[24];
+  snprintf(boundary, sizeof(boundary), "%016lx",
+           (atomic_fetch_add_explicit(&boundaries, 1, memory_order_relaxed) +
+            1) *
+               0x9e3779b97f4a7c15UL);
 
-  while (1) {
-    read_len = fread(chunck, sizeof(char), chunck_len, file);
-    if (read_len < 0) {
-      Log(stderr, ERROR, "Couldn't read chunck from specified file %s\n",
-          strerror(errno));
-      send_string_response(client_fd, 500, "Internal ERROR",
-                           "<h1>Internal Server ERROR</h1>");
-      fclose(file);
+  usize body_len = strlen("\r\n--") + strlen(boundary) + strlen("--\r\n");
+  for (usize i = 0; i < ranges->count; ++i) {
+    ByteRange *part = &ranges->entries[i];
+    body_len += snprintf(NULL, 0, BYTERANGES_PART_TEMPLATE, boundary,
+                         content_type, part->start,
+                         part->start + part->len - 1, size) +
+                part->len;
+  }
+  char multipart_type[64];
+  snprintf(multipart_type, sizeof(multipart_type),
+           "multipart/byteranges; boundary=%s", boundary);
+  char headers[VALIDATOR_HEADERS_MAX];
+  snprintf(headers, sizeof(headers), VALIDATOR_HEADERS_TEMPLATE,
+           validators->etag, validators->last_modified,
+           encoding_headers(encoding, content_type));
+  http_write_head(&conn->out, PARTIAL_CONTENT, multipart_type, body_len,
+                  headers, connection_header(conn));
+
+  for (usize i = 0; i < ranges->count; ++i) {
+    ByteRange *part = &ranges->entries[i];
+    buffer_appendf(&conn->out, BYTERANGES_PART_TEMPLATE, boundary,
+                   content_type, part->start, part->start + part->len - 1,
+                   size);
+    if (queue_file_part(conn, fd, entry, part) == -1) {
       return;
     }
-    dprintf(*client_fd, "%s", chunck);
-    if (read_len < chunck_len) {
-      break;
-    }
   }
+  buffer_appendf(&conn->out, "\r\n--%s--\r\n", boundary);
+}
 
-  fclose(file);
+// Queues one range of the body with a reference (or descriptor) of its own,
+// the caller's is left for it to drop
+int queue_file_part(Connection *conn, int fd, CacheEntry *entry,
+                    ByteRange *part) {
+  int queued;
+  if (entry) {
+    static_cache_retain(entry);
+    queued = connection_queue_memory(conn, entry->body + part->start,
+                                     part->len, static_cache_release, entry);
+    if (queued == -1) {
+      static_cache_release(entry);
+    }
+  } else {
+    int part_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    queued = part_fd == -1 ? -1
+                           : connection_queue_file(conn, part_fd, part->start,
+                                                   part->len);
+    if (queued == -1 && part_fd != -1) {
+      close(part_fd);
+    }
+  }
+  if (queued == -1) {
+    Log(stderr, ERROR, "Couldn't queue file range: %s", strerror(errno));
+    conn->keep_alive = 0;
+    conn->close_after_write = 1;
+  }
+  return queued;
 }
@@ -0,0 +1,307 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../exteral/log4c/include/log4c.h"
+
+#include "../include/alpha/router.h"
+
+#define ROUTE_NODE_INIT_CAP 4
+
+RouteNode *route_node_new(const char *prefix, usize prefix_len);
+int route_node_add_child(RouteNode *node, RouteNode *child);
+RouteNode *route_node_child(RouteNode *node, char first);
+int route_node_split(RouteNode *node, usize at);
+RouteNode *route_node_insert_static(RouteNode *node, const char *rest,
+                                    usize rest_len);
+RouteNode *route_node_capture(RouteNode **slot, const char *name,
+                              usize name_len);
+Route *route_node_match(RouteNode *node, const char *path, usize path_len,
+                        RouteParams *params);
+
+RouteNode *route_node_new(const char *prefix, usize prefix_len) {
+  RouteNode *node = calloc(1, sizeof(RouteNode));
+  if (!node) {
+    return NULL;
+  }
+  node->_prefix = malloc(prefix_len + 1);
+  if (!node->_prefix) {
+    free(node);
+    return NULL;
+  }
+  memcpy(node->_prefix, prefix, prefix_len);
+  node->_prefix[prefix_len] = '\0';
+  node->_prefixLen = prefix_len;
+  return node;
+}
+
+int route_node_add_child(RouteNode *node, RouteNode *child) {
+  if (node->_childrenCount == node->_childrenCapacity) {
+    usize new_cap = node->_childrenCapacity ? node->_childrenCapacity * 2
+                                            : ROUTE_NODE_INIT_CAP;
+    RouteNode **children =
+        realloc(node->_children, sizeof(RouteNode *) * new_cap);
+    if (!children) {
+      return -1;
+    }
+    node->_children = children;
+    char *indices = realloc(node->_indices, new_cap);
+    if (!indices) {
+      return -1;
+    }
+    node->_indices = indices;
+    node->_childrenCapacity = new_cap;
+  }
+  node->_indices[node->_childrenCount] = child->_prefix[0];
+  node->_children[node->_childrenCount++] = child;
+  return 0;
+}
+
+// Siblings never share a first byte, so it identifies the one edge to follow
+RouteNode *route_node_child(RouteNode *node, char first) {
+  const char *index = memchr(node->_indices, first, node->_childrenCount);
+  return index ? node->_children[index - node->_indices] : NULL;
+}
+
+// Moves everything below `node` past `at` bytes of its prefix into a new
+// child, leaving `node` as the shared part of the prefix
+int route_node_split(RouteNode *node, usize at) {
+  RouteNode *child =
+      route_node_new(node->_prefix + at, node->_prefixLen - at);
+  if (!child) {
+    return -1;
+  }
+  child->_indices = node->_indices;
+  child->_children = node->_children;
+  child->_childrenCount = node->_childrenCount;
+  child->_childrenCapacity = node->_childrenCapacity;
+  child->_paramChild = node->_paramChild;
+  child->_wildcardChild = node->_wildcardChild;
+  child->_hasRoute = node->_hasRoute;
+  child->_route = node->_route;
+
+  node->_indices = NULL;
+  node->_children = NULL;
+  node->_childrenCount = 0;
+  node->_childrenCapacity = 0;
+  node->_paramChild = NULL;
+  node->_wildcardChild = NULL;
+  node->_hasRoute = 0;
+  node->_prefix[at] = '\0';
+  node->_prefixLen = at;
+  if (route_node_add_child(node, child) == -1) {
+    return -1;
+  }
+  return 0;
+}
+
+// Inserts a static piece below `node`, splitting edges where needed, and
+// returns the node the piece ends on
+RouteNode *route_node_insert_static(RouteNode *node, const char *rest,
+                                    usize rest_len) {
+  while (1) {
+    usize common = 0;
+    while (common < node->_prefixLen && common < rest_len &&
+           node->_prefix[common] == rest[common]) {
+      common++;
+    }
+    if (common < node->_prefixLen && route_node_split(node, common) == -1) {
+      return NULL;
+    }
+    rest += common;
+    rest_len -= common;
+    if (rest_len == 0) {
+      return node;
+    }
+
+    RouteNode *child = route_node_child(node, rest[0]);
+    if (child) {
+      node = child;
+      continue;
+    }
+    child = route_node_new(rest, rest_len);
+    if (!child || route_node_add_child(node, child) == -1) {
+      return NULL;
+    }
+    return child;
+  }
+}
+
+// Returns the param or wildcard node in `slot`, creating it on first use.
+// Two routes can't name the same capture differently.
+RouteNode *route_node_capture(RouteNode **slot, const char *name,
+                              usize name_len) {
+  if (*slot) {
+    if (strlen((*slot)->_paramName) != name_len ||
+        strncmp((*slot)->_paramName, name, name_len) != 0) {
+      errno = EEXIST;
+      return NULL;
+    }
+    return *slot;
+  }
+  RouteNode *node = route_node_new("", 0);
+  if (!node) {
+    return NULL;
+  }
+  node->_paramName = strndup(name, name_len);
+  if (!node->_paramName) {
+    return NULL;
+  }
+  *slot = node;
+  return node;
+}
+
+// Route syntax: static text, `:name` for one path segment and a trailing
+// `*name` (or bare `*`) for the rest of the path
+int router_add(Router *router, HttpMethod method, char *path,
+               AlphaRouteHandler handler, AlphaBodyHandler on_body) {
+  if (!path || path[0] != '/' || !handler || method < 1 ||
+      method > HTTP_METHODS_COUNT) {
+    Log(stderr, ERROR, "Couldn't register route %s: invalid route",
+        path ? path : "(null)");
+    return -1;
+  }
+
+  RouteNode **root = &router->_roots[method - 1];
+  if (!*root && !(*root = route_node_new("", 0))) {
+    Log(stderr, ERROR, "Couldn't register route %s: %s", path,
+        strerror(errno));
+    return -1;
+  }
+
+  RouteNode *node = *root;
+  const char *rest = path;
+  usize params_count = 0;
+  while (node && *rest) {
+    usize static_len = strcspn(rest, ":*");
+    if (static_len) {
+      node = route_node_insert_static(node, rest, static_len);
+      rest += static_len;
+      continue;
+    }
+
+    if (*rest == ':') {
+      usize name_len = strcspn(rest + 1, "/");
+      if (name_len == 0 || rest[-1] != '/' ||
+          memchr(rest + 1, '*', name_len) || memchr(rest + 1, ':', name_len) ||
+          ++params_count > ROUTE_PARAMS_MAX) {
+        Log(stderr, ERROR, "Couldn't register route %s: invalid parameter",
+            path);
+        return -1;
+      }
+      node = route_node_capture(&node->_paramChild, rest + 1, name_len);
+      rest += 1 + name_len;
+      continue;
+    }
+
+    usize name_len = strlen(rest + 1);
+    if (rest[-1] != '/' || strpbrk(rest + 1, "/:*") ||
+        ++params_count > ROUTE_PARAMS_MAX) {
+      Log(stderr, ERROR,
+          "Couldn't register route %s: wildcard must be the last segment",
+          path);
+      return -1;
+    }
+    node = name_len ? route_node_capture(&node->_wildcardChild, rest + 1,
+                                         name_len)
+                    : route_node_capture(&node->_wildcardChild, "*", 1);
+    rest += 1 + name_len;
+  }
+
+  if (!node) {
+    Log(stderr, ERROR, "Couldn't register route %s: %s", path,
+        strerror(errno));
+    return -1;
+  }
+  if (node->_hasRoute) {
+    Log(stderr, ERROR, "Couldn't register route %s: already registered", path);
+    return -1;
+  }
+  Route *routes =
+      realloc(router->_routes, sizeof(Route) * (router->_routesCount + 1));
+  if (!routes) {
+    Log(stderr, ERROR, "Couldn't register route %s: %s", path,
+        strerror(errno));
+    return -1;
+  }
+  router->_routes = routes;
+  node->_hasRoute = 1;
+  node->_route = (Route){
+      ._handler = handler,
+      ._onBody = on_body,
+      ._method = method,
+      ._path = path,
+      ._id = router->_routesCount + 1,
+  };
+  routes[router->_routesCount] = node->_route;
+  router->_routesCount += 1;
+  return 0;
+}
+
+// `path` is what's left once `node` itself matched. Static edges win over
+// `:name`, which wins over `*name`; a branch that dead-ends gives its
+// captures back and the next kind is tried.
+Route *route_node_match(RouteNode *node, const char *path, usize path_len,
+                        RouteParams *params) {
+  if (path_len == 0 && node->_hasRoute) {
+    return &node->_route;
+  }
+
+  if (path_len) {
+    RouteNode *child = route_node_child(node, path[0]);
+    if (child && child->_prefixLen <= path_len &&
+        memcmp(child->_prefix, path, child->_prefixLen) == 0) {
+      Route *route = route_node_match(child, path + child->_prefixLen,
+                                      path_len - child->_prefixLen, params);
+      if (route) {
+        return route;
+      }
+    }
+  }
+
+  RouteNode *param = node->_paramChild;
+  if (param && path_len) {
+    const char *segment_end = memchr(path, '/', path_len);
+    usize segment_len = segment_end ? (usize)(segment_end - path) : path_len;
+    if (segment_len) {
+      usize captured = params->count;
+      params->entries[params->count++] = (RouteParam){
+          .name = {param->_paramName, strlen(param->_paramName)},
+          .value = {path, segment_len},
+      };
+      Route *route = route_node_match(param, path + segment_len,
+                                      path_len - segment_len, params);
+      if (route) {
+        return route;
+      }
+      params->count = captured;
+    }
+  }
+
+  RouteNode *wildcard = node->_wildcardChild;
+  if (wildcard && wildcard->_hasRoute) {
+    params->entries[params->count++] = (RouteParam){
+        .name = {wildcard->_paramName, strlen(wildcard->_paramName)},
+        .value = {path, path_len},
+    };
+    return &wildcard->_route;
+  }
+  return NULL;
+}
+
+// Captured values are slices of `path`, so matching never allocates. The
+// query string, if any, doesn't take part in matching.
+Route *match_route(Router *router, char *path, HttpMethod method,
+                   RouteParams *params) {
+  if (method < 1 || method > HTTP_METHODS_COUNT ||
+      !router->_roots[method - 1]) {
+    return NULL;
+  }
+  RouteParams ignored;
+  if (!params) {
+    params = &ignored;
+  }
+  params->count = 0;
+  return route_node_match(router->_roots[method - 1], path,
+                          strcspn(path, "?"), params);
+}
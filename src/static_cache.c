@@ -0,0 +1,302 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/alpha/encoding.h"
+#include "../include/alpha/http.h"
+#include "../include/alpha/mime.h"
+#include "../include/alpha/static_cache.h"
+#include "../include/alpha/templates.h"
+
+// Helpers
+usize static_cache_hash(const char *path);
+CacheEntry *static_cache_find(CacheShard *shard, usize hash, const char *path,
+                              const char *content_type, unsigned encoding,
+                              StatusCode status);
+int static_cache_is_fresh(CacheEntry *entry, struct stat *file_stat);
+CacheEntry *static_cache_load(StaticCache *cache, const char *path,
+                              const char *content_type, unsigned encoding,
+                              StatusCode status, usize hash, int *fd,
+                              struct stat *file_stat);
+void static_cache_insert(CacheShard *shard, CacheEntry *entry);
+void static_cache_unlink(CacheShard *shard, CacheEntry *entry);
+void static_cache_evict(StaticCache *cache, CacheShard *shard, usize needed);
+
+StaticCache *static_cache_new(usize budget, usize max_file) {
+  StaticCache *cache = calloc(1, sizeof(StaticCache));
+  if (!cache) {
+    return NULL;
+  }
+  cache->shard_budget = budget / STATIC_CACHE_SHARDS;
+  cache->max_file = max_file;
+  for (usize i = 0; i < STATIC_CACHE_SHARDS; ++i) {
+    pthread_rwlock_init(&cache->shards[i].lock, NULL);
+  }
+  return cache;
+}
+
+// FNV-1a
+usize static_cache_hash(const char *path) {
+  usize hash = 14695981039346656037UL;
+  for (; *path; ++path) {
+    hash ^= (unsigned char)*path;
+    hash *= 1099511628211UL;
+  }
+  return hash;
+}
+
+CacheEntry *static_cache_find(CacheShard *shard, usize hash, const char *path,
+                              const char *content_type, unsigned encoding,
+                              StatusCode status) {
+  CacheEntry *entry = shard->buckets[(hash >> 4) % STATIC_CACHE_BUCKETS];
+  for (; entry; entry = entry->next) {
+    if (entry->hash == hash && entry->status == status &&
+        entry->content_type == content_type && entry->encoding == encoding &&
+        strcmp(entry->path, path) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+// Returns a referenced entry holding the response for the file at `path`,
+// loading it on a miss, or NULL if the file can't or shouldn't be cached.
+// A regular file that wasn't cached is left open in `*fd`, with its fstat(2)
+// in `*file_stat`, so it can be sent without opening it again. Otherwise
+// `*fd` is -1, with errno set when the file couldn't be opened. Hits only
+// take the shard's read lock.
+CacheEntry *static_cache_get(StaticCache *cache, const char *path,
+                             const char *content_type, unsigned encoding,
+                             StatusCode status, int *fd,
+                             struct stat *file_stat) {
+  *fd = -1;
+  usize hash = static_cache_hash(path);
+  CacheShard *shard = &cache->shards[hash % STATIC_CACHE_SHARDS];
+
+  pthread_rwlock_rdlock(&shard->lock);
+  CacheEntry *entry =
+      static_cache_find(shard, hash, path, content_type, encoding, status);
+  if (entry) {
+    atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+    atomic_store_explicit(&entry->referenced, 1, memory_order_relaxed);
+  }
+  pthread_rwlock_unlock(&shard->lock);
+
+  if (entry) {
+    // A file is stat()ed at most once a second to notice it changed
+    long now = time(NULL);
+    long checked_at =
+        atomic_load_explicit(&entry->checked_at, memory_order_relaxed);
+    if (checked_at == now ||
+        !atomic_compare_exchange_strong(&entry->checked_at, &checked_at,
+                                        now)) {
+      return entry;
+    }
+    struct stat file_stat;
+    if (stat(path, &file_stat) == 0 &&
+        static_cache_is_fresh(entry, &file_stat)) {
+      if (!encoding && is_compressible(content_type ? content_type
+                                                    : mime_type(path))) {
+        atomic_store_explicit(&entry->siblings, precompressed_siblings(path),
+                              memory_order_relaxed);
+      }
+      return entry;
+    }
+    pthread_rwlock_wrlock(&shard->lock);
+    if (static_cache_find(shard, hash, path, content_type, encoding,
+                          status) == entry) {
+      static_cache_unlink(shard, entry);
+      static_cache_release(entry);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    static_cache_release(entry);
+  }
+  return static_cache_load(cache, path, content_type, encoding, status, hash,
+                           fd, file_stat);
+}
+
+int static_cache_is_fresh(CacheEntry *entry, struct stat *file_stat) {
+  return entry->dev == file_stat->st_dev && entry->ino == file_stat->st_ino &&
+         entry->size == file_stat->st_size &&
+         entry->mtime.tv_sec == file_stat->st_mtim.tv_sec &&
+         entry->mtime.tv_nsec == file_stat->st_mtim.tv_nsec;
+}
+
+CacheEntry *static_cache_load(StaticCache *cache, const char *path,
+                              const char *content_type, unsigned encoding,
+                              StatusCode status, usize hash, int *fd,
+                              struct stat *file_stat) {
+  int file_fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (file_fd == -1) {
+    return NULL;
+  }
+  if (fstat(file_fd, file_stat) == -1) {
+    close(file_fd);
+    return NULL;
+  }
+  if (!S_ISREG(file_stat->st_mode)) {
+    close(file_fd);
+    errno = EINVAL;
+    return NULL;
+  }
+  // From here on a file that isn't cached is handed back to be streamed
+  *fd = file_fd;
+  if ((usize)file_stat->st_size > cache->max_file) {
+    return NULL;
+  }
+
+  usize path_len = strlen(path);
+  usize body_len = file_stat->st_size;
+  const char *type = content_type ? content_type : mime_type(path);
+  FileValidators validators;
+  file_validators(file_stat, &validators);
+  char headers[VALIDATOR_HEADERS_MAX];
+  snprintf(headers, sizeof(headers), VALIDATOR_HEADERS_TEMPLATE,
+           validators.etag, validators.last_modified,
+           encoding_headers(encoding, type));
+  Buffer head = {0};
+  if (http_write_head(&head, status, type, body_len, headers, "") == -1) {
+    return NULL;
+  }
+  // The blank line is left out, the Connection header goes before it per
+  // response
+  usize header_len = head.len - 2;
+  usize bytes = sizeof(CacheEntry) + path_len + 1 + header_len + body_len;
+  CacheEntry *entry = bytes > cache->shard_budget ? NULL : calloc(1, bytes);
+  if (!entry) {
+    buffer_free(&head);
+    return NULL;
+  }
+  entry->path = (char *)(entry + 1);
+  memcpy(entry->path, path, path_len + 1);
+  entry->header = entry->path + path_len + 1;
+  memcpy(entry->header, head.data, header_len);
+  buffer_free(&head);
+  entry->header_len = header_len;
+  entry->body = entry->header + header_len;
+  entry->body_len = body_len;
+
+  usize read_len = 0;
+  while (read_len < body_len) {
+    ssize_t chunk = pread(file_fd, entry->body + read_len,
+                          body_len - read_len, read_len);
+    if (chunk <= 0) {
+      if (chunk == -1 && errno == EINTR) {
+        continue;
+      }
+      free(entry);
+      return NULL;
+    }
+    read_len += chunk;
+  }
+  close(file_fd);
+  *fd = -1;
+
+  entry->hash = hash;
+  entry->content_type = content_type;
+  entry->status = status;
+  entry->encoding = encoding;
+  entry->dev = file_stat->st_dev;
+  entry->ino = file_stat->st_ino;
+  entry->size = file_stat->st_size;
+  entry->mtime = file_stat->st_mtim;
+  entry->validators = validators;
+  entry->bytes = bytes;
+  atomic_init(&entry->refs, 2);
+  atomic_init(&entry->referenced, 1);
+  atomic_init(&entry->checked_at, time(NULL));
+  atomic_init(&entry->siblings, !encoding && is_compressible(type)
+                                    ? precompressed_siblings(path)
+                                    : 0);
+
+  CacheShard *shard = &cache->shards[hash % STATIC_CACHE_SHARDS];
+  pthread_rwlock_wrlock(&shard->lock);
+  // Another thread may have loaded the same file in the meantime
+  CacheEntry *existing =
+      static_cache_find(shard, hash, path, content_type, encoding, status);
+  if (existing) {
+    atomic_fetch_add_explicit(&existing->refs, 1, memory_order_relaxed);
+    pthread_rwlock_unlock(&shard->lock);
+    free(entry);
+    return existing;
+  }
+  static_cache_evict(cache, shard, bytes);
+  static_cache_insert(shard, entry);
+  pthread_rwlock_unlock(&shard->lock);
+  return entry;
+}
+
+// Called with the shard's write lock held
+void static_cache_insert(CacheShard *shard, CacheEntry *entry) {
+  CacheEntry **bucket =
+      &shard->buckets[(entry->hash >> 4) % STATIC_CACHE_BUCKETS];
+  entry->next = *bucket;
+  *bucket = entry;
+
+  // New entries join the ring just behind the hand, the last spot it visits
+  if (!shard->hand) {
+    entry->clock_prev = entry;
+    entry->clock_next = entry;
+    shard->hand = entry;
+  } else {
+    entry->clock_next = shard->hand;
+    entry->clock_prev = shard->hand->clock_prev;
+    entry->clock_prev->clock_next = entry;
+    shard->hand->clock_prev = entry;
+  }
+  shard->bytes += entry->bytes;
+}
+
+// Called with the shard's write lock held. The shard's reference is left for
+// the caller to drop.
+void static_cache_unlink(CacheShard *shard, CacheEntry *entry) {
+  CacheEntry **link =
+      &shard->buckets[(entry->hash >> 4) % STATIC_CACHE_BUCKETS];
+  while (*link != entry) {
+    link = &(*link)->next;
+  }
+  *link = entry->next;
+
+  if (entry->clock_next == entry) {
+    shard->hand = NULL;
+  } else {
+    entry->clock_prev->clock_next = entry->clock_next;
+    entry->clock_next->clock_prev = entry->clock_prev;
+    if (shard->hand == entry) {
+      shard->hand = entry->clock_next;
+    }
+  }
+  shard->bytes -= entry->bytes;
+}
+
+// CLOCK: the hand gives recently hit entries a second chance and evicts the
+// first one that wasn't hit since it last went by. Called with the shard's
+// write lock held.
+void static_cache_evict(StaticCache *cache, CacheShard *shard, usize needed) {
+  while (shard->hand && shard->bytes + needed > cache->shard_budget) {
+    CacheEntry *entry = shard->hand;
+    if (atomic_exchange_explicit(&entry->referenced, 0,
+                                 memory_order_relaxed)) {
+      shard->hand = entry->clock_next;
+      continue;
+    }
+    static_cache_unlink(shard, entry);
+    static_cache_release(entry);
+  }
+}
+
+// Another reference for a response already holding one
+void static_cache_retain(CacheEntry *entry) {
+  atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+}
+
+void static_cache_release(void *arg) {
+  CacheEntry *entry = (CacheEntry *)arg;
+  if (atomic_fetch_sub_explicit(&entry->refs, 1, memory_order_acq_rel) == 1) {
+    free(entry);
+  }
+}
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/alpha/connection.h"
+#include "../include/alpha/response.h"
+
+// Room left for a chunk's size, patched in once the producer returns. Sizes
+// are written zero-padded to a fixed width, so the frame never moves.
+#define CHUNK_HEAD "00000000\r\n"
+#define CHUNK_HEAD_LEN (sizeof(CHUNK_HEAD) - 1)
+#define LAST_CHUNK "0\r\n\r\n"
+
+struct ResponseWriter {
+  Connection *conn;
+  int failed;
+};
+
+// Helpers
+void response_stream_end(Connection *conn, int status);
+
+void handle_response_with_stream(Connection *conn, Response response) {
+  StreamPayload stream = response.payload.stream;
+  // Without chunked framing the body can only end with the connection
+  conn->stream_chunked = !conn->http10;
+  if (!conn->stream_chunked) {
+    conn->keep_alive = 0;
+  }
+  const char *connection = connection_header(conn);
+  const char *type = stream.contentType ? stream.contentType : "text/plain";
+  if (buffer_reserve(&conn->out, 128 + strlen(type) + strlen(connection)) ==
+          -1 ||
+      http_write_status_line(&conn->out, response.statusCode) == -1) {
+    if (stream.release) {
+      stream.release(stream.state);
+    }
+    conn->keep_alive = 0;
+    return;
+  }
+  buffer_append(&conn->out, "Content-Type: ", 14);
+  buffer_append(&conn->out, type, strlen(type));
+  buffer_append(&conn->out, "\r\n", 2);
+  if (conn->stream_chunked) {
+    buffer_append(&conn->out, "Transfer-Encoding: chunked\r\n", 28);
+  }
+  buffer_append(&conn->out, connection, strlen(connection));
+  buffer_append(&conn->out, "\r\n", 2);
+  conn->stream = stream;
+}
+
+// Runs the producer until STREAM_BUFFER_MAX bytes wait for the socket, so a
+// slow client holds back the producer instead of filling memory. Each call
+// becomes one chunk, however many writes it made.
+void response_stream_produce(Connection *conn) {
+  while (conn->stream.producer &&
+         conn->out.len - conn->out_sent < STREAM_BUFFER_MAX) {
+    usize frame = conn->out.len;
+    if (conn->stream_chunked &&
+        buffer_append(&conn->out, CHUNK_HEAD, CHUNK_HEAD_LEN) == -1) {
+      response_stream_end(conn, -1);
+      return;
+    }
+    ResponseWriter writer = {.conn = conn};
+    int status = conn->stream.producer(&writer, conn->stream.state);
+    if (writer.failed) {
+      status = -1;
+    }
+    usize head_len = conn->stream_chunked ? CHUNK_HEAD_LEN : 0;
+    usize written = conn->out.len - frame - head_len;
+    // Calling it again right away would get nothing either, forever
+    if (written == 0 && status == 1) {
+      status = -1;
+    }
+    if (conn->stream_chunked) {
+      if (written == 0) {
+        conn->out.len = frame;
+      } else if (written > 0xffffffff ||
+                 buffer_append(&conn->out, "\r\n", 2) == -1) {
+        status = -1;
+      } else {
+        char size[17];
+        snprintf(size, sizeof(size), "%08lx", written);
+        memcpy(conn->out.data + frame, size, 8);
+      }
+    }
+    if (status != 1) {
+      response_stream_end(conn, status);
+    }
+  }
+}
+
+void response_stream_end(Connection *conn, int status) {
+  if (status == 0 && conn->stream_chunked &&
+      buffer_append(&conn->out, LAST_CHUNK, sizeof(LAST_CHUNK) - 1) == -1) {
+    status = -1;
+  }
+  // The client can't tell a cut short chunked body from a complete one
+  // unless the connection closes
+  if (status != 0 || !conn->stream_chunked) {
+    conn->keep_alive = 0;
+    conn->close_after_write = 1;
+  }
+  response_stream_release(conn);
+}
+
+// Also called when the connection closes mid-stream
+void response_stream_release(Connection *conn) {
+  if (!conn->stream.producer) {
+    return;
+  }
+  if (conn->stream.release) {
+    conn->stream.release(conn->stream.state);
+  }
+  memset(&conn->stream, 0, sizeof(StreamPayload));
+  arena_reset(&conn->arena);
+}
+
+int ResponseWriter_Write(ResponseWriter *writer, const void *data, usize len) {
+  if (buffer_append(&writer->conn->out, data, len) == -1) {
+    writer->failed = 1;
+    return -1;
+  }
+  return 0;
+}
+
+int ResponseWriter_Printf(ResponseWriter *writer, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int status = buffer_vappendf(&writer->conn->out, fmt, args);
+  va_end(args);
+  if (status == -1) {
+    writer->failed = 1;
+  }
+  return status;
+}
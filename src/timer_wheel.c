@@ -0,0 +1,160 @@
+#include <time.h>
+
+#include "../include/alpha/timer_wheel.h"
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+// Helpers
+void timer_list_init(Timer *head);
+void timer_list_append(Timer *head, Timer *timer);
+void timer_unlink(Timer *timer);
+void timer_wheel_link(TimerWheel *wheel, Timer *timer);
+usize timer_wheel_cascade(TimerWheel *wheel, usize level);
+
+// Coarse clock, a few milliseconds off at worst but cheaper to read than
+// CLOCK_MONOTONIC
+unsigned long long timer_clock_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+  return now.tv_sec * 1000ULL + now.tv_nsec / 1000000;
+}
+
+void timer_list_init(Timer *head) {
+  head->next = head;
+  head->prev = head;
+}
+
+void timer_list_append(Timer *head, Timer *timer) {
+  timer->prev = head->prev;
+  timer->next = head;
+  head->prev->next = timer;
+  head->prev = timer;
+}
+
+void timer_unlink(Timer *timer) {
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->next = NULL;
+  timer->prev = NULL;
+}
+
+void timer_wheel_init(TimerWheel *wheel, unsigned long long now_ms) {
+  for (usize level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+    for (usize slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot) {
+      timer_list_init(&wheel->slots[level][slot]);
+    }
+  }
+  timer_list_init(&wheel->expired);
+  wheel->now = now_ms / TIMER_WHEEL_TICK_MS;
+  wheel->count = 0;
+}
+
+// Files the timer in the level whose span covers how far away it's due
+void timer_wheel_link(TimerWheel *wheel, Timer *timer) {
+  if (timer->expires <= wheel->now) {
+    timer_list_append(&wheel->expired, timer);
+    return;
+  }
+  unsigned long long delta = timer->expires - wheel->now;
+  usize level = 0;
+  while (level < TIMER_WHEEL_LEVELS - 1 &&
+         delta >> (TIMER_WHEEL_SLOT_BITS * (level + 1))) {
+    level++;
+  }
+  // Beyond the last level, it gets looked at again once that level wraps
+  unsigned long long max = 1ULL << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS);
+  if (delta >= max) {
+    timer->expires = wheel->now + max - 1;
+  }
+  usize slot =
+      (timer->expires >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_MASK;
+  timer_list_append(&wheel->slots[level][slot], timer);
+}
+
+// (Re)schedules the timer to fire once `expires_ms` has passed
+void timer_wheel_schedule(TimerWheel *wheel, Timer *timer,
+                          unsigned long long expires_ms) {
+  if (timer->next) {
+    timer_unlink(timer);
+  } else {
+    wheel->count++;
+  }
+  timer->expires =
+      (expires_ms + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+  timer_wheel_link(wheel, timer);
+}
+
+void timer_wheel_cancel(TimerWheel *wheel, Timer *timer) {
+  if (timer->next) {
+    timer_unlink(timer);
+    wheel->count--;
+  }
+}
+
+// Spreads the level's current slot over the levels below it. Returns the
+// slot index, which is 0 when the level above is due for the same.
+usize timer_wheel_cascade(TimerWheel *wheel, usize level) {
+  usize index =
+      (wheel->now >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_MASK;
+  Timer *head = &wheel->slots[level][index];
+  while (head->next != head) {
+    Timer *timer = head->next;
+    timer_unlink(timer);
+    timer_wheel_link(wheel, timer);
+  }
+  return index;
+}
+
+// Advances the wheel to `now_ms` and returns one timer that became due, or
+// NULL when none is left. Returned timers are no longer scheduled.
+Timer *timer_wheel_expire(TimerWheel *wheel, unsigned long long now_ms) {
+  unsigned long long target = now_ms / TIMER_WHEEL_TICK_MS;
+  while (wheel->now < target) {
+    wheel->now++;
+    usize index = wheel->now & TIMER_WHEEL_MASK;
+    if (index == 0) {
+      for (usize level = 1; level < TIMER_WHEEL_LEVELS; ++level) {
+        if (timer_wheel_cascade(wheel, level) != 0) {
+          break;
+        }
+      }
+    }
+    Timer *head = &wheel->slots[0][index];
+    if (head->next != head) {
+      // Splices the whole slot onto the expired list
+      head->next->prev = wheel->expired.prev;
+      wheel->expired.prev->next = head->next;
+      head->prev->next = &wheel->expired;
+      wheel->expired.prev = head->prev;
+      timer_list_init(head);
+    }
+  }
+  Timer *timer = wheel->expired.next;
+  if (timer == &wheel->expired) {
+    return NULL;
+  }
+  timer_unlink(timer);
+  wheel->count--;
+  return timer;
+}
+
+// Milliseconds until timer_wheel_expire may have something to return, -1
+// when nothing is scheduled. Lets an idle loop sleep until then.
+int timer_wheel_next_ms(const TimerWheel *wheel, unsigned long long now_ms) {
+  if (!wheel->count) {
+    return -1;
+  }
+  if (wheel->expired.next != &wheel->expired) {
+    return 0;
+  }
+  unsigned long long tick = wheel->now + 1;
+  for (; tick < wheel->now + TIMER_WHEEL_SLOTS; ++tick) {
+    const Timer *head = &wheel->slots[0][tick & TIMER_WHEEL_MASK];
+    // Higher levels cascade whenever the first level wraps
+    if (head->next != head || (tick & TIMER_WHEEL_MASK) == 0) {
+      break;
+    }
+  }
+  unsigned long long at = tick * TIMER_WHEEL_TICK_MS;
+  return at > now_ms ? at - now_ms : 0;
+}
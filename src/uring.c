@@ -0,0 +1,657 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../exteral/log4c/include/log4c.h"
+
+#include "../include/alpha/request.h"
+#include "../include/alpha/response.h"
+#include "../include/alpha/uring.h"
+
+#define URING_ENTRIES 1024
+// Multishot operations complete many times per submission
+#define URING_CQ_ENTRIES (URING_ENTRIES * 8)
+#define URING_BUFFER_GROUP 0
+// Direct descriptors per ring, unless RLIMIT_NOFILE is lower
+#define URING_FILES_MAX 65536
+// Unhandled input a connection may pile up while a response is being sent
+#define URING_INPUT_MAX (64 * 1024)
+#define URING_OP_MASK 7ULL
+
+// What a completion is for, kept in the low bits of its user_data next to
+// the connection
+typedef enum {
+  URING_ACCEPT = 1,
+  URING_RECV = 2,
+  URING_SEND = 3,
+  URING_READ = 4,
+  // A slot in the file table closed
+  URING_CLOSE = 5,
+  // Nobody waits for it: cancels, shutdowns and turned away clients
+  URING_DETACHED = 6,
+} UringOp;
+
+// Helpers
+int uring_register(int ring_fd, unsigned opcode, void *arg, unsigned count);
+int uring_enter(UringLoop *loop, int wait, int timeout_ms);
+int uring_reserve(UringLoop *loop, unsigned count);
+struct io_uring_sqe *uring_sqe(UringLoop *loop, UringConnection *uc,
+                               UringOp op);
+void uring_complete(UringLoop *loop, const struct io_uring_cqe *cqe,
+                    unsigned long long now_ms);
+void uring_accept(UringLoop *loop);
+void uring_accepted(UringLoop *loop, const struct io_uring_cqe *cqe,
+                    unsigned long long now_ms);
+void uring_admit(UringLoop *loop, unsigned slot, unsigned long long now_ms);
+void uring_turn_away(UringLoop *loop, unsigned slot);
+void uring_recv(UringLoop *loop, UringConnection *uc);
+void uring_received(UringLoop *loop, UringConnection *uc,
+                    const struct io_uring_cqe *cqe);
+void uring_recycle(UringLoop *loop, unsigned short id);
+void uring_serve(UringLoop *loop, UringConnection *uc);
+void uring_send(UringLoop *loop, UringConnection *uc);
+void uring_sent(UringLoop *loop, UringConnection *uc, int res);
+void uring_close(UringLoop *loop, UringConnection *uc);
+void uring_close_slot(UringLoop *loop, unsigned slot);
+void uring_settle(UringConnection *uc);
+void uring_reap(UringLoop *loop, unsigned long long now_ms);
+
+int uring_register(int ring_fd, unsigned opcode, void *arg, unsigned count) {
+  return syscall(__NR_io_uring_register, ring_fd, opcode, arg, count);
+}
+
+// Sets up the ring, its provided buffers and a sparse table of direct
+// descriptors. Fails on kernels older than 6.1 (DEFER_TASKRUN), which also
+// lack some of the multishot operations used.
+int uring_loop_init(UringLoop *loop, AlphaApp *app, int listen_fd) {
+  memset(loop, 0, sizeof(UringLoop));
+  loop->app = app;
+  loop->listen_fd = listen_fd;
+  // Disabled until the thread driving the ring enables it, since a single
+  // issuer ring belongs to the thread that does so
+  struct io_uring_params params = {
+      .flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL |
+               IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER |
+               IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_R_DISABLED,
+      .cq_entries = URING_CQ_ENTRIES,
+  };
+  loop->ring_fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+  if (loop->ring_fd == -1) {
+    Log(stderr, ERROR, "Couldn't set up io_uring: %s", strerror(errno));
+    return -1;
+  }
+  unsigned needed =
+      IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+  if ((params.features & needed) != needed) {
+    Log(stderr, ERROR, "Couldn't set up io_uring: kernel too old");
+    uring_loop_free(loop);
+    return -1;
+  }
+
+  // Both queues live in one mapping
+  loop->rings_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  usize cq_len =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (cq_len > loop->rings_len) {
+    loop->rings_len = cq_len;
+  }
+  loop->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+  char *rings = mmap(NULL, loop->rings_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, loop->ring_fd,
+                     IORING_OFF_SQ_RING);
+  loop->rings = rings == MAP_FAILED ? NULL : rings;
+  void *sqes = mmap(NULL, loop->sqes_len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, loop->ring_fd, IORING_OFF_SQES);
+  loop->sqes = sqes == MAP_FAILED ? NULL : sqes;
+  if (!loop->rings || !loop->sqes) {
+    Log(stderr, ERROR, "Couldn't map io_uring queues: %s", strerror(errno));
+    uring_loop_free(loop);
+    return -1;
+  }
+  loop->sq_khead = (unsigned *)(rings + params.sq_off.head);
+  loop->sq_ktail = (unsigned *)(rings + params.sq_off.tail);
+  loop->sq_mask = *(unsigned *)(rings + params.sq_off.ring_mask);
+  loop->sq_entries = params.sq_entries;
+  loop->sq_tail = *loop->sq_ktail;
+  // Entries are always submitted in order, so the index array never changes
+  unsigned *sq_array = (unsigned *)(rings + params.sq_off.array);
+  for (unsigned i = 0; i < params.sq_entries; ++i) {
+    sq_array[i] = i;
+  }
+  loop->cq_khead = (unsigned *)(rings + params.cq_off.head);
+  loop->cq_ktail = (unsigned *)(rings + params.cq_off.tail);
+  loop->cq_mask = *(unsigned *)(rings + params.cq_off.ring_mask);
+  loop->cqes = (struct io_uring_cqe *)(rings + params.cq_off.cqes);
+
+  // Receives pick a buffer when data arrives instead of holding one each
+  void *buffers = mmap(NULL, sizeof(struct io_uring_buf) * URING_BUFFERS,
+                       PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                       -1, 0);
+  loop->buffers = buffers == MAP_FAILED ? NULL : buffers;
+  loop->buffers_memory = malloc(URING_BUFFERS * URING_BUFFER_LEN);
+  if (!loop->buffers || !loop->buffers_memory) {
+    Log(stderr, ERROR, "Couldn't allocate receive buffers: %s",
+        strerror(errno));
+    uring_loop_free(loop);
+    return -1;
+  }
+  struct io_uring_buf_reg buffers_reg = {
+      .ring_addr = (uintptr_t)loop->buffers,
+      .ring_entries = URING_BUFFERS,
+      .bgid = URING_BUFFER_GROUP,
+  };
+  if (uring_register(loop->ring_fd, IORING_REGISTER_PBUF_RING, &buffers_reg,
+                     1) == -1) {
+    Log(stderr, ERROR, "Couldn't register receive buffers: %s",
+        strerror(errno));
+    uring_loop_free(loop);
+    return -1;
+  }
+  for (unsigned short id = 0; id < URING_BUFFERS; ++id) {
+    uring_recycle(loop, id);
+  }
+
+  struct rlimit files_limit;
+  unsigned files = URING_FILES_MAX;
+  if (getrlimit(RLIMIT_NOFILE, &files_limit) == 0 &&
+      files_limit.rlim_cur < files) {
+    files = files_limit.rlim_cur;
+  }
+  struct io_uring_rsrc_register files_reg = {
+      .nr = files,
+      .flags = IORING_RSRC_REGISTER_SPARSE,
+  };
+  if (uring_register(loop->ring_fd, IORING_REGISTER_FILES2, &files_reg,
+                     sizeof(files_reg)) == -1) {
+    Log(stderr, ERROR, "Couldn't register file table: %s", strerror(errno));
+    uring_loop_free(loop);
+    return -1;
+  }
+  loop->files = files;
+  // A full accept queue drained by one multishot accept still fits
+  loop->accept_reserve = app->_backLog;
+  timer_wheel_init(&loop->timers, timer_clock_ms());
+  return 0;
+}
+
+void uring_loop_free(UringLoop *loop) {
+  if (loop->buffers) {
+    munmap(loop->buffers, sizeof(struct io_uring_buf) * URING_BUFFERS);
+  }
+  free(loop->buffers_memory);
+  if (loop->sqes) {
+    munmap(loop->sqes, loop->sqes_len);
+  }
+  if (loop->rings) {
+    munmap(loop->rings, loop->rings_len);
+  }
+  close(loop->ring_fd);
+}
+
+void *UringLoopHandler(void *arg) {
+  UringLoop *loop = (UringLoop *)arg;
+  if (uring_register(loop->ring_fd, IORING_REGISTER_ENABLE_RINGS, NULL, 0) ==
+      -1) {
+    Log(stderr, ERROR, "Couldn't enable io_uring: %s", strerror(errno));
+    return NULL;
+  }
+  uring_accept(loop);
+  while (1) {
+    if (uring_enter(loop, 1,
+                    timer_wheel_next_ms(&loop->timers, timer_clock_ms())) ==
+        -1) {
+      return NULL;
+    }
+    unsigned long long now = timer_clock_ms();
+    unsigned head = *loop->cq_khead;
+    unsigned tail = __atomic_load_n(loop->cq_ktail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      // Copied out so its slot can be reused right away
+      struct io_uring_cqe cqe = loop->cqes[head & loop->cq_mask];
+      __atomic_store_n(loop->cq_khead, head + 1, __ATOMIC_RELEASE);
+      uring_complete(loop, &cqe, now);
+    }
+    uring_reap(loop, now);
+    if (loop->broken) {
+      return NULL;
+    }
+  }
+  return NULL;
+}
+
+// Submits what was queued and, with `wait`, sleeps until something completes
+// or `timeout_ms` passed (-1 waits as long as it takes)
+int uring_enter(UringLoop *loop, int wait, int timeout_ms) {
+  __atomic_store_n(loop->sq_ktail, loop->sq_tail, __ATOMIC_RELEASE);
+  unsigned to_submit =
+      loop->sq_tail - __atomic_load_n(loop->sq_khead, __ATOMIC_ACQUIRE);
+  struct __kernel_timespec timeout = {
+      .tv_sec = timeout_ms / 1000,
+      .tv_nsec = (timeout_ms % 1000) * 1000000LL,
+  };
+  struct io_uring_getevents_arg arg = {
+      .ts = timeout_ms >= 0 ? (uintptr_t)&timeout : 0,
+  };
+  unsigned flags = IORING_ENTER_EXT_ARG | (wait ? IORING_ENTER_GETEVENTS : 0);
+  if (syscall(__NR_io_uring_enter, loop->ring_fd, to_submit, wait ? 1 : 0,
+              flags, &arg, sizeof(arg)) == -1 &&
+      errno != EINTR && errno != ETIME && errno != EAGAIN && errno != EBUSY) {
+    Log(stderr, ERROR, "Couldn't enter io_uring: %s", strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+// Makes room for `count` entries, so linked ones are submitted together.
+// Returns -1 once the ring can't take submissions anymore.
+int uring_reserve(UringLoop *loop, unsigned count) {
+  while (!loop->broken &&
+         loop->sq_entries -
+                 (loop->sq_tail -
+                  __atomic_load_n(loop->sq_khead, __ATOMIC_ACQUIRE)) <
+             count) {
+    if (uring_enter(loop, 0, -1) == -1) {
+      loop->broken = 1;
+    }
+  }
+  return loop->broken ? -1 : 0;
+}
+
+// Next submission entry, cleared and tagged with who completes it. NULL once
+// the ring is broken, the loop stopping after the completions at hand.
+struct io_uring_sqe *uring_sqe(UringLoop *loop, UringConnection *uc,
+                               UringOp op) {
+  if (uring_reserve(loop, 1) == -1) {
+    return NULL;
+  }
+  struct io_uring_sqe *sqe = &loop->sqes[loop->sq_tail++ & loop->sq_mask];
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->user_data = (uintptr_t)uc | op;
+  if (uc) {
+    uc->pending++;
+  }
+  return sqe;
+}
+
+void uring_complete(UringLoop *loop, const struct io_uring_cqe *cqe,
+                    unsigned long long now_ms) {
+  UringConnection *uc =
+      (UringConnection *)(uintptr_t)(cqe->user_data & ~URING_OP_MASK);
+  switch (cqe->user_data & URING_OP_MASK) {
+  case URING_ACCEPT:
+    uring_accepted(loop, cqe, now_ms);
+    return;
+  case URING_RECV:
+    uring_received(loop, uc, cqe);
+    break;
+  case URING_READ:
+    uc->pending--;
+    // The file shrank since its Content-Length was sent, the send linked
+    // after the read is cancelled
+    if (cqe->res != (int)uc->chunk_len) {
+      uc->failed = 1;
+    }
+    break;
+  case URING_SEND:
+    uring_sent(loop, uc, cqe->res);
+    break;
+  case URING_CLOSE:
+    loop->open--;
+    uring_accept(loop);
+    return;
+  default:
+    return;
+  }
+  if (uc->closing) {
+    uring_settle(uc);
+    return;
+  }
+  connection_schedule(&uc->conn, &loop->timers, now_ms);
+}
+
+// A multishot accept drains the whole accept queue, and one that finds the
+// file table full drops the connection it already took off the queue. So it's
+// only armed while plenty of slots are free, then connections are accepted one
+// at a time.
+void uring_accept(UringLoop *loop) {
+  unsigned free_slots = loop->files - loop->open;
+  if (loop->accepting || !free_slots) {
+    return;
+  }
+  struct io_uring_sqe *sqe = uring_sqe(loop, NULL, URING_ACCEPT);
+  if (!sqe) {
+    return;
+  }
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = loop->listen_fd;
+  sqe->file_index = IORING_FILE_INDEX_ALLOC;
+  loop->accept_multishot = free_slots > loop->accept_reserve;
+  if (loop->accept_multishot) {
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  }
+  loop->accepting = 1;
+}
+
+// Accepted sockets only exist as direct descriptors, so the client address
+// isn't known and `client.file_descriptor` stays -1
+void uring_accepted(UringLoop *loop, const struct io_uring_cqe *cqe,
+                    unsigned long long now_ms) {
+  if (!(cqe->flags & IORING_CQE_F_MORE)) {
+    loop->accepting = 0;
+  }
+  if (cqe->res >= 0) {
+    loop->open++;
+    uring_admit(loop, cqe->res, now_ms);
+  } else if (cqe->res != -ECANCELED) {
+    Log(stderr, ERROR, "Couldn't Accept conn: %s", strerror(-cqe->res));
+  }
+  if (loop->accepting && loop->accept_multishot &&
+      loop->files - loop->open <= loop->accept_reserve) {
+    struct io_uring_sqe *sqe = uring_sqe(loop, NULL, URING_DETACHED);
+    if (sqe) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->addr = URING_ACCEPT;
+      loop->accept_multishot = 0;
+    }
+  }
+  uring_accept(loop);
+}
+
+void uring_admit(UringLoop *loop, unsigned slot, unsigned long long now_ms) {
+  if (admission_connection_acquire(loop->app->_admission) == -1) {
+    uring_turn_away(loop, slot);
+    return;
+  }
+  UringConnection *uc = malloc(sizeof(UringConnection));
+  if (!uc) {
+    Log(stderr, ERROR, "Couldn't allocate connection: %s", strerror(errno));
+    uring_close_slot(loop, slot);
+    admission_connection_release(loop->app->_admission);
+    return;
+  }
+  memset(uc, 0, sizeof(UringConnection));
+  connection_init(&uc->conn, loop->app, (Client){.file_descriptor = -1}, 0);
+  uc->conn.timer.owner = uc;
+  uc->slot = slot;
+  uring_recv(loop, uc);
+  if (uc->closing) {
+    uring_settle(uc);
+    return;
+  }
+  connection_schedule(&uc->conn, &loop->timers, now_ms);
+}
+
+// Does what admission_reject does with one linked submission: drops the
+// request head already sent, replies and closes, each step running whether
+// or not the one before it failed
+void uring_turn_away(UringLoop *loop, unsigned slot) {
+  const Buffer *reply = admission_turn_away(loop->app->_admission);
+  if (uring_reserve(loop, 3) == -1) {
+    return;
+  }
+  if (reply->len) {
+    struct io_uring_sqe *sqe = uring_sqe(loop, NULL, URING_DETACHED);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = slot;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+    sqe->addr = (uintptr_t)loop->discard;
+    sqe->len = sizeof(loop->discard);
+    sqe->msg_flags = MSG_DONTWAIT;
+    sqe = uring_sqe(loop, NULL, URING_DETACHED);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = slot;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+    sqe->addr = (uintptr_t)reply->data;
+    sqe->len = reply->len;
+    sqe->msg_flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+  }
+  uring_close_slot(loop, slot);
+}
+
+// Multishot: completes with every piece of input, each in a buffer taken
+// from the ring, until it fails or the buffers run out
+void uring_recv(UringLoop *loop, UringConnection *uc) {
+  struct io_uring_sqe *sqe = uring_sqe(loop, uc, URING_RECV);
+  if (!sqe) {
+    uring_close(loop, uc);
+    return;
+  }
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = uc->slot;
+  sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+  sqe->buf_group = URING_BUFFER_GROUP;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  uc->receiving = 1;
+}
+
+void uring_received(UringLoop *loop, UringConnection *uc,
+                    const struct io_uring_cqe *cqe) {
+  Connection *conn = &uc->conn;
+  if (!(cqe->flags & IORING_CQE_F_MORE)) {
+    uc->receiving = 0;
+    uc->pending--;
+  }
+  if (cqe->flags & IORING_CQE_F_BUFFER) {
+    unsigned short id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    int failed = !uc->closing && cqe->res > 0 &&
+                 connection_receive(conn,
+                                    loop->buffers_memory +
+                                        (usize)id * URING_BUFFER_LEN,
+                                    cqe->res) == -1;
+    uring_recycle(loop, id);
+    if (failed) {
+      uring_close(loop, uc);
+    }
+  }
+  if (uc->closing) {
+    return;
+  }
+  if (cqe->res == 0) {
+    uc->hung_up = 1;
+  } else if (cqe->res < 0 && cqe->res != -ENOBUFS &&
+             cqe->res != -ECANCELED) {
+    uring_close(loop, uc);
+    return;
+  }
+  // A client pipelining requests without reading the responses is held
+  // back like on a blocked socket: receiving resumes once they're sent
+  if (uc->sending && uc->receiving && !uc->throttled &&
+      conn->in.len - conn->in_offset > URING_INPUT_MAX) {
+    struct io_uring_sqe *sqe = uring_sqe(loop, NULL, URING_DETACHED);
+    if (!sqe) {
+      uring_close(loop, uc);
+      return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = (uintptr_t)uc | URING_RECV;
+    uc->throttled = 1;
+  }
+  uring_serve(loop, uc);
+}
+
+// Hands a receive buffer back to the kernel
+void uring_recycle(UringLoop *loop, unsigned short id) {
+  struct io_uring_buf *buffer =
+      &loop->buffers->bufs[loop->buffers_tail & (URING_BUFFERS - 1)];
+  buffer->addr =
+      (uintptr_t)(loop->buffers_memory + (usize)id * URING_BUFFER_LEN);
+  buffer->len = URING_BUFFER_LEN;
+  buffer->bid = id;
+  loop->buffers_tail++;
+  __atomic_store_n(&loop->buffers->tail, loop->buffers_tail, __ATOMIC_RELEASE);
+}
+
+// connection_serve for completions: handles the requests sitting in `in` and
+// submits the send of their responses, or goes back to receiving. Nothing
+// happens while a send is in flight, it calls this again once it completed.
+void uring_serve(UringLoop *loop, UringConnection *uc) {
+  Connection *conn = &uc->conn;
+  if (uc->sending) {
+    return;
+  }
+  do {
+    response_stream_produce(conn);
+    while (!conn->close_after_write && !conn->stream.producer &&
+           handle_request(conn)) {
+    }
+    if (connection_has_output(conn)) {
+      uring_send(loop, uc);
+      return;
+    }
+  } while (conn->stream.producer);
+  if (conn->close_after_write || uc->hung_up) {
+    uring_close(loop, uc);
+    return;
+  }
+  buffer_consume(&conn->in, conn->in_offset);
+  conn->in_offset = 0;
+  uc->throttled = 0;
+  if (!uc->receiving) {
+    uring_recv(loop, uc);
+  }
+}
+
+// Sends the memory output up to the next file with one sendmsg, or a chunk
+// of the file at the head of the queue, read into `chunk` by a read linked
+// before the send
+void uring_send(UringLoop *loop, UringConnection *uc) {
+  Connection *conn = &uc->conn;
+  OutputSegment *segment = conn->segments_head < conn->segments_count
+                               ? &conn->segments[conn->segments_head]
+                               : NULL;
+  struct io_uring_sqe *sqe;
+  if (segment && segment->kind == OUTPUT_FILE &&
+      conn->out_sent >= segment->at) {
+    if (!uc->chunk && !(uc->chunk = malloc(URING_FILE_CHUNK_LEN))) {
+      Log(stderr, ERROR, "Couldn't allocate file buffer: %s",
+          strerror(errno));
+      uring_close(loop, uc);
+      return;
+    }
+    uc->chunk_len = segment->remaining < URING_FILE_CHUNK_LEN
+                        ? segment->remaining
+                        : URING_FILE_CHUNK_LEN;
+    if (uring_reserve(loop, 2) == -1) {
+      uring_close(loop, uc);
+      return;
+    }
+    sqe = uring_sqe(loop, uc, URING_READ);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = segment->fd;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->addr = (uintptr_t)uc->chunk;
+    sqe->len = uc->chunk_len;
+    sqe->off = segment->offset;
+    sqe = uring_sqe(loop, uc, URING_SEND);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->addr = (uintptr_t)uc->chunk;
+    sqe->len = uc->chunk_len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    uc->sending_file = 1;
+  } else {
+    int more;
+    uc->msg = (struct msghdr){
+        .msg_iov = uc->iov,
+        .msg_iovlen = connection_gather_output(conn, uc->iov, &more),
+    };
+    sqe = uring_sqe(loop, uc, URING_SEND);
+    if (!sqe) {
+      uring_close(loop, uc);
+      return;
+    }
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->addr = (uintptr_t)&uc->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+    uc->sending_file = 0;
+  }
+  sqe->fd = uc->slot;
+  sqe->flags = IOSQE_FIXED_FILE;
+  uc->sending = 1;
+}
+
+void uring_sent(UringLoop *loop, UringConnection *uc, int res) {
+  Connection *conn = &uc->conn;
+  uc->pending--;
+  uc->sending = 0;
+  if (uc->closing) {
+    return;
+  }
+  if (res < 0 || uc->failed) {
+    uring_close(loop, uc);
+    return;
+  }
+  connection_advance_output(conn, res);
+  if (!connection_has_output(conn)) {
+    connection_reset_output(conn);
+  }
+  uring_serve(loop, uc);
+}
+
+// Shuts the socket down, which ends its receive and any send still waiting
+// on it, and closes its slot. The connection itself is only freed once
+// every operation on it completed.
+void uring_close(UringLoop *loop, UringConnection *uc) {
+  if (uc->closing) {
+    return;
+  }
+  uc->closing = 1;
+  timer_wheel_cancel(&loop->timers, &uc->conn.timer);
+  // The loop is stopping, its connections go with it
+  if (uring_reserve(loop, 2) == -1) {
+    return;
+  }
+  struct io_uring_sqe *sqe = uring_sqe(loop, NULL, URING_DETACHED);
+  sqe->opcode = IORING_OP_SHUTDOWN;
+  sqe->fd = uc->slot;
+  sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+  sqe->len = SHUT_RDWR;
+  uring_close_slot(loop, uc->slot);
+}
+
+// The slot only counts as free once the close completed, an accept
+// submitted before that could still find the table full
+void uring_close_slot(UringLoop *loop, unsigned slot) {
+  struct io_uring_sqe *sqe = uring_sqe(loop, NULL, URING_CLOSE);
+  if (!sqe) {
+    return;
+  }
+  sqe->opcode = IORING_OP_CLOSE;
+  sqe->file_index = slot + 1;
+}
+
+// Frees a closed connection once the kernel is done with its buffers
+void uring_settle(UringConnection *uc) {
+  if (uc->pending) {
+    return;
+  }
+  connection_close(&uc->conn);
+  connection_free(&uc->conn);
+  free(uc->chunk);
+  free(uc);
+}
+
+// Closes the connections whose deadline passed
+void uring_reap(UringLoop *loop, unsigned long long now_ms) {
+  Timer *timer;
+  while ((timer = timer_wheel_expire(&loop->timers, now_ms))) {
+    UringConnection *uc = timer->owner;
+    unsigned long long deadline =
+        atomic_load_explicit(&uc->conn.deadline, memory_order_relaxed);
+    if (!deadline) {
+      continue;
+    }
+    if (deadline > now_ms) {
+      timer_wheel_schedule(&loop->timers, timer, deadline);
+      continue;
+    }
+    uring_close(loop, uc);
+    uring_settle(uc);
+  }
+}
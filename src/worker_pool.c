@@ -0,0 +1,235 @@
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../exteral/log4c/include/log4c.h"
+
+#include "../include/alpha/connection.h"
+#include "../include/alpha/worker_pool.h"
+
+int client_queue_init(ClientQueue *queue, usize capacity) {
+  usize size = 2;
+  while (size < capacity) {
+    size *= 2;
+  }
+  queue->slots = malloc(sizeof(ClientQueueSlot) * size);
+  if (!queue->slots) {
+    return -1;
+  }
+  for (usize i = 0; i < size; ++i) {
+    atomic_init(&queue->slots[i].sequence, i);
+  }
+  queue->mask = size - 1;
+  atomic_init(&queue->head, 0);
+  atomic_init(&queue->tail, 0);
+  return 0;
+}
+
+// Returns -1 when the ring is full
+int client_queue_push(ClientQueue *queue, Client client) {
+  usize pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  while (1) {
+    ClientQueueSlot *slot = &queue->slots[pos & queue->mask];
+    usize seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    long diff = (long)seq - (long)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        slot->client = client;
+        atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+        return 0;
+      }
+    } else if (diff < 0) {
+      return -1;
+    } else {
+      pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    }
+  }
+}
+
+// Returns -1 when the ring is empty
+int client_queue_pop(ClientQueue *queue, Client *client) {
+  usize pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  while (1) {
+    ClientQueueSlot *slot = &queue->slots[pos & queue->mask];
+    usize seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    long diff = (long)seq - (long)(pos + 1);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        *client = slot->client;
+        atomic_store_explicit(&slot->sequence, pos + queue->mask + 1,
+                              memory_order_release);
+        return 0;
+      }
+    } else if (diff < 0) {
+      return -1;
+    } else {
+      pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    }
+  }
+}
+
+int worker_pool_init(WorkerPool *pool, AlphaApp *app) {
+  pool->app = app;
+  pool->workers_count = app->_config.workers;
+  if (pool->workers_count == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    pool->workers_count = WORKER_POOL_WORKERS_PER_CPU * (cpus > 0 ? cpus : 1);
+  }
+  usize capacity = app->_config.queue_capacity;
+  if (capacity == 0) {
+    capacity = WORKER_POOL_DEFAULT_QUEUE_CAP;
+  }
+  if (client_queue_init(&pool->queue, capacity) == -1) {
+    Log(stderr, ERROR, "Couldn't allocate client queue: %s", strerror(errno));
+    return -1;
+  }
+  pool->workers = calloc(pool->workers_count, sizeof(Worker));
+  if (!pool->workers) {
+    Log(stderr, ERROR, "Couldn't allocate workers: %s", strerror(errno));
+    free(pool->queue.slots);
+    return -1;
+  }
+  sem_init(&pool->ready, 0, 0);
+  sem_init(&pool->free, 0, pool->queue.mask + 1);
+  atomic_init(&pool->stopping, 0);
+
+  for (usize i = 0; i < pool->workers_count; ++i) {
+    Worker *worker = &pool->workers[i];
+    worker->pool = pool;
+    pthread_mutex_init(&worker->lock, NULL);
+    if (pthread_create(&worker->thread, NULL, WorkerHandler, worker) != 0) {
+      Log(stderr, ERROR, "Couldn't spawn worker %lu", i);
+      pthread_mutex_destroy(&worker->lock);
+      worker_pool_stop(pool, i);
+      return -1;
+    }
+  }
+
+  const AlphaConfig *config = &app->_config;
+  if (config->header_timeout_ms || config->body_timeout_ms ||
+      config->write_timeout_ms || config->worker_idle_timeout_ms) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, worker_pool_reaper, pool) != 0) {
+      Log(stderr, ERROR, "Couldn't spawn connection reaper");
+      worker_pool_stop(pool, pool->workers_count);
+      return -1;
+    }
+    pthread_detach(thread);
+  }
+  return 0;
+}
+
+// Tears down a pool that failed to start: wakes the first `started` workers,
+// waits for them to exit and frees everything worker_pool_init allocated.
+// No client was submitted yet, so none of them is serving one.
+void worker_pool_stop(WorkerPool *pool, usize started) {
+  atomic_store(&pool->stopping, 1);
+  for (usize i = 0; i < started; ++i) {
+    sem_post(&pool->ready);
+  }
+  for (usize i = 0; i < started; ++i) {
+    pthread_join(pool->workers[i].thread, NULL);
+    pthread_mutex_destroy(&pool->workers[i].lock);
+  }
+  sem_destroy(&pool->ready);
+  sem_destroy(&pool->free);
+  free(pool->workers);
+  pool->workers = NULL;
+  free(pool->queue.slots);
+  pool->queue.slots = NULL;
+}
+
+void worker_pool_submit(WorkerPool *pool, Client client) {
+  while (sem_wait(&pool->free) == -1 && errno == EINTR) {
+  }
+  client_queue_push(&pool->queue, client);
+  sem_post(&pool->ready);
+}
+
+// Each worker keeps one connection whose buffers are reused for every client
+// it serves, so the accept path never allocates
+void *WorkerHandler(void *arg) {
+  Worker *worker = (Worker *)arg;
+  WorkerPool *pool = worker->pool;
+  Connection conn;
+  connection_init(&conn, pool->app, (Client){.file_descriptor = -1}, 1);
+  pthread_mutex_lock(&worker->lock);
+  worker->conn = &conn;
+  pthread_mutex_unlock(&worker->lock);
+  while (1) {
+    while (sem_wait(&pool->ready) == -1 && errno == EINTR) {
+    }
+    if (atomic_load(&pool->stopping)) {
+      break;
+    }
+    // A posted slot may still be mid-publish by a racing producer
+    Client client;
+    while (client_queue_pop(&pool->queue, &client) == -1) {
+      sched_yield();
+    }
+    sem_post(&pool->free);
+
+    // Its client has likely given up while it waited for a worker, unless
+    // it hasn't sent a request yet and so wasn't waiting on us
+    Admission *admission = pool->app->_admission;
+    char pending;
+    if (admission_expired(admission, &client.accepted, NULL) &&
+        recv(client.file_descriptor, &pending, 1, MSG_PEEK | MSG_DONTWAIT) ==
+            1) {
+      admission_reject(admission, client.file_descriptor);
+      admission_connection_release(admission);
+      continue;
+    }
+    pthread_mutex_lock(&worker->lock);
+    connection_reuse(&conn, client);
+    pthread_mutex_unlock(&worker->lock);
+    while (connection_serve(&conn) != CONNECTION_CLOSE) {
+    }
+    pthread_mutex_lock(&worker->lock);
+    connection_close(&conn);
+    pthread_mutex_unlock(&worker->lock);
+  }
+  pthread_mutex_lock(&worker->lock);
+  worker->conn = NULL;
+  pthread_mutex_unlock(&worker->lock);
+  connection_free(&conn);
+  return NULL;
+}
+
+// Blocking workers can't watch their own deadline while they sit in recv or
+// send, so one thread checks them all every tick and shuts down the sockets
+// of those past it. The blocked call then returns and the worker closes the
+// connection as usual. Each worker serves one client at a time, so a scan
+// over the workers is all the bookkeeping needed.
+void *worker_pool_reaper(void *arg) {
+  WorkerPool *pool = (WorkerPool *)arg;
+  struct timespec tick = {.tv_nsec = TIMER_WHEEL_TICK_MS * 1000000L};
+  while (1) {
+    nanosleep(&tick, NULL);
+    unsigned long long now = timer_clock_ms();
+    for (usize i = 0; i < pool->workers_count; ++i) {
+      Worker *worker = &pool->workers[i];
+      pthread_mutex_lock(&worker->lock);
+      Connection *conn = worker->conn;
+      if (conn && conn->client.file_descriptor != -1) {
+        unsigned long long deadline =
+            atomic_load_explicit(&conn->deadline, memory_order_relaxed);
+        if (deadline && deadline <= now) {
+          shutdown(conn->client.file_descriptor, SHUT_RDWR);
+          atomic_store_explicit(&conn->deadline, 0, memory_order_relaxed);
+        }
+      }
+      pthread_mutex_unlock(&worker->lock);
+    }
+  }
+  return NULL;
+}
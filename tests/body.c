@@ -0,0 +1,156 @@
+// Request body framing: Content-Length, chunked decoding in place and the
+// compaction buffered bodies rely on
+
+#include "../include/alpha/body.h"
+
+#include "test.h"
+
+// Feeds `raw` whole and expects `decoded` in front of the buffer
+static void check_chunked(const char *raw, const char *decoded) {
+  char data[256];
+  usize len = strlen(raw);
+  memcpy(data, raw, len);
+  BodyReader reader;
+  body_reader_init(&reader, 1, 0);
+  CHECK(body_reader_execute(&reader, data, len) == BODY_DONE);
+  CHECK(reader.decoded == strlen(decoded));
+  CHECK(reader.total == strlen(decoded));
+  CHECK(memcmp(data, decoded, reader.decoded) == 0);
+}
+
+static BodyResult chunked_result(const char *raw) {
+  char data[4096];
+  usize len = strlen(raw);
+  memcpy(data, raw, len);
+  BodyReader reader;
+  body_reader_init(&reader, 1, 0);
+  return body_reader_execute(&reader, data, len);
+}
+
+static void test_content_length(void) {
+  char data[] = "hello, worldGET / HTTP/1.1";
+  BodyReader reader;
+  body_reader_init(&reader, 0, 12);
+  CHECK(body_reader_execute(&reader, data, 5) == BODY_INCOMPLETE);
+  CHECK(reader.consumed == 5);
+  // Whatever follows the body belongs to the next request
+  CHECK(body_reader_execute(&reader, data, sizeof(data) - 1) == BODY_DONE);
+  CHECK(reader.consumed == 12 && reader.decoded == 12 && reader.total == 12);
+}
+
+static void test_chunked(void) {
+  check_chunked("5\r\nhello\r\n7\r\n, world\r\n0\r\n\r\n", "hello, world");
+  check_chunked("A\r\n0123456789\r\n0\r\n\r\n", "0123456789");
+  // Extensions, bare LFs and trailers are accepted and dropped
+  check_chunked("3;name=value\r\nabc\n2 ; x\r\nde\r\n0\r\nX-Sum: 1\r\n\r\n",
+                "abcde");
+  check_chunked("0\r\n\r\n", "");
+}
+
+// One byte at a time, the way a slow client sends it
+static void test_chunked_split(void) {
+  const char raw[] = "4\r\nWiki\r\n5;ext\r\npedia\r\n0\r\nT: v\r\n\r\n";
+  char data[sizeof(raw)];
+  BodyReader reader;
+  body_reader_init(&reader, 1, 0);
+  for (usize i = 1; i < sizeof(raw); ++i) {
+    data[i - 1] = raw[i - 1];
+    BodyResult result = body_reader_execute(&reader, data, i);
+    CHECK(result == (i == sizeof(raw) - 1 ? BODY_DONE : BODY_INCOMPLETE));
+  }
+  CHECK(reader.decoded == 9 && memcmp(data, "Wikipedia", 9) == 0);
+}
+
+static void test_chunked_errors(void) {
+  CHECK(chunked_result("x\r\n") == BODY_ERROR);
+  CHECK(chunked_result(";ext\r\n") == BODY_ERROR);
+  CHECK(chunked_result("3\r\nabcX\r\n") == BODY_ERROR);
+  CHECK(chunked_result("3\rX") == BODY_ERROR);
+  CHECK(chunked_result("0\r\n\rX") == BODY_ERROR);
+  CHECK(chunked_result("fffffffffffffffff\r\n") == BODY_ERROR);
+  char line[2048];
+  memset(line, 'e', sizeof(line));
+  memcpy(line, "1;", 2);
+  line[sizeof(line) - 1] = '\0';
+  CHECK(chunked_result(line) == BODY_ERROR);
+}
+
+// What request_read_body does for buffered chunked bodies (3adb3b9): after
+// every pass the framing is moved out, so the buffer never holds more than
+// the decoded body and what wasn't decoded yet, however much framing a client
+// wraps around each byte
+static void test_chunked_compaction(void) {
+  char piece[1100];
+  usize piece_len = 0;
+  piece_len += sprintf(piece, "1;");
+  memset(piece + piece_len, 'e', 1000);
+  piece_len += 1000;
+  piece_len += sprintf(piece + piece_len, "\r\nX\r\n");
+
+  char buffer[4096];
+  usize buffer_len = 0;
+  BodyReader reader;
+  body_reader_init(&reader, 1, 0);
+  for (int i = 0; i < 500; ++i) {
+    memcpy(buffer + buffer_len, piece, piece_len);
+    buffer_len += piece_len;
+    CHECK(body_reader_execute(&reader, buffer, buffer_len) == BODY_INCOMPLETE);
+    usize framing = reader.consumed - reader.decoded;
+    memmove(buffer + reader.decoded, buffer + reader.consumed,
+            buffer_len - reader.consumed);
+    buffer_len -= framing;
+    body_reader_compact(&reader);
+    CHECK(buffer_len == (usize)i + 1);
+    CHECK(reader.consumed == reader.decoded);
+  }
+  const char end[] = "0\r\n\r\n";
+  memcpy(buffer + buffer_len, end, sizeof(end) - 1);
+  buffer_len += sizeof(end) - 1;
+  CHECK(body_reader_execute(&reader, buffer, buffer_len) == BODY_DONE);
+  CHECK(reader.decoded == 500 && reader.total == 500);
+  for (usize i = 0; i < 500; ++i) {
+    CHECK(buffer[i] == 'X');
+  }
+}
+
+// Streamed bodies drop what was decoded and carry on after it
+static void test_chunked_discard(void) {
+  char data[64];
+  const char first[] = "3\r\nabc\r\n2\r\nd";
+  memcpy(data, first, sizeof(first) - 1);
+  BodyReader reader;
+  body_reader_init(&reader, 1, 0);
+  CHECK(body_reader_execute(&reader, data, sizeof(first) - 1) ==
+        BODY_INCOMPLETE);
+  CHECK(reader.decoded == 4 && memcmp(data, "abcd", 4) == 0);
+  body_reader_discard(&reader);
+  const char rest[] = "e\r\n0\r\n\r\n";
+  memcpy(data, rest, sizeof(rest) - 1);
+  CHECK(body_reader_execute(&reader, data, sizeof(rest) - 1) == BODY_DONE);
+  CHECK(reader.decoded == 1 && data[0] == 'e' && reader.total == 5);
+}
+
+static void test_parse_length(void) {
+  usize length;
+  CHECK(body_parse_length((Slice){"0", 1}, &length) == 0 && length == 0);
+  CHECK(body_parse_length((Slice){"1048576", 7}, &length) == 0 &&
+        length == 1048576);
+  CHECK(body_parse_length((Slice){"", 0}, &length) == -1);
+  CHECK(body_parse_length((Slice){"-1", 2}, &length) == -1);
+  CHECK(body_parse_length((Slice){"1 2", 3}, &length) == -1);
+  CHECK(body_parse_length((Slice){"5, 5", 4}, &length) == -1);
+  CHECK(body_parse_length((Slice){"0x10", 4}, &length) == -1);
+  CHECK(body_parse_length((Slice){"99999999999999999999", 20}, &length) ==
+        -1);
+}
+
+int main(void) {
+  test_content_length();
+  test_chunked();
+  test_chunked_split();
+  test_chunked_errors();
+  test_chunked_compaction();
+  test_chunked_discard();
+  test_parse_length();
+  return 0;
+}
@@ -0,0 +1,235 @@
+// Whole requests through connection_serve over a socketpair: framing,
+// pipelining, buffered chunked bodies and streamed responses
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../include/alpha.h"
+#include "../include/alpha/connection.h"
+
+#include "test.h"
+
+static AlphaApp app;
+
+typedef struct {
+  Connection conn;
+  // The client's end
+  int peer;
+} TestConnection;
+
+static Response html(Request *req, const char *fmt, Slice value) {
+  return (Response){
+      .type = RESPONSE_HTML,
+      .statusCode = OK,
+      .payload.html = {.title = "test",
+                       .body = Request_Sprintf(req, fmt, (int)value.len,
+                                               value.ptr)},
+  };
+}
+
+static Response home(Request req) {
+  return html(&req, "home%.*s", (Slice){"", 0});
+}
+
+static Response user(Request req) {
+  return html(&req, "user=%.*s", Request_GetParam(&req, "id"));
+}
+
+static Response length(Request req) {
+  char len[32];
+  int len_len = snprintf(len, sizeof(len), "%lu", req.body.len);
+  return html(&req, "len=%.*s", (Slice){len, len_len});
+}
+
+static int produce_nothing(ResponseWriter *writer, void *state) {
+  (void)writer;
+  (void)state;
+  return 1;
+}
+
+static Response empty_stream(Request req) {
+  (void)req;
+  Response res = {.type = RESPONSE_STREAM, .statusCode = OK};
+  res.payload.stream = (StreamPayload){.contentType = "text/plain",
+                                       .producer = produce_nothing};
+  return res;
+}
+
+static void open_connection(TestConnection *test) {
+  int fds[2];
+  CHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+  connection_init(&test->conn, &app, (Client){.file_descriptor = fds[0]}, 0);
+  test->peer = fds[1];
+}
+
+static void close_connection(TestConnection *test) {
+  connection_close(&test->conn);
+  connection_free(&test->conn);
+  close(test->peer);
+}
+
+static void send_all(TestConnection *test, const char *data, usize len) {
+  CHECK(write(test->peer, data, len) == (ssize_t)len);
+}
+
+// Serves what the client sent so far and returns what it got back
+static ConnectionStatus serve(TestConnection *test, char *response,
+                              usize size) {
+  ConnectionStatus status = connection_serve(&test->conn);
+  ssize_t len = read(test->peer, response, size - 1);
+  response[len > 0 ? len : 0] = '\0';
+  return status;
+}
+
+static int count(const char *haystack, const char *needle) {
+  int found = 0;
+  for (const char *at = haystack; (at = strstr(at, needle)); at++) {
+    found++;
+  }
+  return found;
+}
+
+static void check_status(const char *request, const char *status_line) {
+  TestConnection test;
+  char response[8192];
+  open_connection(&test);
+  send_all(&test, request, strlen(request));
+  serve(&test, response, sizeof(response));
+  CHECK(strncmp(response, status_line, strlen(status_line)) == 0);
+  close_connection(&test);
+}
+
+// Pipelined requests are all answered in order and the connection stays
+// open, which relies on connection_flush returning CONNECTION_DONE once all
+// output went out (02647f1)
+static void test_pipelining(void) {
+  TestConnection test;
+  char response[8192];
+  open_connection(&test);
+  const char requests[] = "GET / HTTP/1.1\r\nHost: a\r\n\r\n"
+                          "GET /users/42 HTTP/1.1\r\nHost: a\r\n\r\n"
+                          "GET /users/7?x=1 HTTP/1.1\r\nHost: a\r\n\r\n";
+  send_all(&test, requests, sizeof(requests) - 1);
+  CHECK(serve(&test, response, sizeof(response)) == CONNECTION_WANT_READ);
+  CHECK(count(response, "HTTP/1.1 200 OK") == 3);
+  char *home_at = strstr(response, "home");
+  char *first = strstr(response, "user=42");
+  char *second = strstr(response, "user=7<");
+  CHECK(home_at && first && second && home_at < first && first < second);
+
+  CHECK(buffer_append(&test.conn.out, "x", 1) == 0);
+  CHECK(connection_flush(&test.conn) == CONNECTION_DONE);
+  CHECK(!connection_has_output(&test.conn));
+  close_connection(&test);
+}
+
+// A request head split over many reads keeps its route params pointing at
+// the right bytes once `in` grew
+static void test_split_request(void) {
+  TestConnection test;
+  char response[8192];
+  open_connection(&test);
+  char request[6000];
+  int len = sprintf(request, "GET /users/abc HTTP/1.1\r\nX-Pad: ");
+  memset(request + len, 'p', 5000);
+  len += 5000;
+  len += sprintf(request + len, "\r\n\r\n");
+  for (int at = 0; at < len; at += 700) {
+    send_all(&test, request + at, len - at < 700 ? len - at : 700);
+    serve(&test, response, sizeof(response));
+  }
+  CHECK(strstr(response, "HTTP/1.1 200 OK"));
+  CHECK(strstr(response, "user=abc<"));
+  close_connection(&test);
+}
+
+// Every Content-Length and Transfer-Encoding header is looked at, not just
+// the first of each
+static void test_framing(void) {
+  check_status("POST /len HTTP/1.1\r\nContent-Length: 3\r\n"
+               "Content-Length: 3\r\n\r\nabc",
+               "HTTP/1.1 200");
+  check_status("POST /len HTTP/1.1\r\nContent-Length: 3\r\n"
+               "Content-Length: 4\r\n\r\nabcd",
+               "HTTP/1.1 400");
+  check_status("POST /len HTTP/1.1\r\nContent-Length: 3\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n0\r\n\r\n",
+               "HTTP/1.1 400");
+  check_status("POST /len HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+               "Content-Length: 3\r\n\r\n0\r\n\r\n",
+               "HTTP/1.1 400");
+  check_status("POST /len HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n"
+               "\r\n",
+               "HTTP/1.1 400");
+  check_status("POST /len HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n0\r\n\r\n",
+               "HTTP/1.1 400");
+  check_status("POST /len HTTP/1.1\r\nTransfer-Encoding: gzip\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n0\r\n\r\n",
+               "HTTP/1.1 501");
+  check_status("POST /len HTTP/1.1\r\nTransfer-Encoding: Chunked\r\n\r\n"
+               "3\r\nabc\r\n0\r\n\r\n",
+               "HTTP/1.1 200");
+  check_status("POST /len HTTP/1.1\r\nContent-Length: 1x\r\n\r\n",
+               "HTTP/1.1 400");
+}
+
+// The framing of a buffered chunked body is dropped as it is decoded
+// (3adb3b9), so 1 KiB of chunk extension per body byte doesn't pile up in
+// `in`
+static void test_chunked_framing(void) {
+  TestConnection test;
+  char response[8192];
+  open_connection(&test);
+  const char head[] = "POST /len HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+  send_all(&test, head, sizeof(head) - 1);
+  serve(&test, response, sizeof(response));
+  char piece[1100];
+  int piece_len = sprintf(piece, "1;");
+  memset(piece + piece_len, 'e', 1000);
+  piece_len += 1000;
+  piece_len += sprintf(piece + piece_len, "\r\nX\r\n");
+  for (int i = 0; i < 1000; ++i) {
+    send_all(&test, piece, piece_len);
+    CHECK(serve(&test, response, sizeof(response)) == CONNECTION_WANT_READ);
+    CHECK(test.conn.in.len < 4096);
+  }
+  send_all(&test, "0\r\n\r\n", 5);
+  serve(&test, response, sizeof(response));
+  CHECK(strstr(response, "HTTP/1.1 200 OK"));
+  CHECK(strstr(response, "len=1000<"));
+  close_connection(&test);
+}
+
+// A producer returning 1 without writing aborts the stream instead of being
+// called forever (e393251)
+static void test_empty_producer(void) {
+  TestConnection test;
+  char response[8192];
+  open_connection(&test);
+  const char request[] = "GET /empty HTTP/1.1\r\n\r\n";
+  send_all(&test, request, sizeof(request) - 1);
+  alarm(5);
+  CHECK(serve(&test, response, sizeof(response)) == CONNECTION_CLOSE);
+  alarm(0);
+  close_connection(&test);
+}
+
+int main(void) {
+  AlphaConfig config = Alpha_DefaultConfig();
+  config.access_log = ACCESS_LOG_OFF;
+  config.static_cache_bytes = 0;
+  app = (AlphaApp){._fileDescriptor = -1, ._config = config};
+  CHECK(Alpha_Get(&app, "/", home) == 0);
+  CHECK(Alpha_Get(&app, "/users/:id", user) == 0);
+  CHECK(Alpha_Post(&app, "/len", length) == 0);
+  CHECK(Alpha_Get(&app, "/empty", empty_stream) == 0);
+
+  test_pipelining();
+  test_split_request();
+  test_framing();
+  test_chunked_framing();
+  test_empty_producer();
+  return 0;
+}
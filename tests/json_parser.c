@@ -0,0 +1,185 @@
+// JSON parsing: values, escapes, numbers, errors with their offsets and
+// inputs crossing the 64-byte blocks stage 1 scans
+
+#include "../include/alpha/json.h"
+
+#include "test.h"
+
+static Arena arena;
+
+static const JsonNode *parse(const char *text, JsonError *error) {
+  arena_reset(&arena);
+  return json_parse(&arena, text, strlen(text), error);
+}
+
+static void check_error(const char *text, usize offset) {
+  JsonError error = {0};
+  CHECK(parse(text, &error) == NULL);
+  CHECK(error.message != NULL);
+  CHECK(error.offset == offset);
+}
+
+static void test_values(void) {
+  JsonError error;
+  const char *text = " {\"name\": \"Ada\", \"age\": 36, \"tags\": [true, "
+                     "false, null, []], \"nested\": {\"x\": -1.5e2}} ";
+  const JsonNode *root = parse(text, &error);
+  CHECK(root && root->type == JSON_NODE_OBJECT && root->count == 4);
+  const JsonNode *name = JsonNode_Get(root, "name");
+  CHECK(name && name->type == JSON_NODE_STRING);
+  CHECK_SLICE(name->string, "Ada");
+  // Strings without escapes point into the input
+  CHECK(name->string.ptr > text && name->string.ptr < text + strlen(text));
+  const JsonNode *age = JsonNode_Get(root, "age");
+  CHECK(age && age->is_integer && age->integer == 36 && age->number == 36);
+  const JsonNode *tags = JsonNode_Get(root, "tags");
+  CHECK(tags && tags->type == JSON_NODE_ARRAY && tags->count == 4);
+  CHECK(tags->items[0].type == JSON_NODE_TRUE);
+  CHECK(tags->items[1].type == JSON_NODE_FALSE);
+  CHECK(tags->items[2].type == JSON_NODE_NULL);
+  CHECK(tags->items[3].type == JSON_NODE_ARRAY && tags->items[3].count == 0);
+  const JsonNode *x = JsonNode_Get(JsonNode_Get(root, "nested"), "x");
+  CHECK(x && !x->is_integer && x->number == -150);
+  CHECK(JsonNode_Get(root, "missing") == NULL);
+  CHECK(JsonNode_Get(tags, "name") == NULL);
+
+  root = parse("\"top\"", &error);
+  CHECK(root && root->type == JSON_NODE_STRING);
+  root = parse("{}", &error);
+  CHECK(root && root->type == JSON_NODE_OBJECT && root->count == 0);
+}
+
+static void test_strings(void) {
+  JsonError error;
+  const JsonNode *root =
+      parse("[\"a\\\"b\\\\c\\/\\n\\t\", \"\\u00e9\\ud83d\\ude00\", \"é\"]",
+            &error);
+  CHECK(root && root->count == 3);
+  CHECK_SLICE(root->items[0].string, "a\"b\\c/\n\t");
+  CHECK_SLICE(root->items[1].string, "\xc3\xa9\xf0\x9f\x98\x80");
+  CHECK_SLICE(root->items[2].string, "\xc3\xa9");
+
+  check_error("\"\\ud800\"", 1);
+  check_error("\"\\x\"", 1);
+  check_error("\"a\x01\"", 2);
+  check_error("\"\xff\"", 0);
+  check_error("\"\xc0\x80\"", 0);
+}
+
+static void test_numbers(void) {
+  JsonError error;
+  const JsonNode *root =
+      parse("[0, -0, 123456789012345678, -123456789012345678, "
+            "1234567890123456789, 1E+5, 0.5e-3]",
+            &error);
+  CHECK(root && root->count == 7);
+  CHECK(root->items[0].is_integer && root->items[0].integer == 0);
+  CHECK(root->items[2].is_integer &&
+        root->items[2].integer == 123456789012345678LL);
+  CHECK(root->items[3].is_integer &&
+        root->items[3].integer == -123456789012345678LL);
+  // Past 18 digits it may not fit, so it's only a double
+  CHECK(!root->items[4].is_integer && root->items[4].number > 1.2e18);
+  CHECK(root->items[5].number == 1e5);
+  CHECK(root->items[6].number == 0.5e-3);
+
+  CHECK(parse("[01]", &error) == NULL);
+  CHECK(parse("[1.]", &error) == NULL);
+  CHECK(parse("[1e]", &error) == NULL);
+  CHECK(parse("[-]", &error) == NULL);
+}
+
+static void test_errors(void) {
+  check_error("", 0);
+  check_error("   ", 3);
+  check_error("[1,]", 3);
+  check_error("[1 2]", 3);
+  check_error("{\"a\"}", 4);
+  check_error("{\"a\":}", 5);
+  check_error("{1:2}", 1);
+  check_error("[1]]", 3);
+  check_error("[1", 2);
+  check_error("\"abc", 4);
+  check_error("tru", 0);
+  check_error("truex", 0);
+  check_error("\"a\"1", 3);
+
+  char deep[JSON_DEPTH_MAX * 2 + 4];
+  memset(deep, '[', JSON_DEPTH_MAX + 1);
+  memset(deep + JSON_DEPTH_MAX + 1, ']', JSON_DEPTH_MAX + 1);
+  deep[JSON_DEPTH_MAX * 2 + 2] = '\0';
+  check_error(deep, JSON_DEPTH_MAX);
+  deep[JSON_DEPTH_MAX * 2 + 1] = '\0';
+  JsonError error;
+  CHECK(parse(deep + 1, &error) != NULL);
+}
+
+// Escapes and quotes right at the edges of the 64-byte blocks
+static void test_block_edges(void) {
+  char text[256];
+  for (int n = 55; n < 75; ++n) {
+    // ["\\...\\"], n escaped backslashes
+    usize len = 0;
+    text[len++] = '[';
+    text[len++] = '"';
+    for (int i = 0; i < n; ++i) {
+      text[len++] = '\\';
+      text[len++] = '\\';
+    }
+    text[len++] = '"';
+    text[len++] = ']';
+    text[len] = '\0';
+    JsonError error;
+    const JsonNode *root = parse(text, &error);
+    CHECK(root && root->count == 1 && root->items[0].string.len == (usize)n);
+
+    // ["aaa\"x"], the escaped quote doesn't end the string
+    len = 0;
+    text[len++] = '[';
+    text[len++] = '"';
+    memset(text + len, 'a', n);
+    len += n;
+    memcpy(text + len, "\\\"x\"]", 6);
+    root = parse(text, &error);
+    CHECK(root && root->count == 1 &&
+          root->items[0].string.len == (usize)n + 2);
+  }
+}
+
+// Nearly a token per byte, more than the index first makes room for
+static void test_dense(void) {
+  usize count = 100000;
+  char *text = malloc(count * 3 + 2);
+  usize len = 0;
+  text[len++] = '[';
+  for (usize i = 0; i < count; ++i) {
+    if (i % 2) {
+      text[len++] = '1';
+    } else {
+      text[len++] = '[';
+      text[len++] = ']';
+    }
+    text[len++] = ',';
+  }
+  text[len - 1] = ']';
+  text[len] = '\0';
+  JsonError error;
+  const JsonNode *root = parse(text, &error);
+  CHECK(root && root->type == JSON_NODE_ARRAY && root->count == count);
+  CHECK(root->items[0].type == JSON_NODE_ARRAY && root->items[0].count == 0);
+  CHECK(root->items[count - 1].is_integer &&
+        root->items[count - 1].integer == 1);
+  free(text);
+}
+
+int main(void) {
+  arena = (Arena){0};
+  test_values();
+  test_strings();
+  test_numbers();
+  test_errors();
+  test_block_edges();
+  test_dense();
+  arena_free(&arena);
+  return 0;
+}
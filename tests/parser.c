@@ -0,0 +1,107 @@
+// Request head parsing: complete and split heads, limits and malformed input
+
+#include "../include/alpha/parser.h"
+
+#include "test.h"
+
+static ParseResult parse(HttpParser *parser, const char *head) {
+  http_parser_reset(parser);
+  return http_parser_execute(parser, head, strlen(head));
+}
+
+static void test_complete_head(void) {
+  HttpParser parser;
+  const char *head = "GET /users/42?x=1 HTTP/1.1\r\n"
+                     "Host: example.com\r\n"
+                     "X-Custom:  padded value \t\r\n"
+                     "\r\n"
+                     "body";
+  CHECK(parse(&parser, head) == PARSE_DONE);
+  CHECK_SLICE(parser.method, "GET");
+  CHECK_SLICE(parser.path, "/users/42?x=1");
+  CHECK(parser.minor_version == 1);
+  CHECK(parser.offset == strlen(head) - 4);
+  CHECK(parser.headers.count == 2);
+  const HttpHeader *host = headers_find(&parser.headers, HEADER_HOST);
+  CHECK(host);
+  CHECK_SLICE(host->value, "example.com");
+  const HttpHeader *custom = headers_find_name(&parser.headers, "x-custom");
+  CHECK(custom);
+  CHECK_SLICE(custom->value, "padded value");
+}
+
+static void test_bare_lf_and_http10(void) {
+  HttpParser parser;
+  CHECK(parse(&parser, "\r\nGET / HTTP/1.0\nHost: a\n\n") == PARSE_DONE);
+  CHECK(parser.minor_version == 0);
+  CHECK_SLICE(parser.path, "/");
+}
+
+// Fed one byte at a time from a buffer that moves, like `in` does when it
+// grows, the slices still point into the latest copy
+static void test_split_head(void) {
+  const char *head = "POST /upload HTTP/1.1\r\n"
+                     "Content-Length: 5\r\n"
+                     "\r\n";
+  usize len = strlen(head);
+  HttpParser parser;
+  http_parser_reset(&parser);
+  char *copy = NULL;
+  for (usize i = 1; i <= len; ++i) {
+    char *moved = malloc(i);
+    memcpy(moved, head, i);
+    ParseResult result = http_parser_execute(&parser, moved, i);
+    free(copy);
+    copy = moved;
+    CHECK(result == (i == len ? PARSE_DONE : PARSE_INCOMPLETE));
+  }
+  CHECK_SLICE(parser.method, "POST");
+  CHECK_SLICE(parser.path, "/upload");
+  const HttpHeader *length =
+      headers_find(&parser.headers, HEADER_CONTENT_LENGTH);
+  CHECK(length && length->value.ptr >= copy && length->value.ptr < copy + len);
+  CHECK_SLICE(length->value, "5");
+  free(copy);
+}
+
+static void test_malformed(void) {
+  HttpParser parser;
+  CHECK(parse(&parser, "GET / HTTP/2.0\r\n\r\n") == PARSE_ERROR);
+  CHECK(parse(&parser, "GET /\r\n\r\n") == PARSE_ERROR);
+  CHECK(parse(&parser, " / HTTP/1.1\r\n\r\n") == PARSE_ERROR);
+  CHECK(parse(&parser, "GET / HTTP/1.1\r\nNo colon\r\n\r\n") == PARSE_ERROR);
+  CHECK(parse(&parser, "GET / HTTP/1.1\r\nName : v\r\n\r\n") == PARSE_ERROR);
+  // Obsolete line folding
+  CHECK(parse(&parser, "GET / HTTP/1.1\r\nA: b\r\n c\r\n\r\n") ==
+        PARSE_ERROR);
+  CHECK(parse(&parser, "GET / HTTP/1.1\rX\n\r\n") == PARSE_ERROR);
+  CHECK(parse(&parser, "GET / HTTP/1.1\r\nA: b\x01\r\n\r\n") == PARSE_ERROR);
+}
+
+static void test_limits(void) {
+  HttpParser parser;
+  char *head = malloc(REQUEST_HEAD_MAX + 64);
+  usize len = sprintf(head, "GET / HTTP/1.1\r\nX: ");
+  memset(head + len, 'a', REQUEST_HEAD_MAX);
+  len += REQUEST_HEAD_MAX;
+  http_parser_reset(&parser);
+  CHECK(http_parser_execute(&parser, head, len) == PARSE_TOO_LARGE);
+  free(head);
+
+  char many[REQUEST_HEADERS_MAX * 8 + 64];
+  len = sprintf(many, "GET / HTTP/1.1\r\n");
+  for (int i = 0; i <= REQUEST_HEADERS_MAX; ++i) {
+    len += sprintf(many + len, "H%d: v\r\n", i);
+  }
+  sprintf(many + len, "\r\n");
+  CHECK(parse(&parser, many) == PARSE_TOO_LARGE);
+}
+
+int main(void) {
+  test_complete_head();
+  test_bare_lf_and_http10();
+  test_split_head();
+  test_malformed();
+  test_limits();
+  return 0;
+}
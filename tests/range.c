@@ -0,0 +1,101 @@
+// Range header resolution against a file size, coalescing included
+
+#include "../include/alpha/range.h"
+
+#include "test.h"
+
+static RangeResult resolve(const char *header, usize size,
+                           ByteRanges *ranges) {
+  return parse_ranges((Slice){header, strlen(header)}, size, ranges);
+}
+
+static void check_range(const ByteRanges *ranges, usize index, usize start,
+                        usize len) {
+  CHECK(index < ranges->count);
+  CHECK(ranges->entries[index].start == start);
+  CHECK(ranges->entries[index].len == len);
+}
+
+static void test_single(void) {
+  ByteRanges ranges;
+  CHECK(resolve("bytes=0-99", 1000, &ranges) == RANGE_SATISFIABLE);
+  CHECK(ranges.count == 1);
+  check_range(&ranges, 0, 0, 100);
+  CHECK(resolve("bytes=900-", 1000, &ranges) == RANGE_SATISFIABLE);
+  check_range(&ranges, 0, 900, 100);
+  CHECK(resolve("bytes=-100", 1000, &ranges) == RANGE_SATISFIABLE);
+  check_range(&ranges, 0, 900, 100);
+  // Clamped to the file
+  CHECK(resolve("bytes=990-2000", 1000, &ranges) == RANGE_SATISFIABLE);
+  check_range(&ranges, 0, 990, 10);
+  CHECK(resolve("bytes=-5000", 1000, &ranges) == RANGE_SATISFIABLE);
+  check_range(&ranges, 0, 0, 1000);
+  CHECK(resolve("BYTES=0-0", 1000, &ranges) == RANGE_SATISFIABLE);
+  check_range(&ranges, 0, 0, 1);
+}
+
+static void test_unsatisfiable(void) {
+  ByteRanges ranges;
+  CHECK(resolve("bytes=1000-", 1000, &ranges) == RANGE_UNSATISFIABLE);
+  CHECK(resolve("bytes=5000-6000, 2000-", 1000, &ranges) ==
+        RANGE_UNSATISFIABLE);
+  CHECK(resolve("bytes=-0", 1000, &ranges) == RANGE_UNSATISFIABLE);
+  CHECK(resolve("bytes=0-", 0, &ranges) == RANGE_UNSATISFIABLE);
+}
+
+static void test_ignored(void) {
+  ByteRanges ranges;
+  CHECK(resolve("items=0-1", 1000, &ranges) == RANGE_IGNORED);
+  CHECK(resolve("bytes=", 1000, &ranges) == RANGE_IGNORED);
+  CHECK(resolve("bytes=5-1", 1000, &ranges) == RANGE_IGNORED);
+  CHECK(resolve("bytes=-", 1000, &ranges) == RANGE_IGNORED);
+  CHECK(resolve("bytes=a-b", 1000, &ranges) == RANGE_IGNORED);
+  CHECK(resolve("bytes=0-1;x", 1000, &ranges) == RANGE_IGNORED);
+  CHECK(resolve("bytes=99999999999999999999-", 1000, &ranges) ==
+        RANGE_IGNORED);
+  char many[256] = "bytes=";
+  for (int i = 0; i <= RANGES_MAX; ++i) {
+    sprintf(many + strlen(many), "%d-%d,", i * 10, i * 10);
+  }
+  CHECK(resolve(many, 1000, &ranges) == RANGE_IGNORED);
+}
+
+static void test_multiple(void) {
+  ByteRanges ranges;
+  CHECK(resolve("bytes=0-9, 20-29,-10", 1000, &ranges) == RANGE_SATISFIABLE);
+  CHECK(ranges.count == 3);
+  check_range(&ranges, 0, 0, 10);
+  check_range(&ranges, 1, 20, 10);
+  check_range(&ranges, 2, 990, 10);
+}
+
+// Repeated or overlapping ranges must not make the response bigger than
+// the file
+static void test_coalesce(void) {
+  ByteRanges ranges;
+  CHECK(resolve("bytes=0-,0-,0-,0-", 14, &ranges) == RANGE_SATISFIABLE);
+  CHECK(ranges.count == 1);
+  check_range(&ranges, 0, 0, 14);
+  CHECK(resolve("bytes=50-59,0-9,5-14,10-19,100-", 120, &ranges) ==
+        RANGE_SATISFIABLE);
+  CHECK(ranges.count == 3);
+  check_range(&ranges, 0, 0, 20);
+  check_range(&ranges, 1, 50, 10);
+  check_range(&ranges, 2, 100, 20);
+  CHECK(resolve("bytes=10-19,0-100,-5", 50, &ranges) == RANGE_SATISFIABLE);
+  CHECK(ranges.count == 1);
+  check_range(&ranges, 0, 0, 50);
+  // Ranges that touch are merged too
+  CHECK(resolve("bytes=0-4,5-9", 50, &ranges) == RANGE_SATISFIABLE);
+  CHECK(ranges.count == 1);
+  check_range(&ranges, 0, 0, 10);
+}
+
+int main(void) {
+  test_single();
+  test_unsatisfiable();
+  test_ignored();
+  test_multiple();
+  test_coalesce();
+  return 0;
+}
@@ -0,0 +1,130 @@
+// Route registration and matching: precedence, params, wildcards and the
+// backtracking between them
+
+#include "../include/alpha/router.h"
+
+#include "test.h"
+
+static Response handler(Request req) {
+  (void)req;
+  return (Response){0};
+}
+
+static int on_body(Request *req, Slice chunk) {
+  (void)req;
+  (void)chunk;
+  return 0;
+}
+
+static Router router;
+
+static Route *match(HttpMethod method, const char *path,
+                    RouteParams *params) {
+  char copy[256];
+  snprintf(copy, sizeof(copy), "%s", path);
+  return match_route(&router, copy, method, params);
+}
+
+static Slice param(const RouteParams *params, const char *name) {
+  for (usize i = 0; i < params->count; ++i) {
+    if (params->entries[i].name.len == strlen(name) &&
+        memcmp(params->entries[i].name.ptr, name, strlen(name)) == 0) {
+      return params->entries[i].value;
+    }
+  }
+  return (Slice){0};
+}
+
+static void test_registration(void) {
+  CHECK(router_add(&router, GET, "/", handler, NULL) == 0);
+  CHECK(router_add(&router, GET, "/users", handler, NULL) == 0);
+  CHECK(router_add(&router, GET, "/users/me", handler, NULL) == 0);
+  CHECK(router_add(&router, GET, "/users/:id", handler, NULL) == 0);
+  CHECK(router_add(&router, GET, "/users/:id/posts/:post", handler, NULL) ==
+        0);
+  CHECK(router_add(&router, GET, "/a/:x/c", handler, NULL) == 0);
+  CHECK(router_add(&router, GET, "/a/*rest", handler, NULL) == 0);
+  CHECK(router_add(&router, GET, "/files/*", handler, NULL) == 0);
+  CHECK(router_add(&router, POST, "/users", handler, NULL) == 0);
+  CHECK(router_add(&router, PUT, "/up/:name", handler, on_body) == 0);
+
+  // Duplicates, also through a differently named param, are refused
+  CHECK(router_add(&router, GET, "/users/me", handler, NULL) == -1);
+  CHECK(router_add(&router, GET, "/users/:other", handler, NULL) == -1);
+  CHECK(router_add(&router, POST, "/users", handler, NULL) == -1);
+  CHECK(router._routesCount == 10);
+
+  CHECK(router_add(&router, GET, "users", handler, NULL) == -1);
+  CHECK(router_add(&router, GET, "/x", NULL, NULL) == -1);
+  CHECK(router_add(&router, GET, "/x/:", handler, NULL) == -1);
+  CHECK(router_add(&router, GET, "/x:id", handler, NULL) == -1);
+  CHECK(router_add(&router, GET, "/x/*a/b", handler, NULL) == -1);
+  CHECK(router._routesCount == 10);
+  for (usize i = 0; i < router._routesCount; ++i) {
+    CHECK(router._routes[i]._id == i + 1);
+  }
+}
+
+static void test_static(void) {
+  RouteParams params;
+  Route *route = match(GET, "/", &params);
+  CHECK(route && strcmp(route->_path, "/") == 0 && params.count == 0);
+  route = match(GET, "/users?page=2", &params);
+  CHECK(route && strcmp(route->_path, "/users") == 0);
+  CHECK(match(GET, "/user", &params) == NULL);
+  CHECK(match(GET, "/usersx", &params) == NULL);
+  CHECK(match(DELETE, "/users", &params) == NULL);
+  route = match(POST, "/users", &params);
+  CHECK(route && route->_method == POST);
+}
+
+static void test_params(void) {
+  RouteParams params;
+  // A static segment wins over a param
+  Route *route = match(GET, "/users/me", &params);
+  CHECK(route && strcmp(route->_path, "/users/me") == 0 && params.count == 0);
+  route = match(GET, "/users/42", &params);
+  CHECK(route && strcmp(route->_path, "/users/:id") == 0);
+  CHECK(params.count == 1);
+  CHECK_SLICE(param(&params, "id"), "42");
+  route = match(GET, "/users/mex/posts/7?x", &params);
+  CHECK(route && strcmp(route->_path, "/users/:id/posts/:post") == 0);
+  CHECK_SLICE(param(&params, "id"), "mex");
+  CHECK_SLICE(param(&params, "post"), "7");
+  // Params never match an empty segment
+  CHECK(match(GET, "/users//posts/7", &params) == NULL);
+  CHECK(match(GET, "/users/42/posts", &params) == NULL);
+
+  route = match(PUT, "/up/report.csv", &params);
+  CHECK(route && route->_onBody == on_body);
+  CHECK_SLICE(param(&params, "name"), "report.csv");
+}
+
+// A param branch that dead-ends gives its capture back before the wildcard
+// is tried
+static void test_backtracking(void) {
+  RouteParams params;
+  Route *route = match(GET, "/a/b/c", &params);
+  CHECK(route && strcmp(route->_path, "/a/:x/c") == 0);
+  CHECK(params.count == 1);
+  CHECK_SLICE(param(&params, "x"), "b");
+  route = match(GET, "/a/b/d", &params);
+  CHECK(route && strcmp(route->_path, "/a/*rest") == 0);
+  CHECK(params.count == 1);
+  CHECK_SLICE(param(&params, "rest"), "b/d");
+  route = match(GET, "/a/", &params);
+  CHECK(route && strcmp(route->_path, "/a/*rest") == 0);
+  CHECK_SLICE(param(&params, "rest"), "");
+  route = match(GET, "/files/css/site.css", &params);
+  CHECK(route && strcmp(route->_path, "/files/*") == 0);
+  CHECK_SLICE(param(&params, "*"), "css/site.css");
+}
+
+int main(void) {
+  router = (Router){0};
+  test_registration();
+  test_static();
+  test_params();
+  test_backtracking();
+  return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef ALPHA_TEST
+#define ALPHA_TEST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/alpha/common.h"
+
+// Stops the test at the first failed check, naming it
+#define CHECK(cond)                                                           \
+  do {                                                                        \
+    if (!(cond)) {                                                            \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,      \
+              #cond);                                                         \
+      exit(1);                                                                \
+    }                                                                         \
+  } while (0)
+
+#define CHECK_SLICE(slice, str)                                               \
+  CHECK((slice).len == strlen(str) &&                                         \
+        memcmp((slice).ptr, (str), (slice).len) == 0)
+
+#endif
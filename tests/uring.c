@@ -0,0 +1,73 @@
+// Setting up and freeing io_uring loops leaves nothing behind but the
+// listening socket, which is what the fallback to epoll relies on (6a61df3).
+// Skipped where io_uring is unavailable.
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../include/alpha.h"
+#include "../include/alpha/uring.h"
+
+#include "test.h"
+
+// What ctest reports as skipped, see tests/CMakeLists.txt
+#define TEST_SKIPPED 77
+
+static usize open_fds(void) {
+  DIR *dir = opendir("/proc/self/fd");
+  CHECK(dir);
+  usize count = 0;
+  while (readdir(dir)) {
+    count++;
+  }
+  closedir(dir);
+  return count;
+}
+
+static usize mappings(void) {
+  FILE *maps = fopen("/proc/self/maps", "r");
+  CHECK(maps);
+  usize count = 0;
+  int c;
+  while ((c = fgetc(maps)) != EOF) {
+    count += c == '\n';
+  }
+  fclose(maps);
+  return count;
+}
+
+int main(void) {
+  AlphaConfig config = Alpha_DefaultConfig();
+  config.access_log = ACCESS_LOG_OFF;
+  config.static_cache_bytes = 0;
+  AlphaApp app = {._fileDescriptor = -1, ._backLog = 16, ._config = config};
+
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr = {.sin_family = AF_INET,
+                             .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+  CHECK(listen_fd != -1);
+  CHECK(bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  CHECK(listen(listen_fd, 16) == 0);
+
+  UringLoop loop;
+  if (uring_loop_init(&loop, &app, listen_fd) == -1) {
+    fprintf(stderr, "io_uring unavailable, skipped\n");
+    return TEST_SKIPPED;
+  }
+  uring_loop_free(&loop);
+
+  usize fds = open_fds();
+  usize maps = mappings();
+  for (int i = 0; i < 64; ++i) {
+    CHECK(uring_loop_init(&loop, &app, listen_fd) == 0);
+    uring_loop_free(&loop);
+  }
+  CHECK(open_fds() == fds);
+  CHECK(mappings() == maps);
+  CHECK(fcntl(listen_fd, F_GETFD) != -1);
+  close(listen_fd);
+  return 0;
+}